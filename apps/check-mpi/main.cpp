@@ -0,0 +1,175 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lgca_common.h"
+#include "utils.h"
+#include "lgca_parallel.h"
+
+#include "mpi_lattice.h"
+#include "omp_lattice.h"
+
+#include <mpi.h>
+
+using namespace lgca;
+
+// Number of steps every round of the check advances the lattices by
+static constexpr unsigned int ROUND_STEPS = 3;
+
+// Number of rounds of every phase of the check
+static constexpr int NUM_ROUNDS = 4;
+
+// Compares the node states of the distributed lattice with the ones of the shared-memory lattice
+// and reports the result on the root rank. Returns the number of failed comparisons (on all ranks).
+template<Model model_>
+static int compare(MPI_Lattice<model_>& lattice, OMP_Lattice<model_>& reference, const char* phase) {
+
+    // The node states of the slabs are gathered to the root rank
+    int same = lattice.has_same_node_states(reference);
+
+    // The particles are counted on all ranks
+    same = (lattice.get_n_particles() == reference.get_n_particles()) && same;
+
+    MPI_Bcast(&same, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (!same && lattice.is_root()) printf("  %-16s differs from omp\n", phase);
+
+    return same ? 0 : 1;
+}
+
+// Runs the distributed lattice and the shared-memory lattice on the specified test case from the
+// same initial state, which both lattices set up on their own, i.e. plain steps, steps after body
+// forces applied at once and steps with fused body forces, and cross-checks the node states after
+// every phase. Returns the number of failed comparisons.
+template<Model model_>
+static int check(const string model, const string test_case, const Real Re) {
+
+    const Real Ma                     = 0.2;
+    const int  coarse_graining_radius = 4;
+
+    MPI_Lattice<model_> lattice  (test_case, Re, Ma, coarse_graining_radius);
+    OMP_Lattice<model_> reference(test_case, Re, Ma, coarse_graining_radius);
+
+    if (lattice.is_root())
+        printf("%s, %s (%d x %d cells, %d ranks):\n", model.c_str(), test_case.c_str(),
+               lattice.dim_x(), lattice.dim_y(), lattice.num_ranks());
+
+    for (Lattice<model_>* l : { (Lattice<model_>*)&lattice, (Lattice<model_>*)&reference }) {
+
+        if (test_case == "karman") l->apply_bc_karman_vortex_street();
+        else                       l->apply_bc_pipe();
+
+        srand(1234);
+
+        if (test_case == "diffusion") l->init_diffusion();
+        else                          l->init_random();
+    }
+
+    int num_failed = compare(lattice, reference, "initial state");
+
+    for (int round = 0; round < NUM_ROUNDS; ++round) {
+
+        lattice  .advance(ROUND_STEPS);
+        reference.advance(ROUND_STEPS);
+    }
+
+    num_failed += compare(lattice, reference, "advance");
+
+    const int forcing = reference.get_initial_forcing();
+
+    for (int round = 0; round < NUM_ROUNDS; ++round) {
+
+        lattice  .apply_body_force(forcing);
+        reference.apply_body_force(forcing);
+
+        lattice  .advance(ROUND_STEPS);
+        reference.advance(ROUND_STEPS);
+    }
+
+    num_failed += compare(lattice, reference, "body force");
+
+    lattice  .set_fused_forcing(forcing, ROUND_STEPS);
+    reference.set_fused_forcing(forcing, ROUND_STEPS);
+
+    for (int round = 0; round < NUM_ROUNDS; ++round) {
+
+        lattice  .advance(ROUND_STEPS);
+        reference.advance(ROUND_STEPS);
+    }
+
+    num_failed += compare(lattice, reference, "fused forcing");
+
+    // The mean velocity is summed up over the slabs, while the shared-memory lattice computes it
+    // from the post-processed cell quantities
+    reference.copy_data_to_output_buffer();
+    reference.post_process();
+
+    const std::vector<Real> mean_velocity           = lattice  .get_mean_velocity();
+    const std::vector<Real> reference_mean_velocity = reference.get_mean_velocity();
+
+    if (std::abs(mean_velocity[0] - reference_mean_velocity[0]) > 1.0e-6 ||
+        std::abs(mean_velocity[1] - reference_mean_velocity[1]) > 1.0e-6) {
+
+        if (lattice.is_root()) printf("  %-16s differs from omp\n", "mean velocity");
+        ++num_failed;
+    }
+
+    if (lattice.is_root()) printf("  %s\n", (num_failed == 0) ? "passed" : "FAILED");
+
+    return num_failed;
+}
+
+// Main function of the headless cross-check of the distributed-memory lattice, e.g.
+//
+// mpirun -np 3 ./lgca-check-mpi --threads=2
+//
+// The distributed lattice has to produce the same node states as the shared-memory lattice for any
+// number of ranks. Returns a nonzero exit code otherwise.
+int main(int argc, char **argv) {
+
+    // The ranks communicate from the calling thread only
+    int thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+
+    // Get the number of threads from the command line
+    int num_threads = 0;
+    get_kernel_from_cmd(argc, argv, /*default=*/"omp", &num_threads);
+
+    Threads::init(num_threads);
+
+    // Small Reynolds numbers keep the lattices small
+    int num_failed = 0;
+
+    num_failed += check<Model::FHP_III>("FHP-III", "karman",    5);
+    num_failed += check<Model::FHP_III>("FHP-III", "pipe",      10);
+    num_failed += check<Model::FHP_III>("FHP-III", "diffusion", 10);
+    num_failed += check<Model::HPP>    ("HPP",     "karman",    5);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (rank == 0) {
+
+        if (num_failed != 0) printf("\n%d check(s) failed.\n", num_failed);
+        else                 printf("\nAll checks passed.\n");
+    }
+
+    MPI_Finalize();
+
+    return (num_failed != 0) ? 1 : 0;
+}
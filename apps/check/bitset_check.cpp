@@ -0,0 +1,174 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lgca_common.h"
+#include "lgca_bitset.h"
+
+#include "bitset_check.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace lgca {
+
+// Number of random operations per size of the bitsets
+static constexpr int NUM_OPERATIONS = 200;
+
+// Model of the bits of a bitset
+using BitModel = std::vector<bool>;
+
+// Returns the bits of the specified bitset
+static BitModel model_of(const Bitset& bitset) {
+
+    BitModel bits(bitset.size());
+
+    for (size_t pos = 0; pos < bitset.size(); ++pos) bits[pos] = bitset[pos];
+
+    return bits;
+}
+
+// Returns whether the bits and the count of the specified bitset match the model. The count of
+// all bits fails if the bits beyond the size of the bitset have not been kept zero.
+static bool matches(const Bitset& bitset, const BitModel& bits) {
+
+    const size_t num_set = std::count(bits.begin(), bits.end(), true);
+
+    return model_of(bitset) == bits && bitset.count() == num_set && bitset.parallel_count() == num_set;
+}
+
+// Checks the bulk operations on bitsets of the specified size. Returns the number of failed
+// comparisons.
+static int check_bitset(const size_t size, std::mt19937_64& rng) {
+
+    int num_failed = 0;
+
+    auto fail = [&](const char* operation) {
+
+        printf("  %-16s size %zu differs from the model\n", operation, size);
+        ++num_failed;
+    };
+
+    Bitset a(size), b(size);
+
+    // The random bits are a function of the seed only
+    a.fill_random(rng());
+    b.fill_random(rng());
+
+    BitModel model_a = model_of(a), model_b = model_of(b);
+
+    if (!matches(a, model_a) || !matches(b, model_b)) fail("fill_random");
+
+    Bitset c(size);
+    c.fill_random(1234);
+    a.fill_random(1234);
+
+    if (a != c) fail("fill_random");
+
+    model_a = model_of(a);
+
+    for (int operation = 0; operation < NUM_OPERATIONS; ++operation) {
+
+        switch (rng() % 7) {
+        case 0: {
+
+            // Count a random range of bits
+            size_t pos_begin = size ? rng() % (size + 1) : 0;
+            size_t pos_end   = size ? rng() % (size + 1) : 0;
+
+            if (pos_begin > pos_end) std::swap(pos_begin, pos_end);
+
+            if (a.count(pos_begin, pos_end) != size_t(std::count(model_a.begin() + pos_begin, model_a.begin() + pos_end, true)))
+                fail("count(range)");
+
+            break;
+        }
+        case 1:
+
+            a &= b;
+            for (size_t pos = 0; pos < size; ++pos) model_a[pos] = model_a[pos] && model_b[pos];
+            if (!matches(a, model_a)) fail("&=");
+            break;
+
+        case 2:
+
+            a |= b;
+            for (size_t pos = 0; pos < size; ++pos) model_a[pos] = model_a[pos] || model_b[pos];
+            if (!matches(a, model_a)) fail("|=");
+            break;
+
+        case 3:
+
+            a ^= b;
+            for (size_t pos = 0; pos < size; ++pos) model_a[pos] = model_a[pos] != model_b[pos];
+            if (!matches(a, model_a)) fail("^=");
+            break;
+
+        case 4: {
+
+            // Shift by up to a few words beyond the size, whole words included
+            const size_t shift = (rng() % 4 == 0) ? 64 * (rng() % 4) : rng() % (size + 130);
+
+            a <<= shift;
+            for (size_t pos = size; pos-- > 0; ) model_a[pos] = (pos >= shift) && model_a[pos - shift];
+            if (!matches(a, model_a)) fail("<<=");
+            break;
+        }
+        case 5: {
+
+            const size_t shift = (rng() % 4 == 0) ? 64 * (rng() % 4) : rng() % (size + 130);
+
+            a >>= shift;
+            for (size_t pos = 0; pos < size; ++pos) model_a[pos] = (pos + shift < size) && model_a[pos + shift];
+            if (!matches(a, model_a)) fail(">>=");
+            break;
+        }
+        case 6:
+
+            // Refill the bitsets, so that the shifts do not leave them empty
+            a.fill_random(rng());
+            b.fill_random(rng());
+            model_a = model_of(a);
+            model_b = model_of(b);
+            break;
+        }
+    }
+
+    return num_failed;
+}
+
+// Checks the bulk operations of the bitset on sizes of a single word or less, of several words
+// with and without a partial last word and of many words.
+int check_bitset() {
+
+    std::mt19937_64 rng(1234);
+
+    int num_failed = 0;
+
+    printf("Bitset:\n");
+
+    for (const size_t size : { 0, 1, 7, 63, 64, 65, 127, 128, 200, 1000, 4096, 100003 })
+        num_failed += check_bitset(size, rng);
+
+    printf("  %s\n\n", (num_failed == 0) ? "passed" : "FAILED");
+
+    return num_failed;
+}
+
+} // namespace lgca
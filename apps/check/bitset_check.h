@@ -0,0 +1,31 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_BITSET_CHECK_H_
+#define LGCA_BITSET_CHECK_H_
+
+namespace lgca {
+
+// Checks the counting and the bulk operations of the bitset on random bitsets of various sizes
+// against a model of the bits held by a vector. Returns the number of failed comparisons.
+int check_bitset();
+
+} // namespace lgca
+
+#endif /* LGCA_BITSET_CHECK_H_ */
@@ -0,0 +1,226 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lgca_common.h"
+#include "utils.h"
+#include "lgca_parallel.h"
+
+#include "kernel_registry.h"
+#include "ensemble_lattice.h"
+
+#include "bitset_check.h"
+
+#include <memory>
+#include <vector>
+
+using namespace lgca;
+
+// Number of steps every round of the check advances the lattices by
+static constexpr unsigned int ROUND_STEPS = 3;
+
+// Number of rounds of every phase of the check
+static constexpr int NUM_ROUNDS = 4;
+
+// Compares the node states of every lattice with the ones of the first lattice and reports the
+// result. Returns the number of lattices whose node states differ.
+template<Model model_>
+static int compare(const std::vector<KernelVariant<model_>>& variants,
+                   const std::vector<std::unique_ptr<Lattice<model_>>>& lattices,
+                   const char* phase) {
+
+    int num_failed = 0;
+
+    for (size_t i = 1; i < lattices.size(); ++i) {
+
+        if (!lattices[i]->has_same_node_states(*lattices[0])) {
+
+            printf("  %-16s %-12s differs from %s\n", phase, variants[i].name.c_str(), variants[0].name.c_str());
+            ++num_failed;
+        }
+    }
+
+    return num_failed;
+}
+
+// Runs every step kernel on the specified test case from the same initial state, i.e. plain steps,
+// steps after body forces applied at once and steps with fused body forces, and cross-checks the
+// node states after every phase. Returns the number of failed comparisons.
+template<Model model_>
+static int check(const string model, const string test_case, const Real Re) {
+
+    const Real Ma                     = 0.2;
+    const int  coarse_graining_radius = 4;
+
+    const std::vector<KernelVariant<model_>> variants = KernelRegistry<model_>::variants();
+
+    std::vector<std::unique_ptr<Lattice<model_>>> lattices;
+
+    for (const KernelVariant<model_>& variant : variants)
+        lattices.emplace_back(variant.create(test_case, Re, Ma, coarse_graining_radius));
+
+    Lattice<model_>& reference = *lattices[0];
+
+    printf("%s, %s (%d x %d cells, %zu kernels):\n", model.c_str(), test_case.c_str(),
+           reference.dim_x(), reference.dim_y(), lattices.size());
+
+    // Apply boundary conditions and initialize the first lattice with particles, the others start
+    // from a copy of it
+    if (test_case == "karman") reference.apply_bc_karman_vortex_street();
+    else                       reference.apply_bc_pipe();
+
+    srand(1234);
+    reference.init_random();
+
+    for (size_t i = 1; i < lattices.size(); ++i) lattices[i]->copy_state(reference);
+
+    int num_failed = compare(variants, lattices, "initial state");
+
+    for (int round = 0; round < NUM_ROUNDS; ++round)
+        for (auto& lattice : lattices) lattice->advance(ROUND_STEPS);
+
+    num_failed += compare(variants, lattices, "advance");
+
+    const int forcing = reference.get_initial_forcing();
+
+    for (int round = 0; round < NUM_ROUNDS; ++round) {
+
+        for (auto& lattice : lattices) {
+
+            lattice->apply_body_force(forcing);
+            lattice->advance(ROUND_STEPS);
+        }
+    }
+
+    num_failed += compare(variants, lattices, "body force");
+
+    for (size_t i = 0; i < lattices.size(); ++i) {
+
+        if (!lattices[i]->set_fused_forcing(forcing, ROUND_STEPS)) {
+
+            printf("  %-16s %-12s does not support fused forcing\n", "fused forcing", variants[i].name.c_str());
+            ++num_failed;
+        }
+    }
+
+    for (int round = 0; round < NUM_ROUNDS; ++round)
+        for (auto& lattice : lattices) lattice->advance(ROUND_STEPS);
+
+    for (auto& lattice : lattices) lattice->set_fused_forcing(0, ROUND_STEPS);
+
+    num_failed += compare(variants, lattices, "fused forcing");
+
+    printf("  %s\n", (num_failed == 0) ? "passed" : "FAILED");
+
+    return num_failed;
+}
+
+// Runs the ensemble of replicas (Ensemble_Lattice) on the specified test case of the HPP model, whose
+// collisions are deterministic, and cross-checks replica 0 with the first step kernel, which is
+// initialized alike. The other replicas have to be initialized on their own. Returns the number of
+// failed comparisons.
+static int check_ensemble(const string test_case, const Real Re) {
+
+    const Real Ma                     = 0.2;
+    const int  coarse_graining_radius = 4;
+
+    const std::vector<KernelVariant<Model::HPP>> variants = KernelRegistry<Model::HPP>::variants();
+
+    std::unique_ptr<Lattice<Model::HPP>> reference(variants[0].create(test_case, Re, Ma, coarse_graining_radius));
+    std::unique_ptr<Lattice<Model::HPP>> ensemble (KernelRegistry<Model::HPP>::create("ensemble", test_case, Re, Ma,
+                                                                                       coarse_graining_radius));
+
+    printf("HPP, %s, ensemble vs. %s:\n", test_case.c_str(), variants[0].name.c_str());
+
+    int num_failed = 0;
+
+    for (auto* lattice : { reference.get(), ensemble.get() }) {
+
+        if (test_case == "karman") lattice->apply_bc_karman_vortex_street();
+        else                       lattice->apply_bc_pipe();
+
+        srand(1234);
+        lattice->init_random();
+    }
+
+    if (!ensemble->has_same_node_states(*reference)) {
+
+        printf("  %-16s replica 0 differs from %s\n", "initial state", variants[0].name.c_str());
+        ++num_failed;
+    }
+
+    if (ensemble->get_n_particles() == Ensemble_Lattice<Model::HPP>::NUM_REPLICAS * reference->get_n_particles()) {
+
+        printf("  %-16s replicas are not initialized on their own\n", "initial state");
+        ++num_failed;
+    }
+
+    for (int round = 0; round < NUM_ROUNDS; ++round) {
+
+        reference->advance(ROUND_STEPS);
+        ensemble ->advance(ROUND_STEPS);
+    }
+
+    if (!ensemble->has_same_node_states(*reference)) {
+
+        printf("  %-16s replica 0 differs from %s\n", "advance", variants[0].name.c_str());
+        ++num_failed;
+    }
+
+    printf("  %s\n", (num_failed == 0) ? "passed" : "FAILED");
+
+    return num_failed;
+}
+
+// Main function of the headless cross-check of the step kernels, e.g.
+//
+// ./lgca-check --threads=4
+//
+// Every step kernel supported by the CPU (and replica 0 of the ensemble of HPP lattices) has to
+// produce the same node states as the first one, and the bitset operations have to match a model of
+// the bits. Returns a nonzero exit code otherwise.
+int main(int argc, char **argv) {
+
+    // Get the number of threads from the command line
+    int num_threads = 0;
+    get_kernel_from_cmd(argc, argv, /*default=*/"auto", &num_threads);
+
+    Threads::init(num_threads);
+
+    printf("Cross-checking the step kernels with %d thread(s).\n\n", Threads::num_threads());
+
+    int num_failed = check_bitset();
+
+    // Small Reynolds numbers keep the lattices small
+    num_failed += check<Model::FHP_III>("FHP-III", "karman", 5);
+    num_failed += check<Model::FHP_III>("FHP-III", "pipe",   10);
+    num_failed += check<Model::FHP_I>  ("FHP-I",   "pipe",   10);
+    num_failed += check<Model::HPP>    ("HPP",     "karman", 5);
+
+    num_failed += check_ensemble("karman", 5);
+
+    if (num_failed != 0) {
+
+        printf("\n%d check(s) failed.\n", num_failed);
+        return 1;
+    }
+
+    printf("\nAll checks passed.\n");
+
+    return 0;
+}
@@ -54,7 +54,8 @@ class DiffusionView : public QMainWindow
 
 public:
 
-    explicit DiffusionView(QWidget *parent = 0);
+    // Creates the viewer of a lattice using the specified step kernel (see KernelRegistry)
+    explicit DiffusionView(const string kernel, QWidget *parent = 0);
     ~DiffusionView();
 
 signals:
@@ -18,6 +18,8 @@
  */
 
 #include "lgca_common.h"
+#include "utils.h"
+#include "lgca_parallel.h"
 
 #include "karman_viewer.h"
 
@@ -53,8 +55,29 @@ int main(int argc, char **argv) {
     QApplication::setPalette(darkPalette);
     qApp->setStyleSheet("QToolTip { color: #ffffff; background-color: #2a82da; border: 1px solid white; }");
 
-    lgca::KarmanView viewer;
+    // Get the step kernel from the command line (the arguments of Qt have been removed already)
+    int         num_threads = 0;
+    bool        pin_threads = false;
+    std::string tuning_file;
+    bool        fused_forcing = false;
+    const std::string kernel = lgca::get_kernel_from_cmd(argc, argv, /*default=*/"bitplane",
+                                                         &num_threads, &pin_threads, &tuning_file,
+                                                         &fused_forcing);
+
+    // Set up the threads before the lattice is allocated, so that its rows are first touched by
+    // the threads updating them
+    lgca::Threads::init(num_threads, pin_threads);
+
+    // Use the grain sizes and tile dimensions tuned for this machine, if any
+    if (!tuning_file.empty()) lgca::Tuning::load(tuning_file);
+
+    lgca::KarmanView viewer(kernel, fused_forcing);
     viewer.show();
 
-    return app.exec();
+    const int status = app.exec();
+
+    if (!tuning_file.empty() && !lgca::Tuning::save(tuning_file))
+        printf("WARNING in main(): Cannot write the tuning file \"%s\".\n", tuning_file.c_str());
+
+    return status;
 }
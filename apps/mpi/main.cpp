@@ -0,0 +1,173 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lgca_common.h"
+#include "utils.h"
+#include "lgca_parallel.h"
+
+#include "mpi_lattice.h"
+#include "lgca_io_vti.h"
+
+#include <mpi.h>
+
+#include <chrono>
+#include <memory>
+
+using namespace lgca;
+
+// Lattice gas model
+static constexpr Model MODEL = Model::FHP_III;
+
+// Main function of the distributed-memory simulation without graphical user interface, e.g.
+//
+// mpirun -np 4 ./lgca-mpi --test-case=karman --Re=1000 --steps=2000
+int main(int argc, char **argv) {
+
+    // The ranks communicate from the calling thread only
+    int thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+
+    string test_case;              // Test case
+    Real   Re;                     // Reynolds number
+    Real   Ma;                     // Mach number
+    int    n_dir;                  // Number of lattice directions (given by the model)
+    int    s_max;                  // Number of simulated time steps
+    int    coarse_graining_radius; // Coarse graining radius
+    int    write_steps;            // Number of steps after which the results are written
+    int    body_force_steps;       // Number of steps after which a body force is applied
+    int    body_force_intensity;   // Intensity of the body force (not used)
+    int    device;                 // Number of the device to use (not used)
+    int    max_block_size;         // Maximum block size in x direction (not used)
+    string parallel_type;          // Parallelization type (not used)
+    string output_format;          // Output format ("vti" writes the results to files)
+
+    // Get values from the command line
+    get_vals_from_cmd(argc, argv,
+                      &test_case,
+                      &Re, &Ma,
+                      &n_dir,
+                      &s_max,
+                      &coarse_graining_radius,
+                      &write_steps,
+                      &body_force_steps, &body_force_intensity,
+                      &device,
+                      &max_block_size,
+                      &parallel_type,
+                      &output_format);
+
+    // Every rank sets up the same initial state
+    srand(1234);
+
+    Threads::init();
+
+    {
+        MPI_Lattice<MODEL> lattice(test_case, Re, Ma, coarse_graining_radius);
+
+        if (lattice.is_root()) print_startup_message();
+
+        // Apply boundary conditions and initialize the lattice gas automaton with particles
+        if      (test_case == "pipe")      lattice.apply_bc_pipe();
+        else if (test_case == "karman")    lattice.apply_bc_karman_vortex_street();
+        else if (test_case == "periodic")  lattice.apply_bc_periodic();
+        else if (test_case == "collision") lattice.apply_bc_pipe();
+        else                               lattice.apply_bc_reflecting("back");
+
+        if      (test_case == "collision") lattice.init_single_collision();
+        else if (test_case == "diffusion") lattice.init_diffusion();
+        else                               lattice.init_random();
+
+        const unsigned long n_particles_start = lattice.get_n_particles();
+
+        lattice.setup_parallel();
+
+        // The results are written by the root rank
+        std::unique_ptr<IoVti<MODEL>> vti_io_handler;
+
+        if (output_format == "vti") {
+
+            lattice.copy_data_to_output_buffer();
+
+            if (lattice.is_root()) {
+
+                lattice.post_process();
+                vti_io_handler.reset(new IoVti<MODEL>(&lattice, "Cell density"));
+            }
+        }
+
+        // Calculate the number of particles to revert in the context of body force in order to
+        // accelerate the flow
+        int forcing = lattice.get_initial_forcing();
+
+        double sim_time = 0.0;
+
+        // Loop over the simulation steps
+        for (int step = 0; step < s_max; ++step) {
+
+            if (body_force_steps > 0 && step % body_force_steps == 0) {
+
+                const std::vector<Real> mean_velocity = lattice.get_mean_velocity();
+
+                if (mean_velocity[0] < lattice.u()) {
+
+                    // Reduce the forcing once the flow has been accelerated strong enough
+                    if (mean_velocity[0] > 0.9 * lattice.u()) forcing = lattice.get_equilibrium_forcing();
+
+                    lattice.apply_body_force(forcing);
+                }
+            }
+
+            auto sim_start = std::chrono::steady_clock::now();
+
+            lattice.collide_and_propagate(false);
+
+            sim_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - sim_start).count();
+
+            if ((step + 1) % write_steps == 0) {
+
+                const std::vector<Real> mean_velocity = lattice.get_mean_velocity();
+
+                if (output_format == "vti") {
+
+                    lattice.copy_data_to_output_buffer();
+
+                    if (lattice.is_root()) {
+
+                        lattice.post_process();
+                        vti_io_handler->update();
+                        vti_io_handler->write(step + 1);
+                    }
+                }
+
+                if (lattice.is_root())
+                    printf("Step %d: mean velocity (%6.4f, %6.4f), %d MNUPS\n", step + 1,
+                           mean_velocity[0], mean_velocity[1],
+                           (int)((lattice.num_cells() * (step + 1)) / (sim_time * 1.0e06)));
+            }
+        }
+
+        const unsigned long n_particles_end = lattice.get_n_particles();
+
+        if (lattice.is_root())
+            printf("\nNumber of particles: %lu at the start, %lu at the end.\n", n_particles_start, n_particles_end);
+    }
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -23,7 +23,9 @@
 #include "utils.h"
 #include "lattice.h"
 #include "omp_lattice.h"
+#include "bitplane_lattice.h"
 #include "cu_lattice.h"
+#include "kernel_registry.h"
 #include "lgca_io_vti.h"
 
 #include <tbb/task_group.h>
@@ -32,24 +34,30 @@
 
 namespace lgca {
 
-PipeView::PipeView(QWidget *parent) :
+PipeView::PipeView(const string kernel, const bool fused_forcing, QWidget *parent) :
     QMainWindow(parent),
     m_ui(new Ui::PipeView),
-    m_steps(0)
+    m_steps(0),
+    m_fused_forcing(fused_forcing)
 {
     m_ui->setupUi(this);
 
     // Print startup message
     print_startup_message();
 
-    // Create a lattice gas cellular automaton object
-    m_lattice = new OMP_Lattice<MODEL>(/*case=*/"pipe", m_Re, m_Ma, CG_RADIUS);
+    // Create a lattice gas cellular automaton object using the specified step kernel
+    m_lattice = KernelRegistry<MODEL>::create(kernel == "auto" ? "bitplane" : kernel,
+                                              /*case=*/"pipe", m_Re, m_Ma, CG_RADIUS);
 
     // Apply boundary conditions
     m_lattice->apply_bc_pipe();
 
     // Initialize the lattice gas automaton with particles
     m_lattice->init_random();
+
+    // Pick the fastest step kernel for the lattice
+    if (kernel == "auto") m_lattice = KernelRegistry<MODEL>::autotune(m_lattice);
+
     m_num_particles = m_lattice->get_n_particles();
 
     // Necessary to set up on-line visualization
@@ -120,19 +128,23 @@ void PipeView::run()
             if (m_mean_velocity[0] > 0.9 * m_lattice->u())
                 m_forcing = m_lattice->get_equilibrium_forcing();
 
-            // Apply a body force to the particles
-            m_lattice->apply_body_force(m_forcing);
+            // Apply a body force to the particles, spread over the next steps by the step kernel if
+            // selected and supported
+            if (!m_fused_forcing || !m_lattice->set_fused_forcing(m_forcing, PP_INTERVAL))
+                m_lattice->apply_body_force(m_forcing);
+
+        } else if (m_fused_forcing) {
+
+            // Stop the body force applied by the step kernel
+            m_lattice->set_fused_forcing(0, PP_INTERVAL);
         }
 
         auto sim_start = steady_clock::now();
 
-#pragma unroll
-        for (int s = 0; s < PP_INTERVAL; ++s) {
-
-            // Perform the collision and propagation step on the lattice gas automaton
-            m_lattice->collide_and_propagate();
-            m_steps++;
-        }
+        // Perform the collision and propagation steps on the lattice gas automaton. The lattice
+        // may advance cache-sized tiles by several steps at once.
+        m_lattice->advance(PP_INTERVAL);
+        m_steps += PP_INTERVAL;
 
         // Print current simulation performance
         auto sim_end = steady_clock::now();
@@ -56,7 +56,9 @@ public:
 
     friend class PipeRunnable;
 
-    explicit PipeView(QWidget *parent = 0);
+    // Creates the viewer of a lattice using the specified step kernel (see KernelRegistry), which
+    // applies the body force by the step kernel if fused_forcing is set and the kernel supports it
+    explicit PipeView(const string kernel, const bool fused_forcing = false, QWidget *parent = 0);
     ~PipeView();
 
 signals:
@@ -94,6 +96,7 @@ private:
     size_t            m_num_particles;
     std::vector<Real> m_mean_velocity;
     int               m_forcing;
+    bool              m_fused_forcing; // Whether the body force is applied by the step kernel
     Real              m_Re = 80.0; // Reynolds number
     Real              m_Ma = 0.3;  // Mach number
 
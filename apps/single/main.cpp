@@ -18,6 +18,8 @@
  */
 
 #include "lgca_common.h"
+#include "utils.h"
+#include "lgca_parallel.h"
 
 #include "single_viewer.h"
 
@@ -54,8 +56,27 @@ int main(int argc, char **argv) {
     QApplication::setPalette(darkPalette);
     qApp->setStyleSheet("QToolTip { color: #ffffff; background-color: #2a82da; border: 1px solid white; }");
 
-    lgca::SingleView viewer;
+    // Get the step kernel from the command line (the arguments of Qt have been removed already)
+    int         num_threads = 0;
+    bool        pin_threads = false;
+    std::string tuning_file;
+    const std::string kernel = lgca::get_kernel_from_cmd(argc, argv, /*default=*/"omp",
+                                                         &num_threads, &pin_threads, &tuning_file);
+
+    // Set up the threads before the lattice is allocated, so that its rows are first touched by
+    // the threads updating them
+    lgca::Threads::init(num_threads, pin_threads);
+
+    // Use the grain sizes and tile dimensions tuned for this machine, if any
+    if (!tuning_file.empty()) lgca::Tuning::load(tuning_file);
+
+    lgca::SingleView viewer(kernel);
     viewer.show();
 
-    return app.exec();
+    const int status = app.exec();
+
+    if (!tuning_file.empty() && !lgca::Tuning::save(tuning_file))
+        printf("WARNING in main(): Cannot write the tuning file \"%s\".\n", tuning_file.c_str());
+
+    return status;
 }
@@ -24,6 +24,7 @@
 #include "lattice.h"
 #include "omp_lattice.h"
 #include "cu_lattice.h"
+#include "kernel_registry.h"
 #include "lgca_io_vti.h"
 
 #include <tbb/task_group.h>
@@ -32,7 +33,7 @@
 
 namespace lgca {
 
-SingleView::SingleView(QWidget *parent) :
+SingleView::SingleView(const string kernel, QWidget *parent) :
     QMainWindow(parent),
     m_ui(new Ui::SingleView),
     m_steps(0)
@@ -42,14 +43,19 @@ SingleView::SingleView(QWidget *parent) :
     // Print startup message
     print_startup_message();
 
-    // Create a lattice gas cellular automaton object
-    m_lattice = new OMP_Lattice<MODEL>(/*case=*/"collision", m_Re, m_Ma, CG_RADIUS);
+    // Create a lattice gas cellular automaton object using the specified step kernel
+    m_lattice = KernelRegistry<MODEL>::create(kernel == "auto" ? "omp" : kernel,
+                                              /*case=*/"collision", m_Re, m_Ma, CG_RADIUS);
 
     // Apply boundary conditions
     m_lattice->apply_bc_pipe();
 
     // Initialize the lattice gas automaton with particles
     m_lattice->init_single_collision();
+
+    // Pick the fastest step kernel for the lattice
+    if (kernel == "auto") m_lattice = KernelRegistry<MODEL>::autotune(m_lattice);
+
     m_num_particles = m_lattice->get_n_particles();
 
     // Necessary to set up on-line visualization
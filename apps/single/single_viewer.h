@@ -54,7 +54,8 @@ class SingleView : public QMainWindow
 
 public:
 
-    explicit SingleView(QWidget *parent = 0);
+    // Creates the viewer of a lattice using the specified step kernel (see KernelRegistry)
+    explicit SingleView(const string kernel, QWidget *parent = 0);
     ~SingleView();
 
 signals:
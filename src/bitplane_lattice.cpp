@@ -0,0 +1,854 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lgca_common.h"
+
+#include "bitplane_lattice.h"
+#include "lgca_parallel.h"
+
+#include <tbb/blocked_range.h>
+
+#include <algorithm>
+#include <cstring> // memcpy, memset
+
+namespace lgca {
+
+// Creates a bit-sliced, TBB parallelized lattice gas cellular automaton object of the specified
+// properties.
+template<Model model_>
+BitPlane_Lattice<model_>::BitPlane_Lattice(const string test_case,
+                                           const Real Re, const Real Ma_s,
+                                           const int coarse_graining_radius)
+                    : Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius),
+                      m_pull(this->m_dim_x, this->m_dim_y),
+                      m_step(0),
+                      m_planes_valid(false),
+                      m_time_block_steps(8),
+                      m_step_rows(NULL),
+                      m_boundary(Boundary::GENERIC) {
+
+    assert(this->m_dim_x > 2);
+
+    m_num_words_x = (this->m_dim_x - 1) / BITS_PER_WORD + 1;
+    m_num_words   = m_num_words_x * this->m_dim_y;
+    m_last_bit    = (this->m_dim_x - 1) % BITS_PER_WORD;
+
+    m_rows.init(this->m_dim_y, Threads::num_threads(), 1, REBALANCE_STEPS);
+
+    // Allocate the memory for the arrays on the host (CPU)
+    allocate_memory();
+
+    // Choose the widest instruction set extension supported by the CPU. The step kernel is
+    // chosen when the cell types are packed.
+    m_simd_isa = detect_simd_isa();
+}
+
+// Deletes the bit-sliced lattice gas cellular automaton object.
+template<Model model_>
+BitPlane_Lattice<model_>::~BitPlane_Lattice() {
+
+    this->free_memory();
+}
+
+// Returns the word of the specified row which holds the node states of the cells shifted by dx
+// in x direction, wrapping around periodically.
+template<Model model_>
+LGCA_FORCE_INLINE typename BitPlane_Lattice<model_>::Word
+BitPlane_Lattice<model_>::pull_word(const Word* row, const size_t w, const int dx) const {
+
+    const size_t last_word = m_num_words_x - 1;
+
+    // Pull from the western neighbor: bit i holds cell i - 1
+    if (dx < 0) {
+
+        Word carry = (w > 0) ? (row[w - 1] >> (BITS_PER_WORD - 1))
+                             : (row[last_word] >> m_last_bit) & Word(1);
+
+        return (row[w] << 1) | carry;
+    }
+
+    // Pull from the eastern neighbor: bit i holds cell i + 1
+    if (dx > 0) {
+
+        Word word = row[w] >> 1;
+
+        if (w < last_word) word |= row[w + 1] << (BITS_PER_WORD - 1);
+        else               word |= (row[0] & Word(1)) << m_last_bit;
+
+        return word;
+    }
+
+    return row[w];
+}
+
+// Loads a vector of words starting at the specified address
+template<typename Vec>
+static LGCA_FORCE_INLINE void load_words(const uint64_t* ptr, Vec& vec) {
+
+    memcpy(&vec, ptr, sizeof(Vec));
+}
+
+// Stores a vector of words starting at the specified address
+template<typename Vec>
+static LGCA_FORCE_INLINE void store_words(uint64_t* ptr, const Vec& vec) {
+
+    memcpy(ptr, &vec, sizeof(Vec));
+}
+
+// Gets the vector of words of a row which holds the node states of the cells shifted by dx in x
+// direction. The words next to the vector have to exist, i.e. the vector must not contain the
+// first or the last word of the row.
+template<typename Vec>
+static LGCA_FORCE_INLINE void pull_words(const uint64_t* row, const int dx, Vec& vec) {
+
+    Vec neighbor;
+
+    load_words(row, vec);
+
+    // Pull from the western neighbor: bit i holds cell i - 1
+    if (dx < 0) {
+
+        load_words(row - 1, neighbor);
+        vec = (vec << 1) | (neighbor >> 63);
+    }
+
+    // Pull from the eastern neighbor: bit i holds cell i + 1
+    if (dx > 0) {
+
+        load_words(row + 1, neighbor);
+        vec = (vec >> 1) | (neighbor << 63);
+    }
+}
+
+// Executes the collision step on the pulled node states of the words starting at the specified
+// word index of the cell type masks and writes the results to the specified destination. The
+// random bits for collision are generated from the word indexes and the index of the step. Rows
+// of uniform cell type evaluate a single collision rule without loading the cell type masks.
+template<Model model_>
+template<typename Vec, RowKind KIND>
+LGCA_FORCE_INLINE void BitPlane_Lattice<model_>::collide_words(const Vec* node_state, const size_t word,
+                                                               Word* dst, const size_t dst_dir_stride,
+                                                               const uint64_t step) {
+
+    constexpr size_t NUM_LANES = sizeof(Vec) / sizeof(Word);
+
+    // Execute bounce back step on rows of no-slip cells
+    if (KIND == RowKind::NO_SLIP) {
+
+        Vec node_state_bb[this->NUM_DIR];
+
+        ModelDesc::bounce_back(node_state, node_state_bb);
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            store_words(dst + dir * dst_dir_stride, node_state_bb[dir]);
+
+        return;
+    }
+
+    Word lane_word[NUM_LANES];
+
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) lane_word[lane] = word + lane;
+
+    Vec index, rnd;
+
+    load_words(lane_word, index);
+
+    m_rng.bits(index, step, rnd);
+
+    Vec node_state_col[this->NUM_DIR];
+
+    ModelDesc::collide(node_state, node_state_col, rnd);
+
+    // Apply the body force to the fluid cells (fused forcing)
+    if (m_fused_forcing.enabled()) m_fused_forcing.apply(m_rng, index, step, node_state_col);
+
+    // Execute collision step on rows of fluid cells
+    if (KIND == RowKind::FLUID) {
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            store_words(dst + dir * dst_dir_stride, node_state_col[dir]);
+
+        return;
+    }
+
+    // Execute collision step for all cell types and blend the results according to the cell type
+    // masks
+    Vec node_state_bb [this->NUM_DIR];
+    Vec node_state_bfx[this->NUM_DIR];
+    Vec node_state_bfy[this->NUM_DIR];
+
+    Vec fluid, no_slip, slip_x, slip_y, slip_keep;
+
+    load_words(m_fluid_mask     + word, fluid);
+    load_words(m_no_slip_mask   + word, no_slip);
+    load_words(m_slip_x_mask    + word, slip_x);
+    load_words(m_slip_y_mask    + word, slip_y);
+    load_words(m_slip_keep_mask + word, slip_keep);
+
+    ModelDesc::bounce_back     (node_state, node_state_bb);
+    ModelDesc::bounce_forward_x(node_state, node_state_bfx);
+    ModelDesc::bounce_forward_y(node_state, node_state_bfy);
+
+    // Write new node states back to the bit planes
+#pragma unroll
+    for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+        const Vec node_state_new = (fluid     & node_state_col[dir])
+                                 | (no_slip   & node_state_bb [dir])
+                                 | (slip_x    & node_state_bfx[dir])
+                                 | (slip_y    & node_state_bfy[dir])
+                                 | (slip_keep & node_state    [dir]);
+
+        store_words(dst + dir * dst_dir_stride, node_state_new);
+    }
+}
+
+// Performs the collision and propagation step on one row, pulling the node states from the
+// specified rows of the source bit planes (shifted by dx in x direction) and writing the results
+// to the specified row of the destination bit planes. sizeof(Vec) / sizeof(Word) words of the row
+// are processed at once.
+template<Model model_>
+template<typename Vec, RowKind KIND>
+LGCA_FORCE_INLINE void BitPlane_Lattice<model_>::step_row(const Word* const* src_row, const int* dx,
+                                                          Word* dst_row, const size_t dst_dir_stride,
+                                                          const size_t row, const uint64_t step) {
+
+    constexpr size_t NUM_LANES = sizeof(Vec) / sizeof(Word);
+
+    Word node_state[this->NUM_DIR];
+
+    // Execute propagation step on the first word of the row, which wraps around periodically
+#pragma unroll
+    for (int dir = 0; dir < this->NUM_DIR; ++dir)
+        node_state[dir] = pull_word(src_row[dir], 0, dx[dir]);
+
+    collide_words<Word, KIND>(node_state, row, dst_row, dst_dir_stride, step);
+
+    // Execute propagation step on the inner words of the row, NUM_LANES words at once
+    size_t w = 1;
+
+    for (; w + NUM_LANES < m_num_words_x; w += NUM_LANES) {
+
+        Vec node_state_vec[this->NUM_DIR];
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            pull_words(src_row[dir] + w, dx[dir], node_state_vec[dir]);
+
+        collide_words<Vec, KIND>(node_state_vec, row + w, dst_row + w, dst_dir_stride, step);
+    }
+
+    // Execute propagation step on the remaining words, the last of which wraps around
+    // periodically
+    for (; w < m_num_words_x; ++w) {
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            node_state[dir] = pull_word(src_row[dir], w, dx[dir]);
+
+        collide_words<Word, KIND>(node_state, row + w, dst_row + w, dst_dir_stride, step);
+    }
+
+    // Clear the bits beyond the last cell of the row, which are not covered by a cell type mask in
+    // rows of uniform kind
+    if (KIND != RowKind::MIXED) {
+
+        const Word last_word_mask = ~Word(0) >> (BITS_PER_WORD - 1 - m_last_bit);
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            dst_row[dir * dst_dir_stride + m_num_words_x - 1] &= last_word_mask;
+    }
+}
+
+// Performs the collision and propagation step on the rows in [y_begin, y_end), pulling the node
+// states from the source bit planes and writing the results to the destination bit planes. The
+// kind of every row is given by the boundary policy, which resolves it at compile time for
+// periodic domains.
+template<Model model_>
+template<typename Vec, typename Policy>
+LGCA_FORCE_INLINE void BitPlane_Lattice<model_>::step_rows(const PlaneView& src, const PlaneView& dst,
+                                                           const int y_begin, const int y_end,
+                                                           const uint64_t step) {
+
+    const int dim_y = this->m_dim_y;
+
+    for (int y = y_begin; y != y_end; ++y)
+    {
+        // The row index may lie outside of the lattice for the rows of tiles, which is why the
+        // parity is taken from the lowest bit (the number of rows is even for the FHP models)
+        const int parity = y & 1;
+
+        // Get the rows of the bit planes the node states are pulled from
+        const Word* src_row[this->NUM_DIR];
+        int         dx     [this->NUM_DIR];
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+            src_row[dir] = plane_row(src, dir, y + m_pull.dy[parity][dir]);
+            dx     [dir] = m_pull.dx[parity][dir];
+        }
+
+        // Get the row of the destination bit planes and of the cell type masks
+        Word* dst_row = plane_row(dst, 0, y);
+
+        const int    y_lattice = (y % dim_y + dim_y) % dim_y;
+        const size_t row       = y_lattice * m_num_words_x;
+
+        switch (Policy::row_kind(y_lattice, dim_y)) {
+        case RowKind::FLUID:   step_row<Vec, RowKind::FLUID  >(src_row, dx, dst_row, dst.dir_stride, row, step); break;
+        case RowKind::NO_SLIP: step_row<Vec, RowKind::NO_SLIP>(src_row, dx, dst_row, dst.dir_stride, row, step); break;
+        case RowKind::MIXED:   step_row<Vec, RowKind::MIXED  >(src_row, dx, dst_row, dst.dir_stride, row, step); break;
+        }
+    }
+}
+
+template<Model model_>
+template<typename Policy>
+void BitPlane_Lattice<model_>::step_rows_scalar(const PlaneView& src, const PlaneView& dst,
+                                                const int y_begin, const int y_end,
+                                                const uint64_t step) {
+
+    step_rows<Word, Policy>(src, dst, y_begin, y_end, step);
+}
+
+#ifdef LGCA_SIMD_DISPATCH
+template<Model model_>
+template<typename Policy>
+LGCA_TARGET_AVX2 void BitPlane_Lattice<model_>::step_rows_avx2(const PlaneView& src, const PlaneView& dst,
+                                                               const int y_begin, const int y_end,
+                                                               const uint64_t step) {
+
+    step_rows<Word256, Policy>(src, dst, y_begin, y_end, step);
+}
+
+template<Model model_>
+template<typename Policy>
+LGCA_TARGET_AVX512 void BitPlane_Lattice<model_>::step_rows_avx512(const PlaneView& src, const PlaneView& dst,
+                                                                   const int y_begin, const int y_end,
+                                                                   const uint64_t step) {
+
+    step_rows<Word512, Policy>(src, dst, y_begin, y_end, step);
+}
+#endif
+
+// Returns the step kernel specialized for the boundary policy and the instruction set extension
+template<Model model_>
+template<typename Policy>
+typename BitPlane_Lattice<model_>::StepRows BitPlane_Lattice<model_>::step_kernel() const {
+
+#ifdef LGCA_SIMD_DISPATCH
+    if (m_simd_isa == SimdIsa::AVX512) return &BitPlane_Lattice::step_rows_avx512<Policy>;
+    if (m_simd_isa == SimdIsa::AVX2)   return &BitPlane_Lattice::step_rows_avx2  <Policy>;
+#endif
+
+    return &BitPlane_Lattice::step_rows_scalar<Policy>;
+}
+
+// Restricts the step kernel to the specified instruction set extension.
+template<Model model_>
+void BitPlane_Lattice<model_>::set_simd_isa(const SimdIsa isa) {
+
+    assert(int(isa) <= int(detect_simd_isa()));
+
+    m_simd_isa = isa;
+
+    // The step kernel is chosen again if the cell types have been packed already
+    if (m_planes_valid) select_step_kernel();
+}
+
+// Chooses the boundary policy matching the cell types and the step kernel specialized for it.
+template<Model model_>
+void BitPlane_Lattice<model_>::select_step_kernel() {
+
+    m_boundary = detect_boundary(this->m_cell_type_cpu, this->m_dim_x, this->m_dim_y);
+
+    switch (m_boundary) {
+    case Boundary::GENERIC:  m_step_rows = step_kernel<GenericBoundary> (); break;
+    case Boundary::CHANNEL:  m_step_rows = step_kernel<ChannelBoundary> (); break;
+    case Boundary::PERIODIC: m_step_rows = step_kernel<PeriodicBoundary>(); break;
+    }
+}
+
+// Performs the collision and propagation step on the lattice gas automaton.
+template<Model model_>
+void BitPlane_Lattice<model_>::collide_and_propagate(const bool p) {
+
+#ifndef NDEBUG
+            // Check weather the domain dimensions are valid for the FHP model.
+            if (this->m_dim_y % 2 != 0 && (model_ == Model::FHP_I || model_ == Model::FHP_II || model_ == Model::FHP_III)) {
+
+                printf("ERROR in BitPlane_Lattice<Model::FHP>::collide_and_propagate(): "
+                       "Invalid domain dimension in y direction.\n");
+                abort();
+            }
+#endif
+
+    if (!m_planes_valid) pack();
+
+    const PlaneView src = lattice_planes(m_node_plane.front());
+    const PlaneView dst = lattice_planes(m_node_plane.back());
+
+    // Loop over bunches of rows, with the same partition as the first touch of the bit planes
+    m_rows.run([&](const int /*part*/, const int y_begin, const int y_end) {
+
+        (this->*m_step_rows)(src, dst, y_begin, y_end, m_step);
+    });
+
+    // Update the node states
+    m_node_plane.swap();
+
+    ++m_step;
+}
+
+// Performs the specified number of collision and propagation steps. The lattice is split into
+// tiles of rows, which are advanced by up to m_time_block_steps steps at once while they reside in
+// the cache. Since the node states propagate by (at most) one row per step, a tile advanced by k
+// steps depends on the k rows next to it, which are computed redundantly by the neighboring tiles.
+// The results are identical to the ones of the same number of single steps.
+template<Model model_>
+void BitPlane_Lattice<model_>::advance(const unsigned int n_steps) {
+
+    if (!m_planes_valid) pack();
+
+    const int dim_y = this->m_dim_y;
+
+    unsigned int step = 0;
+
+    while (step < n_steps) {
+
+        const int k = std::min(n_steps - step, m_time_block_steps);
+
+        if (k == 1) {
+
+            collide_and_propagate(false);
+            step++;
+            continue;
+        }
+
+        // Choose the number of rows of a tile such that its two auxiliary bit plane sets fit into
+        // the tile size, and every thread gets a tile at least. The tile size is measured on the
+        // first calls among fractions and multiples of the L2 cache of a core (the node states do
+        // not depend on it). The tiles are processed by the threads in parallel.
+        const size_t l2_size = Tuning::l2_cache_size();
+        const std::vector<size_t> tile_sizes = { l2_size / 2, l2_size, 2 * l2_size, 4 * l2_size };
+
+        const size_t tile_size  = Tuning::trial_value("bitplane.time_block_tile_bytes", tile_sizes);
+        const size_t row_size   = 2 * this->NUM_DIR * m_num_words_x * sizeof(Word);
+        const int    max_rows   = (dim_y - 1) / Threads::num_threads() + 1;
+        const int    tile_rows  = std::max(2, std::min(max_rows, int(tile_size / row_size) - 2 * (k - 1)));
+        const int    num_tiles  = (dim_y - 1) / tile_rows + 1;
+
+        // Rows of the auxiliary bit plane sets of a tile, including the rows next to the tile which
+        // are needed by the following steps
+        const int    halo_rows  = tile_rows + 2 * (k - 1);
+        const size_t dir_stride = halo_rows * m_num_words_x;
+
+        const PlaneView src = lattice_planes(m_node_plane.front());
+        const PlaneView dst = lattice_planes(m_node_plane.back());
+
+        const steady_clock::time_point start = steady_clock::now();
+
+        Threads::static_parallel_for(0, num_tiles, [&](const int tile_begin, const int tile_end) {
+
+            std::vector<Word>& tile_buffer = m_tile_buffer.local();
+
+            if (tile_buffer.size() < 2 * this->NUM_DIR * dir_stride)
+                tile_buffer.resize(2 * this->NUM_DIR * dir_stride);
+
+            for (int tile = tile_begin; tile != tile_end; ++tile) {
+
+                const int y_begin = tile * tile_rows;
+                const int y_end   = std::min(y_begin + tile_rows, dim_y);
+
+                // Auxiliary bit plane sets holding the rows [y_begin - k + 1, y_end + k - 1)
+                PlaneView tile_src = { &tile_buffer[0],                            dir_stride, y_begin - k + 1, false };
+                PlaneView tile_dst = { &tile_buffer[this->NUM_DIR * dir_stride], dir_stride, y_begin - k + 1, false };
+
+                // The first step pulls from the bit planes of the lattice, the rows computed shrink
+                // by one on each side with every step, and the last step writes the rows of the
+                // tile to the bit planes of the lattice
+                for (int s = 1; s <= k; ++s) {
+
+                    const PlaneView& step_src = (s == 1) ? src : tile_src;
+                    const PlaneView& step_dst = (s == k) ? dst : tile_dst;
+
+                    (this->*m_step_rows)(step_src, step_dst, y_begin - (k - s), y_end + (k - s), m_step + s - 1);
+
+                    std::swap(tile_src, tile_dst);
+                }
+            }
+        });
+
+        Tuning::record("bitplane.time_block_tile_bytes", tile_sizes, tile_size,
+                       duration<double>(steady_clock::now() - start).count() / k);
+
+        // Update the node states
+        m_node_plane.swap();
+
+        step   += k;
+        m_step += k;
+    }
+}
+
+// Applies a body force in the specified direction (x or y) and with the
+// specified intensity to the particles. E.g., if the intensity is equal 100,
+// every 100th particle changes it's direction, if feasible.
+//
+// Exactly min(forcing, E) of the E sites (particles of fluid cells which can be reverted) are
+// reverted by the threads in parallel, see ForcingSampler. The sites are selected like the ones of
+// OMP_Lattice, i.e. both lattices revert the same particles given the same seed.
+template<Model model_>
+void BitPlane_Lattice<model_>::apply_body_force(const int forcing) {
+
+    if (!m_planes_valid) pack();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    Word* const node_plane = m_node_plane.front();
+
+    m_forcing.apply(this->m_dim_y, m_num_words_x * this->NUM_DIR * sizeof(Word), std::max(forcing, 0),
+
+        // Counts the sites of a row
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); },
+
+        // Reverts the selected sites of a row
+        [&](const int y, const uint32_t* selected, const size_t num_selected) {
+
+            const uint32_t* const selected_end = selected + num_selected;
+
+            size_t rank = 0;
+
+            for (unsigned int p = 0; p < num_pairs; ++p) {
+
+                for (size_t w = 0; w < m_num_words_x && selected != selected_end; ++w) {
+
+                    Word flip = 0;
+
+                    ForcingSampler::revert_selected(forcing_sites(y, w, pairs[p]), rank, selected, selected_end,
+                        [&](const int bit) { flip |= Word(1) << bit; });
+
+                    const size_t word = y * m_num_words_x + w;
+
+                    node_plane[pairs[p].from * m_num_words + word] ^= flip;
+                    node_plane[pairs[p].to   * m_num_words + word] ^= flip;
+                }
+            }
+        });
+}
+
+// Applies a body force of the specified intensity spread over the next num_steps steps by the step
+// kernel, which reverts every site with probability forcing / (E num_steps) per step, with E the
+// current number of sites (see FusedForcing).
+template<Model model_>
+bool BitPlane_Lattice<model_>::set_fused_forcing(const int forcing, const unsigned int num_steps) {
+
+    if (!m_planes_valid) pack();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    const size_t num_sites = ForcingSampler::count(this->m_dim_y, m_num_words_x * this->NUM_DIR * sizeof(Word),
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); });
+
+    const double probability = (forcing > 0 && num_sites > 0 && num_steps > 0)
+                             ? double(forcing) / (double(num_sites) * num_steps)
+                             : 0.0;
+
+    return m_fused_forcing.set<model_>(this->m_bf_dir, probability);
+}
+
+// Returns the sites of the specified pair of the cells of word w of row y. Body forces are applied
+// to fluid cells only.
+template<Model model_>
+typename BitPlane_Lattice<model_>::Word BitPlane_Lattice<model_>::forcing_sites(const int y, const size_t w,
+                                                                               const ForcingPair& pair) const {
+
+    const Word*  node_plane = m_node_plane.front();
+    const size_t word       = y * m_num_words_x + w;
+
+    return m_fluid_mask[word] & node_plane[pair.from * m_num_words + word] & ~node_plane[pair.to * m_num_words + word];
+}
+
+// Returns the number of sites of the specified pairs of the cells of row y
+template<Model model_>
+size_t BitPlane_Lattice<model_>::count_forcing_sites(const int y, const ForcingPair* pairs,
+                                                     const unsigned int num_pairs) const {
+
+    size_t num_sites = 0;
+
+    for (unsigned int p = 0; p < num_pairs; ++p)
+        for (size_t w = 0; w < m_num_words_x; ++w)
+            num_sites += __builtin_popcountll(forcing_sites(y, w, pairs[p]));
+
+    return num_sites;
+}
+
+// Returns the number of particles in the lattice.
+template<Model model_>
+unsigned long BitPlane_Lattice<model_>::get_n_particles() {
+
+    if (!m_planes_valid) return Lattice<model_>::get_n_particles();
+
+    const size_t num_words = this->NUM_DIR * m_num_words;
+    const size_t grain     = Tuning::grain_size("bitplane.get_n_particles", num_words, sizeof(Word));
+
+    size_t n_particles = Threads::parallel_reduce(tbb::blocked_range<size_t>(0, num_words, grain), size_t(0),
+        [&](const tbb::blocked_range<size_t>& r, size_t n) {
+            for (size_t word = r.begin(); word != r.end(); ++word)
+                n += __builtin_popcountll(m_node_plane.front()[word]);
+            return n;
+        }, std::plus<size_t>());
+
+    this->m_num_particles = n_particles;
+
+    return n_particles;
+}
+
+// Unpacks the current node states to the output buffer for post-processing and visualization.
+template<Model model_>
+void BitPlane_Lattice<model_>::copy_data_to_output_buffer() {
+
+    if (!m_planes_valid) Lattice<model_>::copy_data_to_output_buffer();
+    else                 unpack(this->m_node_state_out_cpu);
+}
+
+// Packs the node states and the cell types into bit planes.
+template<Model model_>
+void BitPlane_Lattice<model_>::pack() {
+
+    const int dim_x = this->m_dim_x;
+    const int dim_y = this->m_dim_y;
+
+    // Every cell of a row reads its node states and cell type
+    const int grain = Tuning::grain_size("bitplane.pack", dim_y, dim_x * (1 + sizeof(CellType)));
+
+    Threads::parallel_for(tbb::blocked_range<int>(0, dim_y, grain), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
+    {
+        for (size_t w = 0; w < m_num_words_x; ++w) {
+
+            const size_t word = y * m_num_words_x + w;
+
+            Word node_state[this->NUM_DIR] = { };
+            Word fluid     = 0;
+            Word no_slip   = 0;
+            Word slip_x    = 0;
+            Word slip_y    = 0;
+            Word slip_keep = 0;
+
+            for (unsigned int bit = 0; bit < BITS_PER_WORD; ++bit) {
+
+                const int x = w * BITS_PER_WORD + bit;
+                if (x >= dim_x) break;
+
+                const size_t cell = y * dim_x + x;
+                const Word   mask = Word(1) << bit;
+
+                // The node states of a cell are held by one block of the bitset
+                const Bitset::Block cell_state = this->m_node_state_cpu(cell);
+
+                for (int dir = 0; dir < this->NUM_DIR; ++dir)
+                    if (cell_state & (1 << dir)) node_state[dir] |= mask;
+
+                switch (this->m_cell_type_cpu[cell]) {
+
+                case CellType::FLUID:         fluid   |= mask; break;
+                case CellType::SOLID_NO_SLIP: no_slip |= mask; break;
+                case CellType::SOLID_SLIP:
+                {
+                    // Bounce forward along the y axis takes precedence in the corners
+                    if      (x == 0 || x == dim_x - 1) slip_y    |= mask;
+                    else if (y == 0 || y == dim_y - 1) slip_x    |= mask;
+                    else                               slip_keep |= mask;
+                    break;
+                }
+                }
+            }
+
+            for (int dir = 0; dir < this->NUM_DIR; ++dir)
+                m_node_plane.front()[dir * m_num_words + word] = node_state[dir];
+
+            m_fluid_mask    [word] = fluid;
+            m_no_slip_mask  [word] = no_slip;
+            m_slip_x_mask   [word] = slip_x;
+            m_slip_y_mask   [word] = slip_y;
+            m_slip_keep_mask[word] = slip_keep;
+        }
+    }});
+
+    select_step_kernel();
+
+    // The bit planes hold the node states from now on
+    this->m_node_state_cpu.resize(0);
+
+    m_planes_valid = true;
+}
+
+// Unpacks the bit planes of the node states into the specified bitset.
+template<Model model_>
+void BitPlane_Lattice<model_>::unpack(Bitset& node_state) const {
+
+    assert(node_state.size() == this->m_num_cells * 8);
+
+    const int dim_x = this->m_dim_x;
+    const int grain = Tuning::grain_size("bitplane.unpack", this->m_dim_y, dim_x);
+
+    Threads::parallel_for(tbb::blocked_range<int>(0, this->m_dim_y, grain), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
+    {
+        for (int x = 0; x < dim_x; ++x) {
+
+            const size_t word = y * m_num_words_x + x / BITS_PER_WORD;
+            const int    bit  = x % BITS_PER_WORD;
+
+            Bitset::Block cell_state = 0;
+
+#pragma unroll
+            for (int dir = 0; dir < this->NUM_DIR; ++dir)
+                cell_state |= ((m_node_plane.front()[dir * m_num_words + word] >> bit) & Word(1)) << dir;
+
+            node_state(y * dim_x + x) = cell_state;
+        }
+    }});
+}
+
+// Unpacks the current node states to the staging node states, so that they are packed again with
+// the cell type masks of the new cell types on the next step.
+template<Model model_>
+void BitPlane_Lattice<model_>::invalidate_cell_types() {
+
+    if (!m_planes_valid) return;
+
+    if (this->m_node_state_cpu.size() == 0) this->m_node_state_cpu.resize(this->m_num_cells * 8);
+
+    unpack(this->m_node_state_cpu);
+
+    m_planes_valid = false;
+}
+
+// Allocates the memory for the arrays on the host (CPU).
+template<Model model_>
+void BitPlane_Lattice<model_>::allocate_memory()
+{
+    // Allocate host memory
+    this->m_cell_type_cpu     = (CellType*)malloc(                    this->m_num_cells        * sizeof(CellType));
+    this->m_cell_density_cpu  = (    Real*)malloc(                    this->m_num_cells        * sizeof(    Real));
+    this->m_mean_density_cpu  = (    Real*)malloc(                    this->m_num_coarse_cells * sizeof(    Real));
+    this->m_cell_momentum_cpu = (    Real*)malloc(this->SPATIAL_DIM * this->m_num_cells        * sizeof(    Real));
+    this->m_mean_momentum_cpu = (    Real*)malloc(this->SPATIAL_DIM * this->m_num_coarse_cells * sizeof(    Real));
+
+    this->m_node_state_cpu.resize    (this->m_num_cells * 8);
+    this->m_node_state_out_cpu.resize(this->m_num_cells * 8);
+
+    // The bit planes and masks are zero-filled by first_touch(). The masks are streamed by the
+    // step kernels along with the bit planes and are backed by huge pages as well, where possible.
+    m_node_plane.allocate(this->NUM_DIR * m_num_words, /*zero_fill=*/false);
+
+    m_fluid_mask     = (Word*)HugePageAllocator::allocate(m_num_words * sizeof(Word));
+    m_no_slip_mask   = (Word*)HugePageAllocator::allocate(m_num_words * sizeof(Word));
+    m_slip_x_mask    = (Word*)HugePageAllocator::allocate(m_num_words * sizeof(Word));
+    m_slip_y_mask    = (Word*)HugePageAllocator::allocate(m_num_words * sizeof(Word));
+    m_slip_keep_mask = (Word*)HugePageAllocator::allocate(m_num_words * sizeof(Word));
+
+    first_touch();
+}
+
+// Zero-fills the bit planes and masks row by row, so that their pages are placed on the NUMA nodes
+// of the threads updating the rows.
+template<Model model_>
+void BitPlane_Lattice<model_>::first_touch()
+{
+    Threads::static_parallel_for(0, m_rows.num_parts(), [&](const int part_begin, const int part_end) {
+
+        const int y_begin = m_rows.begin(part_begin);
+        const int y_end   = m_rows.end(part_end - 1);
+
+        const size_t word_begin = y_begin * m_num_words_x;
+        const size_t num_bytes  = (y_end - y_begin) * m_num_words_x * sizeof(Word);
+
+        for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+            memset(m_node_plane.front() + dir * m_num_words + word_begin, 0, num_bytes);
+            memset(m_node_plane.back()  + dir * m_num_words + word_begin, 0, num_bytes);
+        }
+
+        memset(m_fluid_mask     + word_begin, 0, num_bytes);
+        memset(m_no_slip_mask   + word_begin, 0, num_bytes);
+        memset(m_slip_x_mask    + word_begin, 0, num_bytes);
+        memset(m_slip_y_mask    + word_begin, 0, num_bytes);
+        memset(m_slip_keep_mask + word_begin, 0, num_bytes);
+    });
+}
+
+// Frees the memory for the arrays on the host (CPU).
+template<Model model_>
+void BitPlane_Lattice<model_>::free_memory()
+{
+    // Free CPU memory
+    free(this->m_cell_type_cpu);
+    free(this->m_cell_density_cpu);
+    free(this->m_mean_density_cpu);
+    free(this->m_cell_momentum_cpu);
+    free(this->m_mean_momentum_cpu);
+
+    m_node_plane.release();
+
+    HugePageAllocator::deallocate(m_fluid_mask,     m_num_words * sizeof(Word));
+    HugePageAllocator::deallocate(m_no_slip_mask,   m_num_words * sizeof(Word));
+    HugePageAllocator::deallocate(m_slip_x_mask,    m_num_words * sizeof(Word));
+    HugePageAllocator::deallocate(m_slip_y_mask,    m_num_words * sizeof(Word));
+    HugePageAllocator::deallocate(m_slip_keep_mask, m_num_words * sizeof(Word));
+
+    this->m_cell_type_cpu       = NULL;
+    this->m_cell_density_cpu    = NULL;
+    this->m_mean_density_cpu    = NULL;
+    this->m_cell_momentum_cpu   = NULL;
+    this->m_mean_momentum_cpu   = NULL;
+
+    m_fluid_mask                = NULL;
+    m_no_slip_mask              = NULL;
+    m_slip_x_mask               = NULL;
+    m_slip_y_mask               = NULL;
+    m_slip_keep_mask            = NULL;
+}
+
+// Sets (proper) parallelization parameters.
+template<Model model_>
+void BitPlane_Lattice<model_>::setup_parallel()
+{
+    printf("BitPlane configuration parameters: Executing calculation with %d threads "
+           "on %zu words of %u cells per bit plane using the %s kernel.\n\n",
+           Threads::num_threads(), m_num_words, BITS_PER_WORD,
+           simd_isa_name(m_simd_isa));
+
+    HugePageAllocator::print_usage();
+}
+
+// Explicit instantiations
+template class BitPlane_Lattice<Model::HPP>;
+template class BitPlane_Lattice<Model::FHP_I>;
+template class BitPlane_Lattice<Model::FHP_II>;
+template class BitPlane_Lattice<Model::FHP_III>;
+
+} // namespace lgca
@@ -0,0 +1,275 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_BITPLANE_LATTICE_H_
+#define LGCA_BITPLANE_LATTICE_H_
+
+#include "lattice.h"
+#include "lgca_boundary.h"
+#include "lgca_forcing.h"
+#include "lgca_memory.h"
+#include "lgca_parallel.h"
+#include "lgca_random.h"
+#include "lgca_simd.h"
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace lgca {
+
+// Bit-sliced (multi-spin coded) lattice gas cellular automaton. The node states are stored
+// direction-major in bit planes, i.e. one bit per cell and one word per 64 consecutive cells of a
+// row, so that the collision rules of the model descriptor are evaluated on whole words.
+//
+// The node states set up by the init functions of the base class are packed into the bit planes
+// on the first step (or the first body force), which releases the node states of the base class.
+// Collision and propagation results are identical to the ones of OMP_Lattice.
+template<Model model_>
+class BitPlane_Lattice: public Lattice<model_> {
+
+public:
+
+    using Word = uint64_t;
+
+    static constexpr unsigned int BITS_PER_WORD = std::numeric_limits<Word>::digits;
+
+private:
+
+    using ModelDesc = ModelDescriptor<model_>;
+
+    // Number of words per row and per bit plane
+    size_t m_num_words_x;
+    size_t m_num_words;
+
+    // Index of the last valid bit in the last word of a row
+    unsigned int m_last_bit;
+
+    // Shifts of the neighbor cells the node states are pulled from during the propagation step
+    PullShifts<model_> m_pull;
+
+    // Bit planes of the node states (front) in the following sense:
+    //
+    // [DIR_0_ROW_0_WORD_0|DIR_0_ROW_0_WORD_1|...|DIR_0_ROW_1_WORD_0|...|DIR_1_ROW_0_WORD_0|...]
+    //
+    // and auxiliary bit planes (back) written by the steps
+    DoubleBuffer<Word, HugePageAllocator> m_node_plane;
+
+    // Generator of the random bits for collision, which are drawn afresh for every step from the
+    // index of the step and the index of the word of the cells
+    CounterRng m_rng;
+
+    // Number of steps performed so far
+    uint64_t m_step;
+
+    // Selection of the particles reverted by the body force
+    ForcingSampler m_forcing;
+
+    // Body force applied by the step kernel (fused forcing)
+    FusedForcing m_fused_forcing;
+
+    // Bit plane masks of the cell types. Slip cells are split into cells on the northern or
+    // southern boundary (bounce forward along the x axis), cells on the eastern or western
+    // boundary (bounce forward along the y axis), and interior cells (states are kept).
+    Word* m_fluid_mask;
+    Word* m_no_slip_mask;
+    Word* m_slip_x_mask;
+    Word* m_slip_y_mask;
+    Word* m_slip_keep_mask;
+
+    // Whether the bit planes hold the current node states
+    bool m_planes_valid;
+
+    // Partition of the rows into one bunch of rows per thread, which is rebalanced by the measured
+    // time of the bunches every REBALANCE_STEPS steps. The bit planes and masks are first touched
+    // with the same partition.
+    BalancedPartition m_rows;
+
+    static constexpr int REBALANCE_STEPS = 64;
+
+    // Set of bit planes holding consecutive rows of the node states. The rows of the bit planes of
+    // the lattice wrap around periodically, while the auxiliary bit planes of a tile hold a range
+    // of rows starting at the specified (possibly negative or exceeding) row index.
+    struct PlaneView {
+        Word*  node_state; // First word of the bit plane in direction 0
+        size_t dir_stride; // Number of words between the bit planes of consecutive directions
+        int    y_first;    // Index of the first row
+        bool   periodic;   // Whether the row indices wrap around periodically
+    };
+
+    // Maximum number of steps a tile is advanced by at once
+    unsigned int m_time_block_steps;
+
+    // Auxiliary bit planes of the tiles for every thread
+    tbb::enumerable_thread_specific<std::vector<Word>> m_tile_buffer;
+
+    // Returns the set of bit planes of the lattice starting at the specified word
+    PlaneView lattice_planes(Word* node_state) const {
+
+        return PlaneView { node_state, m_num_words, 0, true };
+    }
+
+    // Returns the row with the specified index of the bit plane in direction dir
+    LGCA_FORCE_INLINE Word* plane_row(const PlaneView& planes, const int dir, const int y) const {
+
+        const int dim_y = this->m_dim_y;
+        const int row   = planes.periodic ? (y % dim_y + dim_y) % dim_y : y - planes.y_first;
+
+        return planes.node_state + dir * planes.dir_stride + row * m_num_words_x;
+    }
+
+    // Step kernel for a range of rows, chosen at run time according to the instruction set
+    // extensions supported by the CPU
+    using StepRows = void (BitPlane_Lattice::*)(const PlaneView& src, const PlaneView& dst,
+                                                const int y_begin, const int y_end,
+                                                const uint64_t step);
+
+    StepRows m_step_rows;
+    SimdIsa  m_simd_isa;
+    Boundary m_boundary;
+
+    // Performs the collision and propagation step with the specified index on the rows in
+    // [y_begin, y_end) of the source bit planes and writes the results to the destination bit
+    // planes, processing sizeof(Vec) / sizeof(Word) words of a row at once. The kernel is
+    // specialized for the boundary policy.
+    template<typename Vec, typename Policy>
+    LGCA_FORCE_INLINE void step_rows(const PlaneView& src, const PlaneView& dst,
+                                     const int y_begin, const int y_end, const uint64_t step);
+
+    // Performs the collision and propagation step on a row of the specified kind
+    template<typename Vec, RowKind KIND>
+    LGCA_FORCE_INLINE void step_row(const Word* const* src_row, const int* dx,
+                                    Word* dst_row, const size_t dst_dir_stride,
+                                    const size_t row, const uint64_t step);
+
+    // Executes the collision step on the pulled node states of the words starting at the
+    // specified word index of the cell type masks and writes the results to the destination
+    template<typename Vec, RowKind KIND>
+    LGCA_FORCE_INLINE void collide_words(const Vec* node_state, const size_t word,
+                                         Word* dst, const size_t dst_dir_stride, const uint64_t step);
+
+    template<typename Policy>                    void step_rows_scalar(const PlaneView& src, const PlaneView& dst, const int y_begin, const int y_end, const uint64_t step);
+#ifdef LGCA_SIMD_DISPATCH
+    template<typename Policy> LGCA_TARGET_AVX2   void step_rows_avx2  (const PlaneView& src, const PlaneView& dst, const int y_begin, const int y_end, const uint64_t step);
+    template<typename Policy> LGCA_TARGET_AVX512 void step_rows_avx512(const PlaneView& src, const PlaneView& dst, const int y_begin, const int y_end, const uint64_t step);
+#endif
+
+    // Returns the step kernel specialized for the boundary policy and the instruction set
+    // extension in use
+    template<typename Policy>
+    StepRows step_kernel() const;
+
+    // Chooses the boundary policy matching the cell types and the step kernel specialized for it
+    void select_step_kernel();
+
+    // Packs the node states and the cell types into bit planes
+    void pack();
+
+    // Unpacks the bit planes of the node states into the specified bitset
+    void unpack(Bitset& node_state) const;
+
+    // Makes the next step pack the staged node states into bit planes again
+    void invalidate_node_states() { m_planes_valid = false; }
+
+    // Unpacks the current node states to the staging node states, so that they are packed again
+    // with the new cell types on the next step
+    void invalidate_cell_types();
+
+    // Returns the word of the specified row which holds the node states of the cells shifted by dx
+    // in x direction, wrapping around periodically
+    LGCA_FORCE_INLINE Word pull_word(const Word* row, const size_t w, const int dx) const;
+
+    // Returns the sites of the specified pair of the cells of word w of row y
+    Word forcing_sites(const int y, const size_t w, const ForcingPair& pair) const;
+
+    // Returns the number of sites of the specified pairs of the cells of row y
+    size_t count_forcing_sites(const int y, const ForcingPair* pairs, const unsigned int num_pairs) const;
+
+    // Zero-fills the bit planes and masks row by row, so that their pages are placed on the NUMA
+    // nodes of the threads updating the rows
+    void first_touch();
+
+    // Allocates the memory for the arrays on the host (CPU).
+    void allocate_memory();
+
+    // Frees the memory for the arrays on the host (CPU).
+    void free_memory();
+
+public:
+
+    // Creates a bit-sliced, TBB parallelized lattice gas cellular automaton object of the
+    // specified properties.
+    BitPlane_Lattice(const string m_test_case,
+                     const Real m_Re, const Real m_Ma_s,
+                     const int m_coarse_graining_radius);
+
+    virtual ~BitPlane_Lattice();
+
+    // Sets (proper) parallelization parameters.
+    void setup_parallel();
+
+    // Performs the collision and propagation step on the lattice gas automaton.
+    void collide_and_propagate(const bool p);
+
+    // Performs the specified number of collision and propagation steps, advancing cache-sized
+    // tiles of the lattice by several steps at once (temporal blocking)
+    void advance(const unsigned int n_steps);
+
+    // Sets the maximum number of steps a tile is advanced by at once. With 1 every step sweeps the
+    // whole lattice.
+    void set_time_block_steps(const unsigned int steps) { m_time_block_steps = std::max(1u, steps); }
+
+    // Applies a body force in the specified direction (x or y) and with the
+    // specified intensity to the particles. E.g., if the intensity is equal 100,
+    // every 100th particle changes it's direction, if feasible.
+    void apply_body_force(const int forcing);
+
+    // Applies a body force of the specified intensity spread over the next num_steps steps by the
+    // step kernel (fused forcing)
+    bool set_fused_forcing(const int forcing, const unsigned int num_steps);
+
+    // Returns the number of particles in the lattice
+    unsigned long get_n_particles();
+
+    // Unpacks the current node states to the output buffer for post-processing and visualization
+    void copy_data_to_output_buffer();
+
+    // Sets the seed of the random bits for collision and of the selection of the particles
+    // reverted by the body force. Runs with the same seed are reproducible bit by bit, independent
+    // of the number of threads and the time blocking.
+    void set_seed(const uint64_t seed) { m_rng.set_seed(seed); m_forcing.set_seed(seed); }
+
+    // Restricts the step kernel to the specified instruction set extension, which must be
+    // supported by the CPU
+    void set_simd_isa(const SimdIsa isa);
+
+    // Returns the instruction set extension the step kernel has been compiled for
+    SimdIsa simd_isa() const { return m_simd_isa; }
+
+    // Returns the boundary policy the step kernel is specialized for (determined from the cell
+    // types on the first step)
+    Boundary boundary() const { return m_boundary; }
+};
+
+} // namespace lgca
+
+#endif /* LGCA_BITPLANE_LATTICE_H_ */
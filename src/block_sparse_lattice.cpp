@@ -0,0 +1,795 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lgca_common.h"
+
+#include "block_sparse_lattice.h"
+#include "lgca_parallel.h"
+
+#include <tbb/blocked_range.h>
+
+#include <algorithm>
+#include <cstring> // memcpy
+#include <vector>
+
+namespace lgca {
+
+// Definition of the block size, which is bound to references (e.g. by std::min)
+template<Model model_> constexpr int BlockSparse_Lattice<model_>::BLOCK_DIM;
+
+// Creates a block-sparse, TBB parallelized lattice gas cellular automaton object of the specified
+// properties.
+template<Model model_>
+BlockSparse_Lattice<model_>::BlockSparse_Lattice(const string test_case,
+                                                 const Real Re, const Real Ma_s,
+                                                 const int coarse_graining_radius)
+                    : Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius),
+                      m_num_blocks(0),
+                      m_num_fluid_cells(0),
+                      m_blocks(NULL),
+                      m_block_lut_row(NULL),
+                      m_block_fluid_mask(NULL),
+                      m_pull(this->m_dim_x, this->m_dim_y),
+                      m_step(0),
+                      m_blocks_valid(false),
+                      m_block_order(BlockOrder::ROW_MAJOR) {
+
+    m_num_blocks_x    = (this->m_dim_x - 1) / BLOCK_DIM + 1;
+    m_num_blocks_y    = (this->m_dim_y - 1) / BLOCK_DIM + 1;
+    m_num_rnd_words_x = (this->m_dim_x - 1) / BITS_PER_RND_WORD + 1;
+
+    // Allocate the memory for the arrays on the host (CPU). The blocks are allocated when the cell
+    // types are known.
+    allocate_memory();
+}
+
+// Returns the position of the specified block on the Z-order curve, i.e. interleaves the bits of
+// its x (even bits) and y (odd bits) position.
+static inline uint64_t morton_code(const uint32_t x, const uint32_t y) {
+
+    auto spread_bits = [](uint64_t v) {
+
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+        v = (v | (v <<  8)) & 0x00FF00FF00FF00FFull;
+        v = (v | (v <<  4)) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | (v <<  2)) & 0x3333333333333333ull;
+        v = (v | (v <<  1)) & 0x5555555555555555ull;
+
+        return v;
+    };
+
+    return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+// Returns the cell type of a cell of the specified row of the lookup table.
+static inline CellType cell_type_of_row(const unsigned char lut_row) {
+
+    return (lut_row == LUT_FLUID)       ? CellType::FLUID
+         : (lut_row == LUT_BOUNCE_BACK) ? CellType::SOLID_NO_SLIP
+         :                                CellType::SOLID_SLIP;
+}
+
+// Deletes the block-sparse lattice gas cellular automaton object.
+template<Model model_>
+BlockSparse_Lattice<model_>::~BlockSparse_Lattice() {
+
+    this->free_memory();
+}
+
+// Gathers the node states of the specified block and of its neighbor cells into a tile of
+// TILE_DIM x TILE_DIM cells. The neighbor cells are taken from the neighbor blocks, i.e. from the
+// last row or column of the southern and western neighbors and from the first row or column of the
+// northern and eastern neighbors.
+template<Model model_>
+LGCA_FORCE_INLINE void BlockSparse_Lattice<model_>::gather_tile(const size_t block, unsigned char* tile) const {
+
+    const Block& b = m_blocks[block];
+
+    for (int y = -1; y <= b.dim_y; ++y) {
+
+        // Row of neighbor blocks and the row within them the node states are gathered from
+        const int j   = (y < 0) ? 0         : (y < b.dim_y) ? 1 : 2;
+        const int row = (y < 0) ? b.south_y : (y < b.dim_y) ? y : 0;
+
+        unsigned char* tile_row = tile + (y + 1) * TILE_DIM;
+
+        tile_row[0] = block_row(m_block_state.front(), b.neighbor[j][0], row)[b.west_x];
+
+        memcpy(tile_row + 1, block_row(m_block_state.front(), b.neighbor[j][1], row), b.dim_x);
+
+        tile_row[b.dim_x + 1] = block_row(m_block_state.front(), b.neighbor[j][2], row)[0];
+    }
+}
+
+// Performs the collision and propagation step on the specified block with a single table lookup
+// per cell, pulling the node states from the tile of the block. The random bits for collision are
+// the ones of the cells in the words of the rows of the domain, so that the results are identical
+// to the ones of OMP_Lattice. Blocks of fluid cells use a fixed row of the lookup table.
+template<Model model_>
+template<RowKind KIND>
+LGCA_FORCE_INLINE void BlockSparse_Lattice<model_>::step_block(const size_t block, const unsigned char* tile) {
+
+    const Block& b = m_blocks[block];
+
+    const unsigned char* lut_row = m_block_lut_row + block * BLOCK_CELLS;
+
+    for (int y = 0; y < b.dim_y; ++y) {
+
+        const int y_lattice = b.y0 + y;
+
+        // The rows pulled from are fixed for all cells of the row
+        const unsigned char* pull_row[this->NUM_DIR];
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            pull_row[dir] = tile + (y + 1 + m_pull.dy[y_lattice % 2][dir]) * TILE_DIM + 1 + m_pull.dx[y_lattice % 2][dir];
+
+        // Random bits for collision of the cells of the row of the block
+        RndWord rnd;
+        m_rng.bits(RndWord(size_t(y_lattice) * m_num_rnd_words_x + b.x0 / BITS_PER_RND_WORD), m_step, rnd);
+
+        rnd >>= b.x0 % BITS_PER_RND_WORD;
+
+        unsigned char* node_state_out = block_row(m_block_state.back(), block, y);
+
+        for (int x = 0; x < b.dim_x; ++x) {
+
+            // Execute propagation step
+            unsigned int pulled_state = 0;
+
+#pragma unroll
+            for (int dir = 0; dir < this->NUM_DIR; ++dir)
+                pulled_state |= pull_row[dir][x] & (1u << dir);
+
+            const unsigned int row = (KIND == RowKind::FLUID) ? unsigned(LUT_FLUID) : lut_row[y * BLOCK_DIM + x];
+
+            // Execute collision step
+            node_state_out[x] = CollisionLUT<model_>::lookup(row, (rnd >> x) & 1, pulled_state);
+        }
+
+        // Apply the body force to the fluid cells (fused forcing). The cells of the row of the
+        // block are the lanes of the word of random bits starting with lane x0 % 64.
+        if (m_fused_forcing.enabled()) {
+
+            const unsigned int first_lane = b.x0 % BITS_PER_RND_WORD;
+
+            m_fused_forcing.apply_cells(m_rng, size_t(y_lattice) * m_num_rnd_words_x + b.x0 / BITS_PER_RND_WORD, m_step,
+                                        node_state_out, uint64_t(m_block_fluid_mask[block * BLOCK_DIM + y]) << first_lane,
+                                        first_lane);
+        }
+    }
+}
+
+// Performs the collision and propagation step on the lattice gas automaton.
+template<Model model_>
+void BlockSparse_Lattice<model_>::collide_and_propagate(const bool p) {
+
+#ifndef NDEBUG
+            // Check weather the domain dimensions are valid for the FHP model.
+            if (this->m_dim_y % 2 != 0 && (model_ == Model::FHP_I || model_ == Model::FHP_II || model_ == Model::FHP_III)) {
+
+                printf("ERROR in BlockSparse_Lattice<Model::FHP>::collide_and_propagate(): "
+                       "Invalid domain dimension in y direction.\n");
+                abort();
+            }
+#endif
+
+    if (!m_blocks_valid) pack();
+
+    // Loop over bunches of allocated blocks
+    // Every block gathers its tile and writes its node states
+    const size_t grain = Tuning::grain_size("sparse.collide_and_propagate", m_num_blocks,
+                                            TILE_DIM * TILE_DIM + 2 * BLOCK_CELLS);
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, m_num_blocks, grain), [&](const tbb::blocked_range<size_t>& r) {
+
+        unsigned char tile[TILE_DIM * TILE_DIM];
+
+        for (size_t block = r.begin(); block != r.end(); ++block) {
+
+            gather_tile(block, tile);
+
+            if (m_blocks[block].fluid) step_block<RowKind::FLUID>(block, tile);
+            else                       step_block<RowKind::MIXED>(block, tile);
+        }
+    });
+
+    // Update the node states
+    m_block_state.swap();
+
+    ++m_step;
+}
+
+// Applies a body force in the specified direction (x or y) and with the
+// specified intensity to the particles. E.g., if the intensity is equal 100,
+// every 100th particle changes it's direction, if feasible. The sites are selected row by row of
+// the lattice by the forcing sampler, in the same order as by OMP_Lattice (see ForcingSampler).
+template<Model model_>
+void BlockSparse_Lattice<model_>::apply_body_force(const int forcing) {
+
+    if (!m_blocks_valid) pack();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    // Every cell of a row reads its node states and lookup table row
+    m_forcing.apply(this->m_dim_y, 2 * this->m_dim_x, std::max(forcing, 0),
+
+        // Counts the sites of a row
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); },
+
+        // Reverts the selected sites of a row, block by block
+        [&](const int y, const uint32_t* selected, const size_t num_selected) {
+
+            const uint32_t* const selected_end = selected + num_selected;
+
+            size_t rank = 0;
+
+            for (unsigned int p = 0; p < num_pairs; ++p) {
+
+                const unsigned char flip = (1u << pairs[p].from) | (1u << pairs[p].to);
+
+                for (int bx = 0; bx < m_num_blocks_x && selected != selected_end; ++bx) {
+
+                    const size_t block = block_of_cell(bx * BLOCK_DIM, y);
+
+                    // Unallocated blocks hold no fluid cells
+                    if (block == NO_BLOCK) continue;
+
+                    unsigned char* row = block_row(m_block_state.front(), block, y % BLOCK_DIM);
+
+                    ForcingSampler::revert_selected(forcing_sites(block, y % BLOCK_DIM, pairs[p]), rank, selected, selected_end,
+                        [&](const int bit) { row[bit] ^= flip; });
+                }
+            }
+        });
+}
+
+// Applies a body force of the specified intensity spread over the next num_steps steps by the step
+// kernel, which reverts every site with probability forcing / (E num_steps) per step, with E the
+// current number of sites (see FusedForcing).
+template<Model model_>
+bool BlockSparse_Lattice<model_>::set_fused_forcing(const int forcing, const unsigned int num_steps) {
+
+    if (!m_blocks_valid) pack();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    const size_t num_sites = ForcingSampler::count(this->m_dim_y, 2 * this->m_dim_x,
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); });
+
+    const double probability = (forcing > 0 && num_sites > 0 && num_steps > 0)
+                             ? double(forcing) / (double(num_sites) * num_steps)
+                             : 0.0;
+
+    return m_fused_forcing.set<model_>(this->m_bf_dir, probability);
+}
+
+// Returns the sites of the specified pair of the cells of row y of the specified block. Body
+// forces are applied to fluid cells only, so that the cells beyond the domain are masked out by
+// the fluid mask.
+template<Model model_>
+typename BlockSparse_Lattice<model_>::RowMask BlockSparse_Lattice<model_>::forcing_sites(const size_t block, const int y,
+                                                                                        const ForcingPair& pair) const {
+
+    const unsigned char* cells = block_row(m_block_state.front(), block, y);
+
+    RowMask mask = 0;
+
+    for (int i = 0; i < BLOCK_DIM; i += 8)
+        mask |= RowMask(byte_cell_sites(cells + i, pair)) << i;
+
+    return mask & m_block_fluid_mask[block * BLOCK_DIM + y];
+}
+
+// Returns the number of sites of the specified pairs of the cells of row y of the lattice
+template<Model model_>
+size_t BlockSparse_Lattice<model_>::count_forcing_sites(const int y, const ForcingPair* pairs,
+                                                        const unsigned int num_pairs) const {
+
+    size_t num_sites = 0;
+
+    for (int bx = 0; bx < m_num_blocks_x; ++bx) {
+
+        const size_t block = block_of_cell(bx * BLOCK_DIM, y);
+
+        if (block == NO_BLOCK) continue;
+
+        for (unsigned int p = 0; p < num_pairs; ++p)
+            num_sites += __builtin_popcount(forcing_sites(block, y % BLOCK_DIM, pairs[p]));
+    }
+
+    return num_sites;
+}
+
+// Returns the number of particles in the lattice.
+template<Model model_>
+unsigned long BlockSparse_Lattice<model_>::get_n_particles() {
+
+    if (!m_blocks_valid) return Lattice<model_>::get_n_particles();
+
+    const size_t num_cells = m_num_blocks * BLOCK_CELLS;
+    const size_t grain     = Tuning::grain_size("sparse.get_n_particles", num_cells, 1);
+
+    // The cells of the blocks beyond the domain stay empty
+    size_t n_particles = Threads::parallel_reduce(tbb::blocked_range<size_t>(0, num_cells, grain), size_t(0),
+        [&](const tbb::blocked_range<size_t>& r, size_t n) {
+            for (size_t cell = r.begin(); cell != r.end(); ++cell)
+                n += __builtin_popcount(m_block_state.front()[cell]);
+            return n;
+        }, std::plus<size_t>());
+
+    this->m_num_particles = n_particles;
+
+    return n_particles;
+}
+
+// Computes the mean velocity of the lattice from the current node states of the blocks, i.e. the
+// mean of the velocities of the fluid cells holding particles over all fluid cells.
+template<Model model_>
+std::vector<Real> BlockSparse_Lattice<model_>::get_mean_velocity() {
+
+    if (!m_blocks_valid) pack();
+
+    // Summed up x and y velocity components
+    struct VelocitySum {
+        double x, y;
+    };
+
+    const size_t grain = Tuning::grain_size("sparse.get_mean_velocity", m_num_blocks, 2 * BLOCK_CELLS);
+
+    const VelocitySum sum = Threads::parallel_reduce(tbb::blocked_range<size_t>(0, m_num_blocks, grain), VelocitySum{0.0, 0.0},
+        [&](const tbb::blocked_range<size_t>& r, VelocitySum sum) {
+    for (size_t block = r.begin(); block != r.end(); ++block) {
+
+        const Block& b = m_blocks[block];
+
+        for (int y = 0; y < b.dim_y; ++y) {
+
+            const unsigned char* row     = block_row(m_block_state.front(), block, y);
+            const unsigned char* lut_row = m_block_lut_row + block * BLOCK_CELLS + y * BLOCK_DIM;
+
+            for (int x = 0; x < b.dim_x; ++x) {
+
+                if (lut_row[x] != LUT_FLUID || row[x] == 0) continue;
+
+                Real cell_density    = 0.0;
+                Real cell_momentum_x = 0.0;
+                Real cell_momentum_y = 0.0;
+
+#pragma unroll
+                for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+                    const Real node_state = (row[x] >> dir) & 1;
+
+                    cell_density    += node_state;
+                    cell_momentum_x += node_state * ModelDesc::LATTICE_VEC_X[dir];
+                    cell_momentum_y += node_state * ModelDesc::LATTICE_VEC_Y[dir];
+                }
+
+                sum.x += cell_momentum_x / cell_density;
+                sum.y += cell_momentum_y / cell_density;
+            }
+        }
+    }
+        return sum;
+
+    }, [](const VelocitySum& a, const VelocitySum& b) {
+
+        return VelocitySum{a.x + b.x, a.y + b.y};
+    });
+
+    // Divide the summed up x and y components by the total number of fluid cells.
+    std::vector<Real> mean_velocity(this->SPATIAL_DIM, 0.0);
+
+    mean_velocity[0] = Real(sum.x / m_num_fluid_cells);
+    mean_velocity[1] = Real(sum.y / m_num_fluid_cells);
+
+    return mean_velocity;
+}
+
+// Unpacks the current node states to the output buffer for post-processing and visualization.
+template<Model model_>
+void BlockSparse_Lattice<model_>::copy_data_to_output_buffer() {
+
+    allocate_output_buffer();
+
+    if (!m_blocks_valid) Lattice<model_>::copy_data_to_output_buffer();
+    else                 unpack(this->m_node_state_out_cpu);
+}
+
+// Computes quantities of interest from the output buffer as a post-processing procedure. Only the
+// cell quantities of the allocated blocks are computed, the ones of the unallocated blocks vanish
+// and keep the zeros they are allocated with.
+template<Model model_>
+void BlockSparse_Lattice<model_>::post_process() {
+
+    allocate_output_buffer();
+    allocate_cell_quantities();
+
+    if (!m_blocks_valid) {
+
+        Lattice<model_>::post_process();
+        return;
+    }
+
+    const int dim_x = this->m_dim_x;
+
+    // Every cell of a block reads its node states and writes its density and momentum
+    const size_t grain = Tuning::grain_size("sparse.post_process", m_num_blocks,
+                                            BLOCK_CELLS * (1 + (1 + this->SPATIAL_DIM) * sizeof(Real)));
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, m_num_blocks, grain), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t block = r.begin(); block != r.end(); ++block)
+    {
+        const Block& b = m_blocks[block];
+
+        for (int y = b.y0; y < b.y0 + b.dim_y; ++y)
+            for (int x = b.x0; x < b.x0 + b.dim_x; ++x) this->cell_post_process(size_t(y) * dim_x + x);
+    }});
+
+    // Computes coarse grained quantities of interest as a post-processing procedure
+    this->mean_post_process();
+}
+
+// Copies the cell types of the rows [y_begin, y_end) to the specified array. The cell types of the
+// allocated blocks are the ones of the rows of the lookup table, the cells of the unallocated blocks
+// are no-slip cells.
+template<Model model_>
+void BlockSparse_Lattice<model_>::copy_cell_types(CellType* cell_type, const int y_begin, const int y_end) {
+
+    if (!m_blocks_valid) {
+
+        Lattice<model_>::copy_cell_types(cell_type, y_begin, y_end);
+        return;
+    }
+
+    const int dim_x = this->m_dim_x;
+
+    Threads::parallel_for(tbb::blocked_range<int>(y_begin, y_end), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
+    {
+        for (int x = 0; x < dim_x; ++x) {
+
+            const size_t block = block_of_cell(x, y);
+
+            cell_type[size_t(y - y_begin) * dim_x + x] = (block == NO_BLOCK)
+                    ? CellType::SOLID_NO_SLIP
+                    : cell_type_of_row(m_block_lut_row[block * BLOCK_CELLS + (y % BLOCK_DIM) * BLOCK_DIM + x % BLOCK_DIM]);
+        }
+    }});
+}
+
+// Chooses the blocks to allocate, sets them up from the cell types and packs the node states into
+// the blocks. A block is allocated if one of its cells or one of the cells next to it (wrapping
+// around periodically) is not a no-slip cell.
+template<Model model_>
+void BlockSparse_Lattice<model_>::pack() {
+
+    const int dim_x = this->m_dim_x;
+    const int dim_y = this->m_dim_y;
+
+    const size_t num_domain_blocks = size_t(m_num_blocks_x) * m_num_blocks_y;
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, num_domain_blocks), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t domain_block = r.begin(); domain_block != r.end(); ++domain_block)
+    {
+        const int x0 = (domain_block % m_num_blocks_x) * BLOCK_DIM;
+        const int y0 = (domain_block / m_num_blocks_x) * BLOCK_DIM;
+
+        bool allocate = false;
+
+        for (int y = y0 - 1; y <= std::min(y0 + BLOCK_DIM, dim_y) && !allocate; ++y) {
+
+            for (int x = x0 - 1; x <= std::min(x0 + BLOCK_DIM, dim_x); ++x) {
+
+                const size_t cell = size_t((y + dim_y) % dim_y) * dim_x + (x + dim_x) % dim_x;
+
+                if (this->m_cell_type_cpu[cell] != CellType::SOLID_NO_SLIP) {
+
+                    allocate = true;
+                    break;
+                }
+            }
+        }
+
+        m_block_index[domain_block] = allocate ? 0 : NO_BLOCK;
+    }});
+
+    // Number the allocated blocks in the selected order
+    std::vector<size_t> allocated_blocks;
+
+    for (size_t domain_block = 0; domain_block < num_domain_blocks; ++domain_block)
+        if (m_block_index[domain_block] != NO_BLOCK) allocated_blocks.push_back(domain_block);
+
+    if (m_block_order == BlockOrder::MORTON) {
+
+        std::sort(allocated_blocks.begin(), allocated_blocks.end(), [&](const size_t a, const size_t b) {
+
+            return morton_code(a % m_num_blocks_x, a / m_num_blocks_x)
+                 < morton_code(b % m_num_blocks_x, b / m_num_blocks_x);
+        });
+    }
+
+    // Free the blocks set up before (if the cell types have changed)
+    free_blocks();
+
+    m_num_blocks = allocated_blocks.size();
+
+    for (size_t block = 0; block < m_num_blocks; ++block)
+        m_block_index[allocated_blocks[block]] = block;
+
+    // The node states are followed by the empty block standing in for the unallocated blocks. The
+    // arrays read by the step kernel for every cell are backed by huge pages, where possible.
+    m_blocks           = (        Block*)calloc(m_num_blocks, sizeof(Block));
+    m_block_state.allocate((m_num_blocks + 1) * BLOCK_CELLS);
+    m_block_lut_row    = (unsigned char*)HugePageAllocator::allocate(m_num_blocks * BLOCK_CELLS * sizeof(unsigned char));
+    m_block_fluid_mask = (      RowMask*)HugePageAllocator::allocate(m_num_blocks * BLOCK_DIM   * sizeof(      RowMask));
+
+    parallel_zero_fill(m_block_lut_row,    m_num_blocks * BLOCK_CELLS * sizeof(unsigned char));
+    parallel_zero_fill(m_block_fluid_mask, m_num_blocks * BLOCK_DIM   * sizeof(      RowMask));
+
+    // Number of cells of the last blocks in x and y direction
+    const int last_dim_x = dim_x - (m_num_blocks_x - 1) * BLOCK_DIM;
+    const int last_dim_y = dim_y - (m_num_blocks_y - 1) * BLOCK_DIM;
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, num_domain_blocks), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t domain_block = r.begin(); domain_block != r.end(); ++domain_block)
+    {
+        const size_t block = m_block_index[domain_block];
+        if (block == NO_BLOCK) continue;
+
+        const int bx = domain_block % m_num_blocks_x;
+        const int by = domain_block / m_num_blocks_x;
+
+        Block& b = m_blocks[block];
+
+        b.x0      = bx * BLOCK_DIM;
+        b.y0      = by * BLOCK_DIM;
+        b.dim_x   = (bx == m_num_blocks_x - 1) ? last_dim_x : BLOCK_DIM;
+        b.dim_y   = (by == m_num_blocks_y - 1) ? last_dim_y : BLOCK_DIM;
+        b.west_x  = (bx == 0) ? last_dim_x - 1 : BLOCK_DIM - 1;
+        b.south_y = (by == 0) ? last_dim_y - 1 : BLOCK_DIM - 1;
+        b.fluid   = true;
+
+        for (int j = 0; j < 3; ++j) {
+
+            for (int i = 0; i < 3; ++i) {
+
+                const int nx = (bx + i - 1 + m_num_blocks_x) % m_num_blocks_x;
+                const int ny = (by + j - 1 + m_num_blocks_y) % m_num_blocks_y;
+
+                const size_t neighbor = m_block_index[size_t(ny) * m_num_blocks_x + nx];
+
+                b.neighbor[j][i] = (neighbor == NO_BLOCK) ? m_num_blocks : neighbor;
+            }
+        }
+
+        // Set up the rows of the lookup table and pack the node states of the cells
+        for (int y = 0; y < b.dim_y; ++y) {
+
+            for (int x = 0; x < b.dim_x; ++x) {
+
+                const int    x_lattice = b.x0 + x;
+                const int    y_lattice = b.y0 + y;
+                const size_t cell      = size_t(y_lattice) * dim_x + x_lattice;
+
+                const LutRow lut_row = CollisionLUT<model_>::row(this->m_cell_type_cpu[cell],
+                                                                 y_lattice == 0 || y_lattice == dim_y - 1,
+                                                                 x_lattice == 0 || x_lattice == dim_x - 1);
+
+                m_block_lut_row[block * BLOCK_CELLS + y * BLOCK_DIM + x] = lut_row;
+
+                b.fluid = b.fluid && (lut_row == LUT_FLUID);
+
+                m_block_fluid_mask[block * BLOCK_DIM + y] |= RowMask(lut_row == LUT_FLUID) << x;
+
+                // The node states of a cell are held by one block of the bitset
+                block_row(m_block_state.front(), block, y)[x] = this->m_node_state_cpu(cell);
+            }
+        }
+    }});
+
+    // Count the fluid cells of the allocated blocks (the cells beyond the domain are no cells)
+    m_num_fluid_cells = Threads::parallel_reduce(tbb::blocked_range<size_t>(0, m_num_blocks), size_t(0),
+        [&](const tbb::blocked_range<size_t>& r, size_t n) {
+            for (size_t block = r.begin(); block != r.end(); ++block)
+                for (int y = 0; y < m_blocks[block].dim_y; ++y)
+                    n += std::count(m_block_lut_row + block * BLOCK_CELLS + y * BLOCK_DIM,
+                                    m_block_lut_row + block * BLOCK_CELLS + y * BLOCK_DIM + m_blocks[block].dim_x,
+                                    (unsigned char)LUT_FLUID);
+            return n;
+        }, std::plus<size_t>());
+
+    // Particles of unallocated blocks would be lost
+    for (size_t domain_block = 0; domain_block < num_domain_blocks; ++domain_block) {
+
+        if (m_block_index[domain_block] != NO_BLOCK) continue;
+
+        const int x0 = (domain_block % m_num_blocks_x) * BLOCK_DIM;
+        const int y0 = (domain_block / m_num_blocks_x) * BLOCK_DIM;
+
+        for (int y = y0; y < std::min(y0 + BLOCK_DIM, dim_y); ++y) {
+
+            for (int x = x0; x < std::min(x0 + BLOCK_DIM, dim_x); ++x) {
+
+                if (this->m_node_state_cpu(size_t(y) * dim_x + x) != 0) {
+
+                    printf("ERROR in BlockSparse_Lattice::pack(): "
+                           "Particles in the interior of a solid region at cell (%d, %d).\n", x, y);
+                    abort();
+                }
+            }
+        }
+    }
+
+    // The blocks hold the node states and the cell types from now on
+    this->m_node_state_cpu.resize(0);
+
+    free(this->m_cell_type_cpu);
+    this->m_cell_type_cpu = NULL;
+
+    m_blocks_valid = true;
+}
+
+// Unpacks the node states of the blocks into the specified bitset. The cells of unallocated
+// blocks are empty.
+template<Model model_>
+void BlockSparse_Lattice<model_>::unpack(Bitset& node_state) const {
+
+    assert(node_state.size() == this->m_num_cells * 8);
+
+    const int dim_x = this->m_dim_x;
+    const int grain = Tuning::grain_size("sparse.unpack", this->m_dim_y, dim_x);
+
+    Threads::parallel_for(tbb::blocked_range<int>(0, this->m_dim_y, grain), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
+    {
+        for (int bx = 0; bx < m_num_blocks_x; ++bx) {
+
+            const int x0     = bx * BLOCK_DIM;
+            const int length = std::min(BLOCK_DIM, dim_x - x0);
+
+            const size_t block = block_of_cell(x0, y);
+
+            Bitset::Block* dst = &node_state(size_t(y) * dim_x + x0);
+
+            if (block == NO_BLOCK) memset(dst, 0, length);
+            else                   memcpy(dst, block_row(m_block_state.front(), block, y % BLOCK_DIM), length);
+        }
+    }});
+}
+
+// Restores the cell types (and the node states, if specified) of the whole domain from the blocks,
+// so that they can be modified. The blocks are chosen and set up again on the next step.
+template<Model model_>
+void BlockSparse_Lattice<model_>::restage(const bool node_states) {
+
+    if (!m_blocks_valid) return;
+
+    this->m_cell_type_cpu = (CellType*)malloc(this->m_num_cells * sizeof(CellType));
+
+    copy_cell_types(this->m_cell_type_cpu, 0, this->m_dim_y);
+
+    if (node_states) {
+
+        this->m_node_state_cpu.resize(this->m_num_cells * 8);
+
+        unpack(this->m_node_state_cpu);
+    }
+
+    m_blocks_valid = false;
+}
+
+// Allocates the memory for the arrays on the host (CPU).
+template<Model model_>
+void BlockSparse_Lattice<model_>::allocate_memory()
+{
+    // Allocate host memory
+    this->m_cell_type_cpu     = (CellType*)malloc(                    this->m_num_cells        * sizeof(CellType));
+    this->m_mean_density_cpu  = (    Real*)malloc(                    this->m_num_coarse_cells * sizeof(    Real));
+    this->m_mean_momentum_cpu = (    Real*)malloc(this->SPATIAL_DIM * this->m_num_coarse_cells * sizeof(    Real));
+
+    // The output buffer and the cell quantities are allocated when they are asked for first
+    this->m_cell_density_cpu  = NULL;
+    this->m_cell_momentum_cpu = NULL;
+
+    this->m_node_state_cpu.resize(this->m_num_cells * 8);
+
+    m_block_index = (size_t*)malloc(size_t(m_num_blocks_x) * m_num_blocks_y * sizeof(size_t));
+}
+
+// Allocates the output buffer of the whole domain, if not done yet.
+template<Model model_>
+void BlockSparse_Lattice<model_>::allocate_output_buffer()
+{
+    if (this->m_node_state_out_cpu.size() == 0) this->m_node_state_out_cpu.resize(this->m_num_cells * 8);
+}
+
+// Allocates the cell quantities of the whole domain, if not done yet. They are zero-initialized,
+// since the ones of the unallocated blocks are not computed.
+template<Model model_>
+void BlockSparse_Lattice<model_>::allocate_cell_quantities()
+{
+    if (this->m_cell_density_cpu != NULL) return;
+
+    this->m_cell_density_cpu  = (Real*)calloc(                    this->m_num_cells, sizeof(Real));
+    this->m_cell_momentum_cpu = (Real*)calloc(this->SPATIAL_DIM * this->m_num_cells, sizeof(Real));
+}
+
+// Frees the memory for the arrays on the host (CPU).
+template<Model model_>
+void BlockSparse_Lattice<model_>::free_memory()
+{
+    // Free CPU memory
+    free(this->m_cell_type_cpu);
+    free(this->m_cell_density_cpu);
+    free(this->m_mean_density_cpu);
+    free(this->m_cell_momentum_cpu);
+    free(this->m_mean_momentum_cpu);
+
+    free(m_block_index);
+
+    free_blocks();
+
+    this->m_cell_type_cpu       = NULL;
+    this->m_cell_density_cpu    = NULL;
+    this->m_mean_density_cpu    = NULL;
+    this->m_cell_momentum_cpu   = NULL;
+    this->m_mean_momentum_cpu   = NULL;
+
+    m_block_index               = NULL;
+}
+
+// Frees the allocated blocks.
+template<Model model_>
+void BlockSparse_Lattice<model_>::free_blocks()
+{
+    free(m_blocks);
+
+    m_block_state.release();
+
+    HugePageAllocator::deallocate(m_block_lut_row,    m_num_blocks * BLOCK_CELLS * sizeof(unsigned char));
+    HugePageAllocator::deallocate(m_block_fluid_mask, m_num_blocks * BLOCK_DIM   * sizeof(      RowMask));
+
+    m_blocks           = NULL;
+    m_block_lut_row    = NULL;
+    m_block_fluid_mask = NULL;
+    m_num_blocks       = 0;
+}
+
+// Sets (proper) parallelization parameters.
+template<Model model_>
+void BlockSparse_Lattice<model_>::setup_parallel()
+{
+    printf("BlockSparse configuration parameters: Executing calculation with %d threads "
+           "on blocks of %d x %d cells.\n\n",
+           Threads::num_threads(), BLOCK_DIM, BLOCK_DIM);
+
+    HugePageAllocator::print_usage();
+}
+
+// Explicit instantiations
+template class BlockSparse_Lattice<Model::HPP>;
+template class BlockSparse_Lattice<Model::FHP_I>;
+template class BlockSparse_Lattice<Model::FHP_II>;
+template class BlockSparse_Lattice<Model::FHP_III>;
+
+} // namespace lgca
@@ -0,0 +1,276 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_BLOCK_SPARSE_LATTICE_H_
+#define LGCA_BLOCK_SPARSE_LATTICE_H_
+
+#include "lattice.h"
+#include "lgca_boundary.h"
+#include "lgca_forcing.h"
+#include "lgca_lut.h"
+#include "lgca_memory.h"
+#include "lgca_random.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace lgca {
+
+// Orders of the allocated blocks in memory, which is also the order they are stepped in
+enum class BlockOrder {
+    ROW_MAJOR, // Row by row
+    MORTON     // Along the Z-order curve of the block positions, i.e. neighbor blocks are mostly
+               // close in memory and stepped shortly after each other
+};
+
+// Block-sparse lattice gas cellular automaton for geometries which are mostly solid (e.g. porous
+// media). The domain is split into square blocks of cells, and only the blocks which can hold
+// particles are allocated and swept by the step kernel. These are the blocks containing a cell
+// other than a no-slip cell, or a no-slip cell next to one: particles enter no-slip cells from
+// their neighbors only and are bounced back to where they came from.
+//
+// The node states are stored with one byte per cell (bit dir holds the state in direction dir) and
+// block by block. The node states set up by the init functions of the base class are packed into
+// the blocks on the first step (or the first body force). Collision and propagation results and
+// body forces are identical to the ones of OMP_Lattice.
+//
+// The memory scales with the number of allocated blocks: packing releases the node states and the
+// cell types of the whole domain (the rows of the lookup table of the blocks stand in for the cell
+// types), and the output buffer and the cell quantities of the whole domain are allocated when
+// they are asked for first. Changing the cell types or initializing the node states anew restores
+// the arrays of the whole domain from the blocks, which are set up again on the next step.
+template<Model model_>
+class BlockSparse_Lattice: public Lattice<model_> {
+
+public:
+
+    // Number of cells of a block in x and y direction
+    static constexpr int BLOCK_DIM = 16;
+
+    static constexpr int BLOCK_CELLS = BLOCK_DIM * BLOCK_DIM;
+
+private:
+
+    using ModelDesc = ModelDescriptor<model_>;
+
+    // Words of the random bits for collision, holding one bit per cell of a row
+    using RndWord = uint64_t;
+
+    static constexpr unsigned int BITS_PER_RND_WORD = std::numeric_limits<RndWord>::digits;
+
+    // Masks of the cells of a row of a block, holding one bit per cell
+    using RowMask = uint32_t;
+
+    static_assert(BITS_PER_RND_WORD % BLOCK_DIM == 0, "Blocks must not straddle words of random bits.");
+    static_assert(std::numeric_limits<RowMask>::digits >= BLOCK_DIM, "Row masks must hold the cells of a row.");
+    static_assert(BLOCK_DIM % 2 == 0, "The rows of the blocks must start with an even row index.");
+
+    // Number of cells per row and column of the blocks including a layer of neighbor cells on
+    // every side, which are gathered from the neighbor blocks before a block is stepped
+    static constexpr int TILE_DIM = BLOCK_DIM + 2;
+
+    // Index of blocks which are not allocated
+    static constexpr size_t NO_BLOCK = std::numeric_limits<size_t>::max();
+
+    // Allocated block of the lattice
+    struct Block {
+        int    x0, y0;          // Position of the first cell
+        int    dim_x, dim_y;    // Number of cells (less than BLOCK_DIM on the eastern and northern
+                                // boundary of the domain)
+        size_t neighbor[3][3];  // Indices of the neighbor blocks (wrapping around periodically) in
+                                // [dy + 1][dx + 1], unallocated blocks refer to the empty block
+        int    west_x;          // Index of the last column of the western neighbor blocks
+        int    south_y;         // Index of the last row of the southern neighbor blocks
+        bool   fluid;           // Whether all cells of the block are fluid cells
+    };
+
+    // Number of blocks in x and y direction, including unallocated blocks
+    int m_num_blocks_x;
+    int m_num_blocks_y;
+
+    // Number of allocated blocks
+    size_t m_num_blocks;
+
+    // Number of fluid cells of the allocated blocks, i.e. of the lattice
+    size_t m_num_fluid_cells;
+
+    // Index of the allocated block for every block of the domain (row by row), or NO_BLOCK
+    size_t* m_block_index;
+
+    // Allocated blocks
+    Block* m_blocks;
+
+    // Node states of the allocated blocks (front) in the following sense, followed by an empty
+    // block which stands in for the unallocated blocks:
+    //
+    // [BLOCK_0_ROW_0_CELL_0|BLOCK_0_ROW_0_CELL_1|...|BLOCK_0_ROW_1_CELL_0|...|BLOCK_1_ROW_0_CELL_0|...]
+    //
+    // and auxiliary node states (back) written by the steps
+    DoubleBuffer<unsigned char, HugePageAllocator> m_block_state;
+
+    // Row of the collision lookup table for every cell of the allocated blocks
+    unsigned char* m_block_lut_row;
+
+    // Mask of the fluid cells of every row of the allocated blocks
+    RowMask* m_block_fluid_mask;
+
+    // Shifts of the neighbor cells the node states are pulled from during the propagation step
+    PullShifts<model_> m_pull;
+
+    // Number of words of random bits per row
+    size_t m_num_rnd_words_x;
+
+    // Generator of the random bits for collision, which are drawn afresh for every step from the
+    // index of the step and the index of the word of 64 cells of a row
+    CounterRng m_rng;
+
+    // Number of steps performed so far
+    uint64_t m_step;
+
+    // Selection of the particles reverted by the body force
+    ForcingSampler m_forcing;
+
+    // Body force applied by the step kernels (fused forcing)
+    FusedForcing m_fused_forcing;
+
+    // Whether the blocks hold the current node states
+    bool m_blocks_valid;
+
+    // Order of the allocated blocks
+    BlockOrder m_block_order;
+
+    // Returns the index of the block holding the specified cell, or NO_BLOCK
+    inline size_t block_of_cell(const int x, const int y) const {
+
+        return m_block_index[(y / BLOCK_DIM) * m_num_blocks_x + x / BLOCK_DIM];
+    }
+
+    // Returns the node states of the specified row of a block
+    inline unsigned char* block_row(unsigned char* state, const size_t block, const int y) const {
+
+        return state + block * BLOCK_CELLS + y * BLOCK_DIM;
+    }
+
+    inline const unsigned char* block_row(const unsigned char* state, const size_t block, const int y) const {
+
+        return state + block * BLOCK_CELLS + y * BLOCK_DIM;
+    }
+
+    // Gathers the node states of the specified block and of its neighbor cells into a tile
+    LGCA_FORCE_INLINE void gather_tile(const size_t block, unsigned char* tile) const;
+
+    // Performs the collision and propagation step on the specified block, pulling the node states
+    // from its tile. KIND is FLUID for blocks of fluid cells and MIXED otherwise.
+    template<RowKind KIND>
+    LGCA_FORCE_INLINE void step_block(const size_t block, const unsigned char* tile);
+
+    // Returns the sites of the specified pair of the cells of the specified row of a block
+    RowMask forcing_sites(const size_t block, const int y, const ForcingPair& pair) const;
+
+    // Returns the number of sites of the specified pairs of the cells of row y of the lattice
+    size_t count_forcing_sites(const int y, const ForcingPair* pairs, const unsigned int num_pairs) const;
+
+    // Chooses the blocks to allocate, sets them up from the cell types and packs the node states
+    // into the blocks
+    void pack();
+
+    // Unpacks the node states of the blocks into the specified bitset
+    void unpack(Bitset& node_state) const;
+
+    // Restores the cell types (and the node states, if specified) of the whole domain from the
+    // blocks, which are set up again on the next step
+    void restage(const bool node_states);
+
+    // Restores the cell types of the whole domain, since the new node states are packed with them
+    void invalidate_node_states() { restage(/*node_states=*/false); }
+
+    // Restores the cell types and the node states of the whole domain
+    void invalidate_cell_types() { restage(/*node_states=*/true); }
+
+    // Allocates the output buffer and the cell quantities of the whole domain, if not done yet
+    void allocate_output_buffer();
+    void allocate_cell_quantities();
+
+    // Allocates the memory for the arrays on the host (CPU).
+    void allocate_memory();
+
+    // Frees the memory for the arrays on the host (CPU).
+    void free_memory();
+
+    // Frees the allocated blocks
+    void free_blocks();
+
+public:
+
+    // Creates a block-sparse, TBB parallelized lattice gas cellular automaton object of the
+    // specified properties.
+    BlockSparse_Lattice(const string m_test_case,
+                        const Real m_Re, const Real m_Ma_s,
+                        const int m_coarse_graining_radius);
+
+    virtual ~BlockSparse_Lattice();
+
+    // Sets (proper) parallelization parameters.
+    void setup_parallel();
+
+    // Performs the collision and propagation step on the lattice gas automaton.
+    void collide_and_propagate(const bool p);
+
+    // Applies a body force in the specified direction (x or y) and with the
+    // specified intensity to the particles. E.g., if the intensity is equal 100,
+    // every 100th particle changes it's direction, if feasible.
+    void apply_body_force(const int forcing);
+
+    // Applies a body force of the specified intensity spread over the next num_steps steps by the
+    // step kernel (see FusedForcing)
+    bool set_fused_forcing(const int forcing, const unsigned int num_steps);
+
+    // Returns the number of particles in the lattice
+    unsigned long get_n_particles();
+
+    // Computes the mean velocity of the lattice from the current node states of the blocks
+    std::vector<Real> get_mean_velocity();
+
+    // Unpacks the current node states to the output buffer for post-processing and visualization
+    void copy_data_to_output_buffer();
+
+    // Computes quantities of interest from the output buffer as a post-processing procedure
+    void post_process();
+
+    // Copies the cell types of the rows [y_begin, y_end) to the specified array
+    void copy_cell_types(CellType* cell_type, const int y_begin, const int y_end);
+
+    // Sets the seed of the random bits for collision. Runs with the same seed are reproducible
+    // bit by bit, independent of the number of threads.
+    void set_seed(const uint64_t seed) { m_rng.set_seed(seed); m_forcing.set_seed(seed); }
+
+    // Selects the order of the allocated blocks. The blocks are set up on the first step, i.e. the
+    // order must be selected before.
+    void set_block_order(const BlockOrder order) { assert(!m_blocks_valid); m_block_order = order; }
+
+    // Returns the order of the allocated blocks
+    BlockOrder block_order() const { return m_block_order; }
+
+    // Returns the number of allocated blocks (determined from the cell types on the first step)
+    size_t num_blocks() const { return m_num_blocks; }
+};
+
+} // namespace lgca
+
+#endif /* LGCA_BLOCK_SPARSE_LATTICE_H_ */
@@ -0,0 +1,581 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lgca_common.h"
+
+#include "ensemble_lattice.h"
+#include "lgca_parallel.h"
+
+#include <tbb/blocked_range.h>
+
+#include <algorithm>
+
+namespace lgca {
+
+// Creates an ensemble of TBB parallelized lattice gas cellular automaton objects of the specified
+// properties.
+template<Model model_>
+Ensemble_Lattice<model_>::Ensemble_Lattice(const string test_case,
+                                           const Real Re, const Real Ma_s,
+                                           const int coarse_graining_radius)
+                    : Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius),
+                      m_pull(this->m_dim_x, this->m_dim_y),
+                      m_step(0),
+                      m_boundary(Boundary::GENERIC),
+                      m_words_valid(false),
+                      m_cell_rows_valid(false) {
+
+    assert(this->m_dim_x > 2);
+
+    // Allocate the memory for the arrays on the host (CPU)
+    allocate_memory();
+}
+
+// Deletes the ensemble of lattice gas cellular automaton objects.
+template<Model model_>
+Ensemble_Lattice<model_>::~Ensemble_Lattice() {
+
+    this->free_memory();
+}
+
+// Executes the collision step on the pulled node states of the specified cell of all replicas and
+// writes the results to the auxiliary node states. The random bits for collision are generated
+// from the cell index and the index of the step, one bit per replica. Rows of uniform cell type
+// evaluate a single collision rule without looking up the collision rule of the cell.
+template<Model model_>
+template<RowKind KIND>
+LGCA_FORCE_INLINE void Ensemble_Lattice<model_>::collide_cell(const Word* node_state, const size_t cell) {
+
+    const size_t num_cells = this->m_num_cells;
+
+    Word node_state_new[this->NUM_DIR];
+
+    const LutRow row = (KIND == RowKind::FLUID)   ? LUT_FLUID
+                     : (KIND == RowKind::NO_SLIP) ? LUT_BOUNCE_BACK
+                     :                              m_cell_row[cell];
+
+    switch (row) {
+    case LUT_FLUID:
+    {
+        Word rnd;
+
+        m_rng.bits(Word(cell), m_step, rnd);
+
+        ModelDesc::collide(node_state, node_state_new, rnd);
+
+        // Apply the body force to the replicas of the fluid cell (fused forcing), whose lanes are
+        // the replicas
+        if (m_fused_forcing.enabled()) m_fused_forcing.apply(m_rng, Word(cell), m_step, node_state_new);
+        break;
+    }
+    case LUT_BOUNCE_BACK:      ModelDesc::bounce_back     (node_state, node_state_new); break;
+    case LUT_BOUNCE_FORWARD_X: ModelDesc::bounce_forward_x(node_state, node_state_new); break;
+    case LUT_BOUNCE_FORWARD_Y: ModelDesc::bounce_forward_y(node_state, node_state_new); break;
+    default:
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            node_state_new[dir] = node_state[dir];
+    }
+
+    // Write new node states to the auxiliary node states
+#pragma unroll
+    for (int dir = 0; dir < this->NUM_DIR; ++dir)
+        m_node_word.back()[dir * num_cells + cell] = node_state_new[dir];
+}
+
+// Performs the collision and propagation step on one row, pulling the node states from the
+// specified rows (shifted by dx in x direction, wrapping around periodically).
+template<Model model_>
+template<RowKind KIND>
+LGCA_FORCE_INLINE void Ensemble_Lattice<model_>::step_row(const Word* const* src_row, const int* dx, const int y) {
+
+    const int    dim_x = this->m_dim_x;
+    const size_t row   = size_t(y) * dim_x;
+
+    Word node_state[this->NUM_DIR];
+
+    // Execute propagation step on the first and the last cell of the row, which wrap around
+    // periodically
+    for (const int x : { 0, dim_x - 1 }) {
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            node_state[dir] = src_row[dir][(x + dx[dir] + dim_x) % dim_x];
+
+        collide_cell<KIND>(node_state, row + x);
+    }
+
+    // Execute propagation step on the inner cells of the row
+    for (int x = 1; x < dim_x - 1; ++x) {
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            node_state[dir] = src_row[dir][x + dx[dir]];
+
+        collide_cell<KIND>(node_state, row + x);
+    }
+}
+
+// Performs the collision and propagation step on the rows in [y_begin, y_end). The kind of every
+// row is given by the boundary policy, which resolves it at compile time for periodic domains.
+template<Model model_>
+template<typename Policy>
+void Ensemble_Lattice<model_>::step_rows(const int y_begin, const int y_end) {
+
+    const int    dim_x     = this->m_dim_x;
+    const int    dim_y     = this->m_dim_y;
+    const size_t num_cells = this->m_num_cells;
+
+    for (int y = y_begin; y != y_end; ++y)
+    {
+        const int parity = y & 1;
+
+        // Get the rows the node states are pulled from
+        const Word* src_row[this->NUM_DIR];
+        int         dx     [this->NUM_DIR];
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+            const int y_src = (y + m_pull.dy[parity][dir] + dim_y) % dim_y;
+
+            src_row[dir] = m_node_word.front() + dir * num_cells + size_t(y_src) * dim_x;
+            dx     [dir] = m_pull.dx[parity][dir];
+        }
+
+        switch (Policy::row_kind(y, dim_y)) {
+        case RowKind::FLUID:   step_row<RowKind::FLUID  >(src_row, dx, y); break;
+        case RowKind::NO_SLIP: step_row<RowKind::NO_SLIP>(src_row, dx, y); break;
+        case RowKind::MIXED:   step_row<RowKind::MIXED  >(src_row, dx, y); break;
+        }
+    }
+}
+
+// Performs the collision and propagation step on all replicas.
+template<Model model_>
+void Ensemble_Lattice<model_>::collide_and_propagate(const bool p) {
+
+#ifndef NDEBUG
+            // Check weather the domain dimensions are valid for the FHP model.
+            if (this->m_dim_y % 2 != 0 && (model_ == Model::FHP_I || model_ == Model::FHP_II || model_ == Model::FHP_III)) {
+
+                printf("ERROR in Ensemble_Lattice<Model::FHP>::collide_and_propagate(): "
+                       "Invalid domain dimension in y direction.\n");
+                abort();
+            }
+#endif
+
+    if (!m_words_valid) pack();
+    if (!m_cell_rows_valid) setup_cell_rows();
+
+    // Every cell of a row reads and writes the words of its node states
+    const int grain = Tuning::grain_size("ensemble.collide_and_propagate", this->m_dim_y,
+                                         2 * this->m_dim_x * this->NUM_DIR * sizeof(Word));
+
+    // Loop over bunches of rows
+    Threads::parallel_for(tbb::blocked_range<int>(0, this->m_dim_y, grain), [&](const tbb::blocked_range<int>& r) {
+
+        switch (m_boundary) {
+        case Boundary::GENERIC:  step_rows<GenericBoundary> (r.begin(), r.end()); break;
+        case Boundary::CHANNEL:  step_rows<ChannelBoundary> (r.begin(), r.end()); break;
+        case Boundary::PERIODIC: step_rows<PeriodicBoundary>(r.begin(), r.end()); break;
+        }
+    });
+
+    // Update the node states
+    m_node_word.swap();
+
+    ++m_step;
+}
+
+// Applies a body force in the specified direction (x or y) and with the specified intensity to
+// the particles of every replica. The forcing sampler selects NUM_REPLICAS * forcing of the sites
+// of all replicas, each with the same probability, i.e. every replica forcing sites on average.
+// The sites of a row are ranked pair by pair and cell by cell, and replica by replica within a cell.
+template<Model model_>
+void Ensemble_Lattice<model_>::apply_body_force(const int forcing) {
+
+    if (!m_words_valid) pack();
+    if (!m_cell_rows_valid) setup_cell_rows();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    const size_t num_cells = this->m_num_cells;
+
+    // Every cell of a row reads the words of the pairs and its collision rule
+    m_forcing.apply(this->m_dim_y, this->m_dim_x * (2 * num_pairs * sizeof(Word) + sizeof(LutRow)),
+                    size_t(NUM_REPLICAS) * std::max(forcing, 0),
+
+        // Counts the sites of a row
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); },
+
+        // Reverts the selected sites of a row
+        [&](const int y, const uint32_t* selected, const size_t num_selected) {
+
+            const uint32_t* const selected_end = selected + num_selected;
+            const size_t          row          = size_t(y) * this->m_dim_x;
+
+            size_t rank = 0;
+
+            for (unsigned int p = 0; p < num_pairs; ++p) {
+
+                Word* node_from = m_node_word.front() + pairs[p].from * num_cells + row;
+                Word* node_to   = m_node_word.front() + pairs[p].to   * num_cells + row;
+
+                for (int x = 0; x < this->m_dim_x && selected != selected_end; ++x) {
+
+                    ForcingSampler::revert_selected(forcing_sites(row + x, pairs[p]), rank, selected, selected_end,
+                        [&](const int replica) {
+
+                            node_from[x] ^= Word(1) << replica;
+                            node_to  [x] ^= Word(1) << replica;
+                        });
+                }
+            }
+        });
+}
+
+// Applies a body force of the specified intensity spread over the next num_steps steps by the step
+// kernel, which reverts every site with probability forcing / (E num_steps) per step, with E the
+// current mean number of sites of a replica (see FusedForcing).
+template<Model model_>
+bool Ensemble_Lattice<model_>::set_fused_forcing(const int forcing, const unsigned int num_steps) {
+
+    if (!m_words_valid) pack();
+    if (!m_cell_rows_valid) setup_cell_rows();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    const size_t num_sites = ForcingSampler::count(this->m_dim_y, this->m_dim_x * (2 * num_pairs * sizeof(Word) + sizeof(LutRow)),
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); });
+
+    const double probability = (forcing > 0 && num_sites > 0 && num_steps > 0)
+                             ? double(NUM_REPLICAS) * forcing / (double(num_sites) * num_steps)
+                             : 0.0;
+
+    return m_fused_forcing.set<model_>(this->m_bf_dir, probability);
+}
+
+// Returns the sites of the specified pair of the specified cell of all replicas, i.e. bit r is
+// set if replica r has a particle in the first direction of the pair and none in the second one.
+// Body forces are applied to fluid cells only.
+template<Model model_>
+typename Ensemble_Lattice<model_>::Word Ensemble_Lattice<model_>::forcing_sites(const size_t cell,
+                                                                               const ForcingPair& pair) const {
+
+    if (m_cell_row[cell] != LUT_FLUID) return 0;
+
+    const size_t num_cells = this->m_num_cells;
+
+    return m_node_word.front()[pair.from * num_cells + cell] & ~m_node_word.front()[pair.to * num_cells + cell];
+}
+
+// Returns the number of sites of the specified pairs of the cells of row y of all replicas
+template<Model model_>
+size_t Ensemble_Lattice<model_>::count_forcing_sites(const int y, const ForcingPair* pairs,
+                                                     const unsigned int num_pairs) const {
+
+    const size_t row = size_t(y) * this->m_dim_x;
+
+    size_t num_sites = 0;
+
+    for (unsigned int p = 0; p < num_pairs; ++p)
+        for (int x = 0; x < this->m_dim_x; ++x)
+            num_sites += __builtin_popcountll(forcing_sites(row + x, pairs[p]));
+
+    return num_sites;
+}
+
+// Returns the number of particles summed up over all replicas.
+template<Model model_>
+unsigned long Ensemble_Lattice<model_>::get_n_particles() {
+
+    if (!m_words_valid) return NUM_REPLICAS * Lattice<model_>::get_n_particles();
+
+    const size_t num_words = this->NUM_DIR * this->m_num_cells;
+    const size_t grain     = Tuning::grain_size("ensemble.get_n_particles", num_words, sizeof(Word));
+
+    size_t n_particles = Threads::parallel_reduce(tbb::blocked_range<size_t>(0, num_words, grain), size_t(0),
+        [&](const tbb::blocked_range<size_t>& r, size_t n) {
+            for (size_t word = r.begin(); word != r.end(); ++word)
+                n += __builtin_popcountll(m_node_word.front()[word]);
+            return n;
+        }, std::plus<size_t>());
+
+    this->m_num_particles = n_particles;
+
+    return n_particles;
+}
+
+// Copies the node states of replica 0 to the output buffer for visualization.
+template<Model model_>
+void Ensemble_Lattice<model_>::copy_data_to_output_buffer() {
+
+    if (!m_words_valid) {
+
+        Lattice<model_>::copy_data_to_output_buffer();
+        return;
+    }
+
+    const size_t num_cells = this->m_num_cells;
+    const size_t grain     = Tuning::grain_size("ensemble.copy_data_to_output_buffer", num_cells,
+                                                this->NUM_DIR * sizeof(Word) + 1);
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, num_cells, grain), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+    {
+        Bitset::Block cell_state = 0;
+
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            cell_state |= (m_node_word.front()[dir * num_cells + cell] & Word(1)) << dir;
+
+        this->m_node_state_out_cpu(cell) = cell_state;
+    }});
+}
+
+// Computes the ensemble averaged cell quantities and the coarse grained quantities as a
+// post-processing procedure. The node states of a cell are summed up over the replicas by
+// counting the bits of its words.
+template<Model model_>
+void Ensemble_Lattice<model_>::post_process() {
+
+    if (!m_words_valid) {
+
+        Lattice<model_>::post_process();
+        return;
+    }
+
+    const size_t num_cells = this->m_num_cells;
+    const size_t grain     = Tuning::grain_size("ensemble.post_process", num_cells,
+                                                this->NUM_DIR * sizeof(Word) + (1 + this->SPATIAL_DIM) * sizeof(Real));
+
+    // Loop over lattice cells
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, num_cells, grain), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+    {
+        // Initialize the cell quantities to be computed
+        int  cell_density    = 0;
+        Real cell_momentum_x = 0.0;
+        Real cell_momentum_y = 0.0;
+
+        // Loop over nodes within the current cell
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+            // Number of replicas the node is occupied in
+            const int n_occupied = __builtin_popcountll(m_node_word.front()[dir * num_cells + cell]);
+
+            cell_density    += n_occupied;
+            cell_momentum_x += n_occupied * ModelDesc::LATTICE_VEC_X[dir];
+            cell_momentum_y += n_occupied * ModelDesc::LATTICE_VEC_Y[dir];
+        }
+
+        // Write the ensemble averaged cell quantities to the related data arrays
+        this->m_cell_density_cpu [cell                        ] = (Real) cell_density / NUM_REPLICAS;
+        this->m_cell_momentum_cpu[cell * this->SPATIAL_DIM    ] = cell_momentum_x     / NUM_REPLICAS;
+        this->m_cell_momentum_cpu[cell * this->SPATIAL_DIM + 1] = cell_momentum_y     / NUM_REPLICAS;
+
+    } // for cell
+    });
+
+    // Computes coarse grained quantities of interest as a post-processing procedure
+    this->mean_post_process();
+}
+
+// Copies the node states to all replicas.
+template<Model model_>
+void Ensemble_Lattice<model_>::pack() {
+
+    const size_t num_cells = this->m_num_cells;
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, num_cells), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+    {
+        // The node states of a cell are held by one block of the bitset
+        const Bitset::Block cell_state = this->m_node_state_cpu(cell);
+
+        for (int dir = 0; dir < this->NUM_DIR; ++dir)
+            m_node_word.front()[dir * num_cells + cell] = (cell_state & (1 << dir)) ? ~Word(0) : Word(0);
+    }});
+
+    m_words_valid = true;
+
+    if (model_ == Model::HPP)
+        printf("WARNING in Ensemble_Lattice::pack(): HPP collisions are deterministic, the replicas "
+               "copied from one initial state stay identical. Use init_random() or init_diffusion() "
+               "to draw the initial state of every replica.\n");
+}
+
+// Initializes every replica with some random distributed particles.
+template<Model model_>
+void Ensemble_Lattice<model_>::init_random() {
+
+    Lattice<model_>::init_random();
+
+    init_replicas(/*diffusion=*/false);
+}
+
+// Initializes every replica with some random distributed particles in the center area of the
+// domain.
+template<Model model_>
+void Ensemble_Lattice<model_>::init_diffusion() {
+
+    Lattice<model_>::init_diffusion();
+
+    init_replicas(/*diffusion=*/true);
+}
+
+// Copies the staged node states to replica 0 and draws the node states of replicas 1 and up with
+// the density of the init functions of the base class. Two replicas are drawn from every random
+// word, i.e. a node of a replica is occupied if its 32 random bits fall below 2^32 / NUM_DIR. The
+// key is drawn from rand(), so that the replicas are reproducible after srand() like replica 0.
+template<Model model_>
+void Ensemble_Lattice<model_>::init_replicas(const bool diffusion) {
+
+    const CounterRng rng((uint64_t(rand()) << 32) ^ uint64_t(rand()));
+
+    const uint64_t threshold = (uint64_t(1) << 32) / this->NUM_DIR;
+    const size_t   num_cells = this->m_num_cells;
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, num_cells), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+    {
+        const Bitset::Block cell_state = this->m_node_state_cpu(cell);
+
+        const bool drawn = this->m_cell_type_cpu[cell] == CellType::FLUID &&
+                           (!diffusion || this->in_diffusion_area(cell));
+
+        for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+            Word word = (cell_state & (1 << dir)) ? Word(1) : Word(0);
+
+            for (unsigned int replica = 1; drawn && replica < NUM_REPLICAS; replica += 2) {
+
+                uint64_t rnd;
+                rng.bits(uint64_t(cell) * this->NUM_DIR + dir, replica / 2, rnd);
+
+                if ((rnd & 0xFFFFFFFFull) < threshold) word |= Word(1) << replica;
+                if ((rnd >> 32)           < threshold && replica + 1 < NUM_REPLICAS)
+                    word |= Word(1) << (replica + 1);
+            }
+
+            m_node_word.front()[dir * num_cells + cell] = word;
+        }
+    }});
+
+    m_words_valid = true;
+}
+
+// Sets up the collision rules of the cells and the boundary policy from the cell types.
+template<Model model_>
+void Ensemble_Lattice<model_>::setup_cell_rows() {
+
+    const int dim_x = this->m_dim_x;
+    const int dim_y = this->m_dim_y;
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, this->m_num_cells), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+    {
+        const int x = cell % dim_x;
+        const int y = cell / dim_x;
+
+        m_cell_row[cell] = CollisionLUT<model_>::row(this->m_cell_type_cpu[cell],
+                                                     y == 0 || y == dim_y - 1,
+                                                     x == 0 || x == dim_x - 1);
+    }});
+
+    m_boundary = detect_boundary(this->m_cell_type_cpu, dim_x, dim_y);
+
+    m_cell_rows_valid = true;
+}
+
+// Allocates the memory for the arrays on the host (CPU).
+template<Model model_>
+void Ensemble_Lattice<model_>::allocate_memory()
+{
+    // Allocate host memory
+    this->m_cell_type_cpu     = (CellType*)malloc(                    this->m_num_cells        * sizeof(CellType));
+    this->m_cell_density_cpu  = (    Real*)malloc(                    this->m_num_cells        * sizeof(    Real));
+    this->m_mean_density_cpu  = (    Real*)malloc(                    this->m_num_coarse_cells * sizeof(    Real));
+    this->m_cell_momentum_cpu = (    Real*)malloc(this->SPATIAL_DIM * this->m_num_cells        * sizeof(    Real));
+    this->m_mean_momentum_cpu = (    Real*)malloc(this->SPATIAL_DIM * this->m_num_coarse_cells * sizeof(    Real));
+
+    this->m_node_state_cpu.resize    (this->m_num_cells * 8);
+    this->m_node_state_out_cpu.resize(this->m_num_cells * 8);
+
+    // The words are zero-filled plane by plane, so that the rows of every plane are first touched
+    // by the threads of the same part of the lattice
+    m_node_word.allocate(this->NUM_DIR * this->m_num_cells, /*zero_fill=*/false);
+
+    for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+        parallel_zero_fill(m_node_word.front() + dir * this->m_num_cells, this->m_num_cells * sizeof(Word));
+        parallel_zero_fill(m_node_word.back()  + dir * this->m_num_cells, this->m_num_cells * sizeof(Word));
+    }
+
+    // The collision rules of the cells are read along with the words by the step kernel
+    m_cell_row = (LutRow*)HugePageAllocator::allocate(this->m_num_cells * sizeof(LutRow));
+
+    parallel_zero_fill(m_cell_row, this->m_num_cells * sizeof(LutRow));
+}
+
+// Frees the memory for the arrays on the host (CPU).
+template<Model model_>
+void Ensemble_Lattice<model_>::free_memory()
+{
+    // Free CPU memory
+    free(this->m_cell_type_cpu);
+    free(this->m_cell_density_cpu);
+    free(this->m_mean_density_cpu);
+    free(this->m_cell_momentum_cpu);
+    free(this->m_mean_momentum_cpu);
+
+    m_node_word.release();
+    HugePageAllocator::deallocate(m_cell_row, this->m_num_cells * sizeof(LutRow));
+
+    this->m_cell_type_cpu       = NULL;
+    this->m_cell_density_cpu    = NULL;
+    this->m_mean_density_cpu    = NULL;
+    this->m_cell_momentum_cpu   = NULL;
+    this->m_mean_momentum_cpu   = NULL;
+
+    m_cell_row                  = NULL;
+}
+
+// Sets (proper) parallelization parameters.
+template<Model model_>
+void Ensemble_Lattice<model_>::setup_parallel()
+{
+    printf("Ensemble configuration parameters: Executing calculation with %d threads "
+           "on %u replicas of %zu cells.\n\n",
+           Threads::num_threads(), NUM_REPLICAS, this->m_num_cells);
+
+    HugePageAllocator::print_usage();
+}
+
+// Explicit instantiations
+template class Ensemble_Lattice<Model::HPP>;
+template class Ensemble_Lattice<Model::FHP_I>;
+template class Ensemble_Lattice<Model::FHP_II>;
+template class Ensemble_Lattice<Model::FHP_III>;
+
+} // namespace lgca
@@ -0,0 +1,199 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_ENSEMBLE_LATTICE_H_
+#define LGCA_ENSEMBLE_LATTICE_H_
+
+#include "lattice.h"
+#include "lgca_boundary.h"
+#include "lgca_forcing.h"
+#include "lgca_lut.h"
+#include "lgca_memory.h"
+#include "lgca_random.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace lgca {
+
+// Ensemble of independent replicas of a lattice gas cellular automaton, one replica per bit lane
+// of a word. The node states are stored direction-major with one word per cell, bit r of which
+// holds the node state of replica r. All replicas share the cell types and the propagation, while
+// every replica draws its own random bits for collision.
+//
+// init_random() and init_diffusion() draw the initial node states of every replica on its own,
+// replica 0 getting the ones of a single lattice initialized alike. The node states set up by the
+// other init functions (or copied from another lattice) are copied to all replicas on the first
+// step (or the first body force), so that the replicas of FHP models decorrelate from a common
+// initial state by their collisions only. HPP collisions are deterministic, replicas of HPP models
+// copied from a common initial state stay identical (a warning is printed). The post-processing
+// computes the ensemble averaged cell quantities, while the output buffer holds the node states of
+// replica 0.
+//
+// Body forces select the sites of all replicas at once, i.e. a body force of intensity F reverts
+// NUM_REPLICAS * F sites of the ensemble, each with the same probability, and every replica F
+// sites on average.
+template<Model model_>
+class Ensemble_Lattice: public Lattice<model_> {
+
+public:
+
+    using Word = uint64_t;
+
+    // Number of replicas, i.e. bits per word
+    static constexpr unsigned int NUM_REPLICAS = std::numeric_limits<Word>::digits;
+
+private:
+
+    using ModelDesc = ModelDescriptor<model_>;
+
+    // Shifts of the neighbor cells the node states are pulled from during the propagation step
+    PullShifts<model_> m_pull;
+
+    // Node states of the replicas (front) in the following sense:
+    //
+    // [DIR_0_CELL_0|DIR_0_CELL_1|...|DIR_1_CELL_0|DIR_1_CELL_1|...]
+    //
+    // and auxiliary node states (back) written by the steps
+    DoubleBuffer<Word, HugePageAllocator> m_node_word;
+
+    // Rows of the collision lookup table of the cells, which encode the collision rule of a cell
+    // (the table itself is not used)
+    LutRow* m_cell_row;
+
+    // Generator of the random bits for collision, which are drawn afresh for every step from the
+    // index of the step and the index of the cell. Bit r of a random word belongs to replica r.
+    CounterRng m_rng;
+
+    // Number of steps performed so far
+    uint64_t m_step;
+
+    // Selection of the particles reverted by the body force
+    ForcingSampler m_forcing;
+
+    // Body force applied by the step kernel (fused forcing)
+    FusedForcing m_fused_forcing;
+
+    // Boundary policy the step kernel is specialized for
+    Boundary m_boundary;
+
+    // Whether the words hold the current node states
+    bool m_words_valid;
+
+    // Whether the collision rules of the cells have been set up from the cell types
+    bool m_cell_rows_valid;
+
+    // Performs the collision and propagation step on the rows in [y_begin, y_end), specialized for
+    // the boundary policy
+    template<typename Policy>
+    void step_rows(const int y_begin, const int y_end);
+
+    // Performs the collision and propagation step on a row of the specified kind
+    template<RowKind KIND>
+    LGCA_FORCE_INLINE void step_row(const Word* const* src_row, const int* dx, const int y);
+
+    // Executes the collision step on the pulled node states of the specified cell and writes the
+    // results to the auxiliary node states
+    template<RowKind KIND>
+    LGCA_FORCE_INLINE void collide_cell(const Word* node_state, const size_t cell);
+
+    // Returns the sites of the specified pair of the specified cell of all replicas
+    Word forcing_sites(const size_t cell, const ForcingPair& pair) const;
+
+    // Returns the number of sites of the specified pairs of the cells of row y of all replicas
+    size_t count_forcing_sites(const int y, const ForcingPair* pairs, const unsigned int num_pairs) const;
+
+    // Copies the node states to all replicas
+    void pack();
+
+    // Copies the staged node states to replica 0 and draws the node states of the other replicas
+    // with the density of the init functions of the base class, in the fluid cells (in the center
+    // area of the domain, if diffusion)
+    void init_replicas(const bool diffusion);
+
+    // Sets up the collision rules of the cells and the boundary policy from the cell types
+    void setup_cell_rows();
+
+    // Makes the next step copy the staged node states to all replicas again
+    void invalidate_node_states() { m_words_valid = false; }
+
+    // Makes the next step set up the collision rules of the cells again, the node states of the
+    // replicas are kept
+    void invalidate_cell_types() { m_cell_rows_valid = false; }
+
+    // Allocates the memory for the arrays on the host (CPU).
+    void allocate_memory();
+
+    // Frees the memory for the arrays on the host (CPU).
+    void free_memory();
+
+public:
+
+    // Creates an ensemble of TBB parallelized lattice gas cellular automaton objects of the
+    // specified properties.
+    Ensemble_Lattice(const string m_test_case,
+                     const Real m_Re, const Real m_Ma_s,
+                     const int m_coarse_graining_radius);
+
+    virtual ~Ensemble_Lattice();
+
+    // Sets (proper) parallelization parameters.
+    void setup_parallel();
+
+    // Initializes every replica with some random distributed particles
+    void init_random();
+
+    // Initializes every replica with some random distributed particles in the center area of the
+    // domain
+    void init_diffusion();
+
+    // Performs the collision and propagation step on all replicas.
+    void collide_and_propagate(const bool p);
+
+    // Applies a body force in the specified direction (x or y) and with the specified intensity to
+    // the particles of every replica. E.g., if the intensity is equal 100, 100 particles of a
+    // replica change their direction on average, if feasible.
+    void apply_body_force(const int forcing);
+
+    // Applies a body force of the specified intensity spread over the next num_steps steps by the
+    // step kernel (see FusedForcing)
+    bool set_fused_forcing(const int forcing, const unsigned int num_steps);
+
+    // Returns the number of particles summed up over all replicas
+    unsigned long get_n_particles();
+
+    // Copies the node states of replica 0 to the output buffer for visualization
+    void copy_data_to_output_buffer();
+
+    // Computes the ensemble averaged cell quantities and the coarse grained quantities as a
+    // post-processing procedure
+    void post_process();
+
+    // Sets the seed of the random bits for collision. Runs with the same seed are reproducible
+    // bit by bit, independent of the number of threads.
+    void set_seed(const uint64_t seed) { m_rng.set_seed(seed); m_forcing.set_seed(seed); }
+
+    // Returns the boundary policy the step kernel is specialized for (determined from the cell
+    // types on the first step)
+    Boundary boundary() const { return m_boundary; }
+};
+
+} // namespace lgca
+
+#endif /* LGCA_ENSEMBLE_LATTICE_H_ */
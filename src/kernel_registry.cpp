@@ -0,0 +1,182 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kernel_registry.h"
+
+#include "bitplane_lattice.h"
+#include "block_sparse_lattice.h"
+#include "ensemble_lattice.h"
+#include "omp_lattice.h"
+
+namespace lgca {
+
+// Returns the suffix of the names of the bit-sliced variants for the specified instruction set
+// extension
+static inline const char* bitplane_kernel_suffix(const SimdIsa isa) {
+
+    switch (isa) {
+    case SimdIsa::SCALAR: return "scalar";
+    case SimdIsa::AVX2:   return "avx2";
+    case SimdIsa::AVX512: return "avx512";
+    }
+
+    return "unknown";
+}
+
+// Returns the variants supported by the CPU.
+template<Model model_>
+std::vector<KernelVariant<model_>> KernelRegistry<model_>::variants() {
+
+    std::vector<KernelVariant<model_>> variants;
+
+    for (const OMP_Kernel kernel : { OMP_Kernel::BOOLEAN, OMP_Kernel::LUT }) {
+
+        variants.push_back({ (kernel == OMP_Kernel::BOOLEAN) ? "omp-boolean" : "omp-lut",
+                             [kernel](const string test_case, const Real Re, const Real Ma_s,
+                                      const int coarse_graining_radius) -> Lattice<model_>* {
+
+            OMP_Lattice<model_>* lattice = new OMP_Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius);
+            lattice->set_kernel(kernel);
+
+            return lattice;
+        }});
+    }
+
+    const SimdIsa max_isa = detect_simd_isa();
+
+    for (const SimdIsa isa : { SimdIsa::SCALAR, SimdIsa::AVX2, SimdIsa::AVX512 }) {
+
+        if (int(isa) > int(max_isa)) break;
+
+        variants.push_back({ string("bitplane-") + bitplane_kernel_suffix(isa),
+                             [isa](const string test_case, const Real Re, const Real Ma_s,
+                                   const int coarse_graining_radius) -> Lattice<model_>* {
+
+            BitPlane_Lattice<model_>* lattice = new BitPlane_Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius);
+            lattice->set_simd_isa(isa);
+
+            return lattice;
+        }});
+    }
+
+    for (const BlockOrder order : { BlockOrder::ROW_MAJOR, BlockOrder::MORTON }) {
+
+        variants.push_back({ (order == BlockOrder::ROW_MAJOR) ? "sparse" : "sparse-morton",
+                             [order](const string test_case, const Real Re, const Real Ma_s,
+                                     const int coarse_graining_radius) -> Lattice<model_>* {
+
+            BlockSparse_Lattice<model_>* lattice = new BlockSparse_Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius);
+            lattice->set_block_order(order);
+
+            return lattice;
+        }});
+    }
+
+    return variants;
+}
+
+// Creates a lattice of the specified properties using the variant of the specified name.
+template<Model model_>
+Lattice<model_>* KernelRegistry<model_>::create(const string kernel,
+                                                const string test_case,
+                                                const Real Re, const Real Ma_s,
+                                                const int coarse_graining_radius) {
+
+    string name = kernel;
+
+    if (name == "omp")      name = "omp-lut";
+    if (name == "bitplane") name = string("bitplane-") + bitplane_kernel_suffix(detect_simd_isa());
+
+    // The ensemble of replicas simulates a different system than the variants, which is why it is
+    // not considered by the autotuning
+    if (name == "ensemble") return new Ensemble_Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius);
+
+    for (const KernelVariant<model_>& variant : variants())
+        if (variant.name == name) return variant.create(test_case, Re, Ma_s, coarse_graining_radius);
+
+    printf("ERROR in KernelRegistry::create(): Invalid or unsupported kernel %s.\n", kernel.c_str());
+    abort();
+}
+
+// Times every variant on a copy of the specified lattice and returns a copy using the fastest one.
+// The first step of a variant sets up its data layouts and is not timed. The node states of all
+// variants are compared with the ones of the first variant, variants producing different node
+// states are discarded.
+template<Model model_>
+Lattice<model_>* KernelRegistry<model_>::autotune(Lattice<model_>* lattice, const unsigned int steps) {
+
+    const std::vector<KernelVariant<model_>> candidates = variants();
+
+    printf("Kernel autotuning: Timing %zu variants for %u steps each...\n", candidates.size(), steps);
+
+    Lattice<model_>* reference = NULL;
+
+    size_t best      = 0;
+    double best_perf = -1.0;
+
+    for (size_t i = 0; i < candidates.size(); ++i) {
+
+        Lattice<model_>* candidate = candidates[i].create(lattice->test_case(), lattice->Re(), lattice->Ma_s(),
+                                                          lattice->coarse_graining_radius());
+        candidate->copy_state(*lattice);
+        candidate->collide_and_propagate();
+
+        const steady_clock::time_point start = steady_clock::now();
+
+        for (unsigned int step = 0; step < steps; ++step) candidate->collide_and_propagate();
+
+        const double time = duration<double>(steady_clock::now() - start).count();
+        const double perf = lattice->num_cells() * double(steps) / time / 1.0e06;
+
+        const bool valid = (reference == NULL) || candidate->has_same_node_states(*reference);
+
+        printf("    %-16s %10.1f MNUPS%s\n", candidates[i].name.c_str(), perf,
+               valid ? "" : " (node states differ, discarded)");
+
+        if (valid && perf > best_perf) {
+
+            best      = i;
+            best_perf = perf;
+        }
+
+        if (reference == NULL) reference = candidate;
+        else                   delete candidate;
+    }
+
+    delete reference;
+
+    printf("...done. Selected kernel %s.\n\n", candidates[best].name.c_str());
+
+    // Continue with a copy of the lattice in its initial state
+    Lattice<model_>* tuned = candidates[best].create(lattice->test_case(), lattice->Re(), lattice->Ma_s(),
+                                                     lattice->coarse_graining_radius());
+    tuned->copy_state(*lattice);
+
+    delete lattice;
+
+    return tuned;
+}
+
+// Explicit instantiations
+template class KernelRegistry<Model::HPP>;
+template class KernelRegistry<Model::FHP_I>;
+template class KernelRegistry<Model::FHP_II>;
+template class KernelRegistry<Model::FHP_III>;
+
+} // namespace lgca
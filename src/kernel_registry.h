@@ -0,0 +1,75 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_KERNEL_REGISTRY_H_
+#define LGCA_KERNEL_REGISTRY_H_
+
+#include "lattice.h"
+
+#include <functional>
+#include <vector>
+
+namespace lgca {
+
+// Implementation of the collision and propagation step, i.e. a CPU lattice with a fixed step
+// kernel
+template<Model model_>
+struct KernelVariant {
+
+    // Name of the variant as given on the command line (e.g. "omp-lut" or "bitplane-avx2")
+    string name;
+
+    // Creates a lattice of the specified properties using the variant
+    std::function<Lattice<model_>*(const string test_case,
+                                   const Real Re, const Real Ma_s,
+                                   const int coarse_graining_radius)> create;
+};
+
+// Registry of the step kernels available on the CPU the program runs on. Lattices are created by
+// the name of a variant, or by "auto" to pick the fastest variant for the actual lattice.
+template<Model model_>
+class KernelRegistry {
+
+public:
+
+    // Number of steps every variant is timed for by the autotuning
+    static constexpr unsigned int AUTOTUNE_STEPS = 10;
+
+    // Returns the variants supported by the CPU. Besides their names, "omp" selects the lookup
+    // table kernel of OMP_Lattice and "bitplane" the widest kernel of BitPlane_Lattice.
+    static std::vector<KernelVariant<model_>> variants();
+
+    // Creates a lattice of the specified properties using the variant of the specified name, or an
+    // ensemble of replicas of the lattice (Ensemble_Lattice) for "ensemble"
+    static Lattice<model_>* create(const string kernel,
+                                   const string test_case,
+                                   const Real Re, const Real Ma_s,
+                                   const int coarse_graining_radius);
+
+    // Times every variant for the specified number of steps on a copy of the specified lattice
+    // (with boundary conditions and initial node states applied), cross-checks that all of them
+    // produce identical node states, and returns a copy of the lattice using the fastest one. The
+    // choice and the performance of every variant are reported. The specified lattice is deleted.
+    static Lattice<model_>* autotune(Lattice<model_>* lattice,
+                                     const unsigned int steps = AUTOTUNE_STEPS);
+};
+
+} // namespace lgca
+
+#endif /* LGCA_KERNEL_REGISTRY_H_ */
@@ -18,8 +18,9 @@
  */
 
 #include "lattice.h"
+#include "lgca_parallel.h"
 
-#include <omp.h>
+#include <tbb/blocked_range.h>
 
 #include <cstring> // std::memcpy
 
@@ -144,6 +145,10 @@ Lattice<model_>::Lattice(const string test_case,
     m_num_cells = m_dim_x * m_dim_y;
     m_num_nodes = m_num_cells * NUM_DIR;
 
+    // All rows are staged
+    m_staged_y_begin = 0;
+    m_staged_y_end   = m_dim_y;
+
     m_num_particles = 0;
 
     assert(coarse_graining_radius > 0);
@@ -166,28 +171,49 @@ Lattice<model_>::~Lattice() {
 template<Model model_>
 void Lattice<model_>::init_zero() {
 
-    // Bitset is initialized with zeros anyway
+    // The staged node states are zero
+    stage_node_states();
 }
 
-// Prints the lattice to the screen.
+// Re-allocates the node states with all bits zero and discards the packed node states.
+template<Model model_>
+void Lattice<model_>::stage_node_states() {
+
+    invalidate_node_states();
+
+    m_node_state_cpu.resize(num_staged_cells() * 8);
+}
+
+// Prints the lattice to the screen. The node states are printed from the output buffer, since
+// lattices may hold them in a layout of their own.
 template<Model model_>
 void Lattice<model_>::print() {
 
-    m_node_state_cpu.print();
+    copy_data_to_output_buffer();
+
+    m_node_state_out_cpu.print();
 }
 
-// Returns the number of particles in the lattice.
+// Performs the specified number of collision and propagation steps.
 template<Model model_>
-unsigned long Lattice<model_>::get_n_particles() {
+void Lattice<model_>::advance(const unsigned int n_steps) {
 
-    // TODO Implement and use count() function in Bitset class
+    for (unsigned int step = 0; step < n_steps; ++step) collide_and_propagate();
+}
 
-    size_t n_particles = 0;
+// Lattices applying body forces by their step kernels override this.
+template<Model model_>
+bool Lattice<model_>::set_fused_forcing(const int /*forcing*/, const unsigned int /*num_steps*/) {
 
-    // Loop over all the nodes.
-#pragma omp parallel for reduction(+:n_particles)
-    for (size_t n = 0; n < m_num_cells * 8; ++n)
-        n_particles += bool(m_node_state_cpu[n]);
+    return false;
+}
+
+// Returns the number of particles in the lattice.
+template<Model model_>
+unsigned long Lattice<model_>::get_n_particles() {
+
+    // Count the set bits of the node states word by word
+    const size_t n_particles = m_node_state_cpu.parallel_count();
 
     this->m_num_particles = n_particles;
 
@@ -198,22 +224,63 @@ unsigned long Lattice<model_>::get_n_particles() {
 template<Model model_>
 void Lattice<model_>::init_random() {
 
-    // Loop over all cells
-#pragma omp parallel for
-    for (size_t cell = 0; cell < m_num_cells; ++cell) {
+    init_random_cells([](const size_t /*cell*/) { return true; });
+}
 
-        // Check weather the cell is a fluid cell
-        if (m_cell_type_cpu[cell] == CellType::FLUID) {
+// Initializes the staged node states with some random distributed particles in the fluid cells for
+// which in_area() returns true. The random numbers are drawn cell by cell in the order of the
+// whole lattice, so that the random numbers of the rows which are not staged are skipped.
+template<Model model_>
+void Lattice<model_>::init_random_cells(const std::function<bool(const size_t cell)>& in_area) {
+
+    stage_node_states();
+
+    const auto drawn = [&](const size_t cell) {
+
+        return staged_cell_type(cell) == CellType::FLUID && in_area(cell);
+    };
+
+    size_t num_before, num_total;
+    count_cells(drawn, num_before, num_total);
+
+    // Skip the random numbers of the cells before the staged rows
+    for (size_t n = 0; n < num_before * NUM_DIR; ++n) random_uniform();
+
+    size_t num_drawn = 0;
+
+    // Loop over the staged cells. The loop is serial, so that the random numbers are drawn in the
+    // same order in every run (and the cells sharing a word of the bitset are set by one thread).
+    for (size_t cell = staged_cell_begin(); cell < staged_cell_begin() + num_staged_cells(); ++cell) {
+
+        // Check weather the cell is a fluid cell in the area
+        if (drawn(cell)) {
 
             // Loop over all nodes in the fluid cell.
             for (int dir = 0; dir < NUM_DIR; ++dir) {
 
                 // Set random states for the nodes in the fluid cell
-                m_node_state_cpu[dir + cell * 8] =
+                m_node_state_cpu[dir + (cell - staged_cell_begin()) * 8] =
                         bool(random_uniform() > (1.0 - (1.0 / NUM_DIR)));
             }
+
+            ++num_drawn;
 	    }
 	}
+
+    // Skip the random numbers of the cells after the staged rows
+    for (size_t n = 0; n < (num_total - num_before - num_drawn) * NUM_DIR; ++n) random_uniform();
+}
+
+// Counts the cells of the lattice for which counted() returns true. All rows are staged.
+template<Model model_>
+void Lattice<model_>::count_cells(const std::function<bool(const size_t cell)>& counted,
+                                  size_t& num_before, size_t& num_total) {
+
+    num_before = 0;
+    num_total  = 0;
+
+    for (size_t cell = staged_cell_begin(); cell < staged_cell_begin() + num_staged_cells(); ++cell)
+        if (counted(cell)) ++num_total;
 }
 
 // Applies boundary conditions for a peridoc domain, i.e. no boundaries over
@@ -256,14 +323,19 @@ void Lattice<model_>::apply_bc_karman_vortex_street() {
     // lower edge of the rectangular domain
     apply_bc_pipe();
 
+    // The cell types of the cylinder are written directly
+    invalidate_cell_types();
+
     // Define the position and size of the barrier
     int  center_x = m_dim_x / 6;
     int  center_y = m_dim_y / 2 + 1 / 10 * m_dim_y;
     Real diameter = m_dim_y / 3;
 
-    // Loop over all cells
-#pragma omp parallel for
-    for (size_t cell = 0; cell < m_num_cells; ++cell) {
+    // Loop over the staged cells
+    const size_t cell_begin = staged_cell_begin();
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(cell_begin, cell_begin + num_staged_cells()), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell) {
 
         // Get the position of the current cell
         int pos_x = cell % m_dim_x;
@@ -274,9 +346,9 @@ void Lattice<model_>::apply_bc_karman_vortex_street() {
         if (dist < (diameter / 2.0)) {
 
             // Set the cell type to solid cells of bounce back type
-            m_cell_type_cpu[cell] = CellType::SOLID_NO_SLIP;
+            staged_cell_type(cell) = CellType::SOLID_NO_SLIP;
         }
-    }
+    }});
 }
 
 // Initializes the lattice gas automaton with two colliding particles
@@ -300,10 +372,11 @@ void Lattice<model_>::init_single(const std::vector<size_t> occupied_nodes) {
     // Initialize the lattice with zeros
     init_zero();
 
-    // Loop over the nodes to place a particle at
+    // Loop over the nodes to place a particle at (in the staged rows)
     for (int n = 0; n < occupied_nodes.size(); ++n) {
 
-        m_node_state_cpu[occupied_nodes[n]] = bool(1);
+        if (occupied_nodes[n] / 8 - staged_cell_begin() < num_staged_cells())
+            m_node_state_cpu[occupied_nodes[n] - staged_cell_begin() * 8] = bool(1);
     }
 }
 
@@ -337,21 +410,25 @@ void Lattice<model_>::apply_bc_reflecting(const string bounce_type) {
 template<Model model_>
 void Lattice<model_>::apply_cell_type_all(const CellType cell_type) {
 
-    // Loop over all cells
-#pragma omp parallel for
-    for (size_t cell = 0; cell < m_num_cells; ++cell) {
+    invalidate_cell_types();
+
+    // Loop over the staged cells
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, num_staged_cells()), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell) {
 
         // Set the cell type to the specified type
         m_cell_type_cpu[cell] = cell_type;
-    }
+    }});
 }
 
 // Applies the specified cell type to cells located on the eastern boundary of the rectangular domain
 template<Model model_>
 void Lattice<model_>::apply_boundary_cell_type_east(const CellType cell_type) {
 
-    // Loop over the cells located at the eastern boundary of the rectangular domain
-    for (size_t cell = m_dim_x - 1; cell < m_num_cells; cell += m_dim_x) {
+    invalidate_cell_types();
+
+    // Loop over the staged cells located at the eastern boundary of the rectangular domain
+    for (size_t cell = m_dim_x - 1; cell < num_staged_cells(); cell += m_dim_x) {
 
         // Set the cell type to the specified type
         m_cell_type_cpu[cell] = cell_type;
@@ -362,8 +439,12 @@ void Lattice<model_>::apply_boundary_cell_type_east(const CellType cell_type) {
 template<Model model_>
 void Lattice<model_>::apply_boundary_cell_type_north(const CellType cell_type) {
 
+    invalidate_cell_types();
+
+    if (m_staged_y_end != int(m_dim_y)) return;
+
     // Loop over the cells located at the northern boundary of the rectangular domain
-    for (size_t cell = m_num_cells - m_dim_x; cell < m_num_cells; ++cell) {
+    for (size_t cell = num_staged_cells() - m_dim_x; cell < num_staged_cells(); ++cell) {
 
         // Set the cell type to the specified type
         m_cell_type_cpu[cell] = cell_type;
@@ -374,8 +455,10 @@ void Lattice<model_>::apply_boundary_cell_type_north(const CellType cell_type) {
 template<Model model_>
 void Lattice<model_>::apply_boundary_cell_type_west(const CellType cell_type) {
 
-    // Loop over the cells located at the western boundary of the rectangular domain
-    for (size_t cell = 0; cell < m_num_cells; cell += m_dim_x) {
+    invalidate_cell_types();
+
+    // Loop over the staged cells located at the western boundary of the rectangular domain
+    for (size_t cell = 0; cell < num_staged_cells(); cell += m_dim_x) {
 
         // Set the cell type to the specified type
         m_cell_type_cpu[cell] = cell_type;
@@ -386,6 +469,10 @@ void Lattice<model_>::apply_boundary_cell_type_west(const CellType cell_type) {
 template<Model model_>
 void Lattice<model_>::apply_boundary_cell_type_south(const CellType cell_type) {
 
+    invalidate_cell_types();
+
+    if (m_staged_y_begin != 0) return;
+
     // Loop over the cells located at the southern boundary of the rectangular domain
     for (size_t cell = 0; cell < m_dim_x; ++cell) {
 
@@ -440,6 +527,49 @@ void Lattice<model_>::copy_data_to_output_buffer()
     m_node_state_out_cpu.copy(m_node_state_cpu);
 }
 
+// Copies the cell types of the rows [y_begin, y_end) to the specified array. The rows have to be
+// staged.
+template<Model model_>
+void Lattice<model_>::copy_cell_types(CellType* cell_type, const int y_begin, const int y_end)
+{
+    assert(m_staged_y_begin <= y_begin && y_end <= m_staged_y_end);
+
+    std::memcpy(cell_type, m_cell_type_cpu + size_t(y_begin - m_staged_y_begin) * m_dim_x,
+                size_t(y_end - y_begin) * m_dim_x * sizeof(CellType));
+}
+
+// Copies the cell types and the current node states of the specified lattice of the same
+// dimensions. The node states are taken from the output buffer of the lattice, since lattices
+// may hold them in a layout of their own.
+template<Model model_>
+void Lattice<model_>::copy_state(Lattice& lattice)
+{
+    assert(lattice.m_num_cells == m_num_cells);
+
+    lattice.copy_data_to_output_buffer();
+
+    // The node states are staged first, so that the current ones are not kept for the new cell
+    // types. The node states of a cell are held by one block of the bitsets.
+    stage_node_states();
+    std::memcpy(m_node_state_cpu.ptr(), lattice.m_node_state_out_cpu.ptr() + staged_cell_begin(), num_staged_cells());
+
+    invalidate_cell_types();
+    lattice.copy_cell_types(m_cell_type_cpu, m_staged_y_begin, m_staged_y_end);
+}
+
+// Returns whether the current node states equal the ones of the specified lattice of the same
+// dimensions.
+template<Model model_>
+bool Lattice<model_>::has_same_node_states(Lattice& lattice)
+{
+    assert(lattice.m_num_cells == m_num_cells);
+
+    copy_data_to_output_buffer();
+    lattice.copy_data_to_output_buffer();
+
+    return m_node_state_out_cpu == lattice.m_node_state_out_cpu;
+}
+
 // Computes the number of particles to revert in the context of body force
 // in order to accelerate the flow.
 template<Model model_>
@@ -464,35 +594,213 @@ size_t Lattice<model_>::get_equilibrium_forcing()
 // in the center area of the domain.
 template<Model model_>
 void Lattice<model_>::init_diffusion()
+{
+    init_random_cells([&](const size_t cell) { return in_diffusion_area(cell); });
+}
+
+// Returns whether the specified cell lies in the center area of the domain initialized by
+// init_diffusion().
+template<Model model_>
+bool Lattice<model_>::in_diffusion_area(const size_t cell) const
 {
     // Define the position and size of the center area
     int  center_x = m_dim_x / 2;
     int  center_y = m_dim_y / 2;
     Real diameter = m_dim_y / 4;
 
-    // Loop over all cells
-#pragma omp parallel for
-    for (size_t cell = 0; cell < m_num_cells; ++cell) {
+    // Get the x and y position of the cell
+    int pos_x = cell % m_dim_x;
+    int pos_y = cell / m_dim_x;
 
-        // Get the x and y position of the current cell
-        int pos_x = cell % m_dim_x;
-        int pos_y = cell / m_dim_x;
+    Real dist = sqrt(pow((pos_x - center_x), 2.0) + pow((pos_y - center_y), 2.0));
 
-        Real dist = sqrt(pow((pos_x - center_x), 2.0) + pow((pos_y - center_y), 2.0));
+    return dist < (diameter / 2.0);
+}
 
-        // Check weather the cell is a fluid cell in the center area of the domain
-        if (m_cell_type_cpu[cell] == CellType::FLUID &&
-	    	dist                < (diameter / 2.0))
-	    {
-            // Loop over all nodes in the fluid cell
-            for (int dir = 0; dir < NUM_DIR; ++dir) {
+// Computes quantities of interest as a post-processing procedure
+template<Model model_>
+void Lattice<model_>::post_process() {
 
-                // Set random states for the nodes in the fluid cell
-                m_node_state_cpu[dir + cell * 8] =
-                        bool(random_uniform() > (1.0 - (1.0 / NUM_DIR)));
+    // Computes cell quantities of interest as a post-processing procedure
+	cell_post_process();
+
+    // Computes coarse grained quantities of interest as a post-processing procedure
+	mean_post_process();
+}
+
+// Computes cell quantities of interest as a post-processing procedure
+template<Model model_>
+void Lattice<model_>::cell_post_process()
+{
+    // Every cell reads its node states and cell type and writes its density and momentum
+    const size_t grain = Tuning::grain_size("lattice.cell_post_process", this->m_num_cells,
+                                            1 + sizeof(CellType) + (1 + this->SPATIAL_DIM) * sizeof(Real));
+
+    // Loop over lattice cells
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, this->m_num_cells, grain), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+    {
+        cell_post_process(cell);
+
+    } // for cell
+    });
+}
+
+// Computes the quantities of interest of the specified cell from the output buffer
+template<Model model_>
+void Lattice<model_>::cell_post_process(const size_t cell)
+{
+    // Initialize the cell quantities to be computed
+    char cell_density    = 0;
+    Real cell_momentum_x = 0.0;
+    Real cell_momentum_y = 0.0;
+
+    // Loop over nodes within the current cell
+#pragma unroll
+    for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+        char node_state = bool(this->m_node_state_out_cpu[dir + cell * 8]);
+
+        // Sum up the node states
+        cell_density += node_state;
+
+        // Sum up the node states multiplied by the lattice vector component for the current
+        // direction
+        cell_momentum_x += node_state * ModelDesc::LATTICE_VEC_X[dir];
+        cell_momentum_y += node_state * ModelDesc::LATTICE_VEC_Y[dir];
+    }
+
+    // Write the computed cell quantities to the related data arrays
+    this->m_cell_density_cpu [cell                        ] = (Real) cell_density;
+    this->m_cell_momentum_cpu[cell * this->SPATIAL_DIM    ] = cell_momentum_x;
+    this->m_cell_momentum_cpu[cell * this->SPATIAL_DIM + 1] = cell_momentum_y;
+}
+
+// Computes coarse grained quantities of interest as a post-processing procedure
+template<Model model_>
+void Lattice<model_>::mean_post_process()
+{
+    const int r = this->m_coarse_graining_radius;
+
+    // Every coarse cell reads the density and momentum of (2r)^2 cells
+    const size_t grain = Tuning::grain_size("lattice.mean_post_process", this->m_num_coarse_cells,
+                                            4 * r * r * (1 + this->SPATIAL_DIM) * sizeof(Real));
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, this->m_num_coarse_cells, grain), [&](const tbb::blocked_range<size_t>& range) {
+    for (size_t coarse_cell = range.begin(); coarse_cell != range.end(); ++coarse_cell)
+    {
+        // Get cell in the bottom left corner of the coarse cell
+        const size_t cell = (coarse_cell % this->m_coarse_dim_x) * (2 * r)
+                          + (coarse_cell / this->m_coarse_dim_x) * (2 * r) * this->m_dim_x;
+
+        // Calculate the position of the cell in x direction
+        int pos_x = cell % this->m_dim_x;
+
+        // Initialize the coarse grained quantities to be computed
+        Real mean_density    = 0.0;
+        Real mean_momentum_x = 0.0;
+        Real mean_momentum_y = 0.0;
+
+        // Initialize the number of actual existing coarse graining neighbor cells
+        int n_exist_neighbors = 0;
+
+        // The thread working on the cell has to know the cell quantities of the coarse graining
+        // neighbor cells, therefore looping over all neighbor cells and look it up
+#pragma unroll
+        for (int y = 0; y <= 2 * r; ++y) {
+
+            for (int x = 0; x <= 2 * r; ++x) {
+
+                // Get the index of the coarse graining neighbor cell
+                size_t neighbor_idx = cell + y * this->m_dim_x + x;
+
+                // Get the position of the coarse graining neighbor cell in x direction
+                int pos_x_neighbor = neighbor_idx % this->m_dim_x;
+
+                // Check weather the coarse graining neighbor cell is valid
+                if ((neighbor_idx >= 0) &&
+                    (neighbor_idx < this->m_num_cells) &&
+                    (abs(pos_x_neighbor - pos_x) <= r)) {
+
+                    // Increase the number of existing coarse graining neighbor cells
+                    n_exist_neighbors++;
+
+                    mean_density    += this->m_cell_density_cpu [neighbor_idx                        ];
+                    mean_momentum_x += this->m_cell_momentum_cpu[neighbor_idx * this->SPATIAL_DIM    ];
+                    mean_momentum_y += this->m_cell_momentum_cpu[neighbor_idx * this->SPATIAL_DIM + 1];
+                }
             }
-	    }
-	}
+        }
+
+        // Write the computed coarse grained quantities to the related data arrays
+        this->m_mean_density_cpu [coarse_cell                        ] = mean_density    / ((Real) n_exist_neighbors);
+        this->m_mean_momentum_cpu[coarse_cell * this->SPATIAL_DIM    ] = mean_momentum_x / ((Real) n_exist_neighbors);
+        this->m_mean_momentum_cpu[coarse_cell * this->SPATIAL_DIM + 1] = mean_momentum_y / ((Real) n_exist_neighbors);
+
+    }}); // for coarse_cell
+}
+
+// Computes the mean velocity of the lattice.
+template<Model model_>
+std::vector<Real> Lattice<model_>::get_mean_velocity() {
+
+    std::vector<Real> mean_velocity(this->SPATIAL_DIM, 0.0);
+
+    // Summed up x and y velocity components and number of fluid cells
+    struct VelocitySum {
+        Real   x, y;
+        size_t counter;
+    };
+
+    const size_t grain = Tuning::grain_size("lattice.get_mean_velocity", this->m_num_cells,
+                                            sizeof(CellType) + (1 + this->SPATIAL_DIM) * sizeof(Real));
+
+    // Sum up all (fluid) cell x and y velocity components.
+    const VelocitySum sum = Threads::parallel_reduce(tbb::blocked_range<size_t>(0, this->m_num_cells, grain), VelocitySum{0.0, 0.0, 0},
+        [&](const tbb::blocked_range<size_t>& r, VelocitySum sum) {
+    for (size_t n = r.begin(); n != r.end(); ++n) {
+
+        if (this->m_cell_type_cpu[n] == CellType::FLUID) {
+
+            sum.counter++;
+
+            Real cell_density = this->m_cell_density_cpu[n];
+
+            if (cell_density > 1.0e-06) {
+
+                sum.x += this->m_cell_momentum_cpu[n * this->SPATIAL_DIM    ] / cell_density;
+                sum.y += this->m_cell_momentum_cpu[n * this->SPATIAL_DIM + 1] / cell_density;
+            }
+
+#ifdef DEBUG
+
+            else if (fabs(cell_density) < 1.0e-06) {
+
+                // Do nothing.
+
+            } else if (cell_density < -1.0e-06) {
+
+                printf("ERROR in get_mean_velocity(): "
+                       "Negative cell density detected.");
+                abort();
+            }
+
+#endif
+
+        }
+    }
+        return sum;
+
+    }, [](const VelocitySum& a, const VelocitySum& b) {
+
+        return VelocitySum{a.x + b.x, a.y + b.y, a.counter + b.counter};
+    });
+
+    // Divide the summed up x and y components by the total number of fluid cells.
+    mean_velocity[0] = sum.x / (Real) sum.counter;
+    mean_velocity[1] = sum.y / (Real) sum.counter;
+
+    return mean_velocity;
 }
 
 // Explicit instantiations
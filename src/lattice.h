@@ -27,6 +27,8 @@
 #include "lgca_bitset.h"
 #include "lgca_models.h"
 
+#include <functional>
+
 namespace lgca {
 
 template<Model model_>
@@ -72,15 +74,22 @@ protected:
     // layer shear force.
     int m_equilibrium_forcing;
 
-    // Map which defines the type of the cells
+    // Rows [m_staged_y_begin, m_staged_y_end) of the lattice held by the cell types and the staged
+    // node states, i.e. all rows, unless the lattice holds a part of the lattice only (see
+    // MPI_Lattice). The init functions and the functions applying boundary conditions write the
+    // staged rows only, addressing the cells by their index in the whole lattice.
+    int m_staged_y_begin;
+    int m_staged_y_end;
+
+    // Map which defines the type of the cells of the staged rows
     //
     // 0 - fluid cell
     // 1 - solid cell, reflecting, bounce back
     // 2 - solid cell, reflecting, bounce forward
     CellType* m_cell_type_cpu;
 
-    // One-dimensional arrays of integers which contains the states of the nodes, i.e. the
-    // occupation numbers of the cellular automaton in the following sense:
+    // One-dimensional arrays of integers which contains the states of the nodes of the staged
+    // rows, i.e. the occupation numbers of the cellular automaton in the following sense:
     //
     // [DIR_0_CELL_0|DIR_1_CELL_0|DIR_2_CELL_0|...|DIR_0_CELL_1|DIR_1_CELL_1|...]
     //
@@ -107,9 +116,51 @@ protected:
     // Coarse grained momentum vectors (averaged over neighbor cells)
     Real* m_mean_momentum_cpu;
 
-    // Random bits for collision
-    Bitset m_rnd_cpu;
+    // Computes cell quantities of interest from the output buffer as a post-processing procedure
+    void cell_post_process();
+
+    // Computes the quantities of interest of the specified cell from the output buffer
+    void cell_post_process(const size_t cell);
+
+    // Computes coarse grained quantities of interest as a post-processing procedure
+    void mean_post_process();
+
+    // Re-allocates the node states with all bits zero, so that they can be written again, e.g. by
+    // the init functions. The node states the lattice implementation has packed into its own layout
+    // are discarded (see invalidate_node_states()).
+    void stage_node_states();
+
+    // Returns whether the specified cell lies in the center area of the domain initialized by
+    // init_diffusion()
+    bool in_diffusion_area(const size_t cell) const;
+
+    // Returns the index of the first cell and the number of cells of the staged rows
+    size_t staged_cell_begin() const { return size_t(m_staged_y_begin) * m_dim_x; }
+    size_t num_staged_cells()  const { return size_t(m_staged_y_end - m_staged_y_begin) * m_dim_x; }
+
+    // Returns the cell type of the cell of the staged rows with the specified index
+    CellType& staged_cell_type(const size_t cell) { return m_cell_type_cpu[cell - staged_cell_begin()]; }
 
+    // Initializes the staged node states with some random distributed particles in the fluid cells
+    // for which in_area() returns true
+    void init_random_cells(const std::function<bool(const size_t cell)>& in_area);
+
+    // Counts the cells of the lattice for which counted() returns true, in the rows before the
+    // staged rows and in total. counted() is called for cells of the staged rows only. Lattices
+    // holding a part of the lattice override this to sum up the counts of all parts.
+    virtual void count_cells(const std::function<bool(const size_t cell)>& counted,
+                             size_t& num_before, size_t& num_total);
+
+    // Discards the node states packed into the layout of the lattice implementation, so that the
+    // staged node states are packed again on the next step. Lattices packing the node states
+    // override this.
+    virtual void invalidate_node_states() {}
+
+    // Makes the cell types writable again, e.g. by the functions applying boundary conditions, and
+    // discards what the lattice implementation has derived from them, so that the cell types are
+    // set up again on the next step. The current node states are kept. Lattices deriving their own
+    // layout from the cell types (or releasing them) override this.
+    virtual void invalidate_cell_types() {}
 
 public:
 
@@ -154,7 +205,7 @@ public:
     void init_zero();
 
     // Initializes the lattice gas automaton with some random distributed particles
-    void init_random();
+    virtual void init_random();
 
     // Initializes the lattice gas automaton with single particles at defined nodes
     void init_single(const std::vector<size_t> occupied_nodes);
@@ -164,10 +215,10 @@ public:
 
     // Initializes the lattice gas automaton with some random distributed particles in the center
     // area of the domain
-    void init_diffusion();
+    virtual void init_diffusion();
 
     // Returns the number of particles in the lattice
-    unsigned long get_n_particles();
+    virtual unsigned long get_n_particles();
 
     // Prints the lattice to the screen
     void print();
@@ -190,8 +241,12 @@ public:
     // automaton
     virtual void collide_and_propagate(const bool p = false) = 0;
 
+    // Performs the specified number of collision and propagation steps. Lattices may override this
+    // to advance several steps at once.
+    virtual void advance(const unsigned int n_steps);
+
     // Computes the mean velocity of the lattice
-    virtual std::vector<Real> get_mean_velocity() = 0;
+    virtual std::vector<Real> get_mean_velocity();
 
     // Calls the CUDA kernel which applies a body force in the specified
     // direction (x or y) and with the specified intensity to the particles.
@@ -199,8 +254,17 @@ public:
     // changes it's direction, if feasible.
     virtual void apply_body_force(const int forcing) = 0;
 
-    // Calls the CUDA kernels which compute quantities of interest as a post-processing procedure
-    virtual void post_process() = 0;
+    // Applies a body force of the specified intensity spread over the next num_steps steps, i.e.
+    // the step kernels revert every site (particle which can be reverted) with probability
+    // forcing / (E num_steps) per step, with E the current number of sites, instead of reverting
+    // forcing sites at once. Zero stops the forcing. Returns false if the lattice does not support
+    // this (or the probability exceeds the one the step kernels can apply, see FusedForcing), in
+    // which case apply_body_force() has to be called instead.
+    virtual bool set_fused_forcing(const int forcing, const unsigned int num_steps);
+
+    // Computes quantities of interest as a post-processing procedure. CPU lattices evaluate the
+    // node states of the output buffer, the CUDA kernels are called by CUDA_Lattice.
+    virtual void post_process();
 
     // Copies all data arrays from the host (CPU) to the device (GPU)
     virtual void copy_data_to_device();
@@ -210,7 +274,23 @@ public:
 
     virtual void copy_data_to_output_buffer();
 
+    // Copies the cell types of the rows [y_begin, y_end) to the specified array. Lattices which hold
+    // the cell types in a layout of their own override this.
+    virtual void copy_cell_types(CellType* cell_type, const int y_begin, const int y_end);
+
+    // Copies the cell types and the current node states of the specified lattice of the same
+    // dimensions, e.g. to continue the simulation with another lattice implementation
+    void copy_state(Lattice& lattice);
+
+    // Returns whether the current node states equal the ones of the specified lattice of the same
+    // dimensions
+    bool has_same_node_states(Lattice& lattice);
+
     // Get functions
+    const string& test_case()       const { return m_test_case;         }
+    Real         Re()               const { return m_Re;                }
+    Real         Ma_s()             const { return m_Ma_s;              }
+    unsigned int coarse_graining_radius() const { return m_coarse_graining_radius; }
     Real         nu_s()             const { return m_nu_s;              }
     Real         c_s()              const { return m_c_s;               }
     Real         u()                const { return m_u;                 }
@@ -21,31 +21,53 @@
 #define LGCA_BITSET_H_
 
 #include "lgca_common.h"
+#include "lgca_memory.h"
+#include "lgca_parallel.h"
+#include "lgca_random.h"
 
-#include <tbb/spin_mutex.h>
+#include <tbb/blocked_range.h>
 
+#include <cstdint>
 #include <cstring> // memset
+#include <functional>
+#include <limits>
+#include <utility> // std::swap
+
+// The bits are held by 64-bit words and accessed by blocks of 8 bits (the node states of a cell)
+// as well, which requires the bytes of a word to be in little-endian order
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "Bitset requires a little-endian byte order."
+#endif
 
 namespace lgca {
 
-class Bitset
+// Set of bits held by an array of 64-bit words, which is obtained from the allocator policy
+// Allocator (see lgca_memory.h) and aligned with the cache lines by default. Bit pos is
+// bit pos % 64 of word pos / 64, and bit pos % 8 of block pos / 8, i.e. the blocks are the bytes
+// of the words. The lattices address the bits block by block (the node states of a cell), while
+// counting and the bulk operations work on whole words. The bits beyond the size of the bitset
+// (in the last word) are kept zero. A bitset owns its words, so that it can be moved and swapped,
+// but not copied (see copy() for copying the bits).
+template<class Allocator = AlignedAllocator>
+class BasicBitset
 {
 public:
 
     using Block = uint8_t;
-    using Mutex = tbb::spin_mutex; // TODO Maybe there's a more suitable mutex type
+    using Word  = uint64_t;
 
-    static constexpr Block BITS_PER_BLOCK = std::numeric_limits<Block>::digits;
+    static constexpr Block        BITS_PER_BLOCK = std::numeric_limits<Block>::digits;
+    static constexpr unsigned int BITS_PER_WORD  = std::numeric_limits<Word>::digits;
 
 
     // A proxy class to simulate lvalues of bit type
     class reference
     {
-        friend class Bitset;
+        friend class BasicBitset;
 
         // The one and only non-copy constructor
-        reference(Block& b/*, Mutex& m*/, Block pos)
-            : mBlock(b)/*, mMutex(m)*/, mMask((assert(pos < BITS_PER_BLOCK), Block(1) << pos)) { }
+        reference(Block& b, Block pos)
+            : mBlock(b), mMask((assert(pos < BITS_PER_BLOCK), Block(1) << pos)) { }
 
         void operator&(); // Left undefined
 
@@ -54,20 +76,19 @@ public:
         inline operator bool()  const { return (mBlock & mMask) != 0; }
         inline bool operator~() const { return (mBlock & mMask) == 0; }
 
-        inline reference& flip() { /*tbb::spin_mutex::scoped_lock lock(mMutex);*/ do_flip(); return *this; }
+        inline reference& flip() { do_flip(); return *this; }
 
-        inline reference& operator=(bool x)               { /*Mutex::scoped_lock lock(mMutex);*/ do_assign(  x); return *this; } // For b[i] = x
-        inline reference& operator=(const reference& rhs) { /*Mutex::scoped_lock lock(mMutex);*/ do_assign(rhs); return *this; } // For b[i] = b[j]
+        inline reference& operator=(bool x)               { do_assign(  x); return *this; } // For b[i] = x
+        inline reference& operator=(const reference& rhs) { do_assign(rhs); return *this; } // For b[i] = b[j]
 
-        inline reference& operator|=(bool x) { /*Mutex::scoped_lock lock(mMutex);*/ if  (x) do_set();   return *this; }
-        inline reference& operator&=(bool x) { /*Mutex::scoped_lock lock(mMutex);*/ if (!x) do_reset(); return *this; }
-        inline reference& operator^=(bool x) { /*Mutex::scoped_lock lock(mMutex);*/ if  (x) do_flip();  return *this; }
-        inline reference& operator-=(bool x) { /*Mutex::scoped_lock lock(mMutex);*/ if  (x) do_reset(); return *this; }
+        inline reference& operator|=(bool x) { if  (x) do_set();   return *this; }
+        inline reference& operator&=(bool x) { if (!x) do_reset(); return *this; }
+        inline reference& operator^=(bool x) { if  (x) do_flip();  return *this; }
+        inline reference& operator-=(bool x) { if  (x) do_reset(); return *this; }
 
      private:
 
         Block& mBlock;
-//        Mutex& mMutex;
         const Block mMask;
 
         inline void do_set() { mBlock |= mMask; }
@@ -76,125 +97,282 @@ public:
         inline void do_assign(bool x) { x? do_set() : do_reset(); }
     };
 
-    Bitset() : m_bits(nullptr)/*, m_mutexes(nullptr)*/, m_num_bits(0), m_num_blocks(0) {}
+    BasicBitset() : m_words(nullptr), m_num_bits(0), m_num_words(0) {}
+
+    // Allocate an array of get_num_words(size) words and initialize all its bits to zero
+    BasicBitset(size_t size)
+        : m_words(nullptr), m_num_bits(0), m_num_words(0)
+    {
+        resize(size);
+    }
+
+    BasicBitset(const BasicBitset&) = delete;
+    BasicBitset& operator=(const BasicBitset&) = delete;
 
-    // Allocate a block of memory for an array of getNumBlocks(size) elements,
-    // each of them sizeof(Block) bytes long, and initialize all its bits to zero
-    Bitset(size_t size)
-        : m_num_bits(size), m_num_blocks(get_num_blocks(size))
+    // Take over the words of the specified bitset, which is left empty
+    BasicBitset(BasicBitset&& other) noexcept
+        : m_words(other.m_words), m_num_bits(other.m_num_bits), m_num_words(other.m_num_words)
     {
-        m_bits = (Block*)calloc(m_num_blocks, sizeof(Block));
-//        m_mutexes = new Mutex[m_num_blocks];
+        other.m_words     = nullptr;
+        other.m_num_bits  = 0;
+        other.m_num_words = 0;
     }
 
-    ~Bitset()
+    BasicBitset& operator=(BasicBitset&& other) noexcept
     {
-        free(m_bits);
-        m_bits = nullptr;
+        swap(other);
+        other.resize(0);
+
+        return *this;
+    }
 
-//        delete[] m_mutexes;
-//        m_mutexes = nullptr;
+    ~BasicBitset()
+    {
+        deallocate();
     }
 
     // Resize bitset and set all its bits to zero
     inline void resize(size_t size)
     {
-        if (m_bits) { free(m_bits); /*delete[] m_mutexes;*/ };
+        deallocate();
 
-        m_num_bits   = size;
-        m_num_blocks = get_num_blocks(size);
+        m_num_bits  = size;
+        m_num_words = get_num_words(size);
+        m_words     = allocate(m_num_words);
+    }
 
-        m_bits = (Block*)calloc(m_num_blocks, sizeof(Block));
-//        m_mutexes = new Mutex[m_num_blocks];
+    // Exchange the words with the ones of the specified bitset (e.g. the buffers of a step)
+    inline void swap(BasicBitset& other) noexcept
+    {
+        std::swap(m_words,     other.m_words);
+        std::swap(m_num_bits,  other.m_num_bits);
+        std::swap(m_num_words, other.m_num_words);
     }
 
     // Return the value of the bit at position pos
     inline bool operator[](size_t pos) const
     {
         assert(pos < m_num_bits);
-        return (m_bits[block_idx(pos)] & bit_mask(pos)) != 0;
+        return (blocks()[block_idx(pos)] & bit_mask(pos)) != 0;
     }
 
     // Return a reference to the bit at position pos
     inline reference operator[](size_t pos)
     {
         assert(pos < m_num_bits);
-        return reference(m_bits[block_idx(pos)]/*, m_mutexes[block_idx(pos)]*/, bit_idx(pos));
+        return reference(blocks()[block_idx(pos)], bit_idx(pos));
     }
 
     // Return the value of the block at position pos
     inline Block operator()(size_t pos) const
     {
-        assert(pos < m_num_blocks);
-        return m_bits[pos];
+        assert(pos < get_num_blocks(m_num_bits));
+        return blocks()[pos];
     }
 
     // Return a reference to the block at position pos
     inline Block& operator()(size_t pos)
     {
-        assert(pos < m_num_blocks);
-        return m_bits[pos];
+        assert(pos < get_num_blocks(m_num_bits));
+        return blocks()[pos];
     }
 
     // Set the bit at position pos to the value value
     inline void set(size_t pos, bool value = true)
     {
         assert(pos < m_num_bits);
-        if (value) m_bits[block_idx(pos)] |= bit_mask(pos);
+        if (value) blocks()[block_idx(pos)] |= bit_mask(pos);
         else       reset(pos);
     }
 
     // Set all bits to true
     inline void set()
     {
-        memset(m_bits, int(~Block(0)), m_num_blocks * sizeof(Block));
+        memset(m_words, int(~Block(0)), m_num_words * sizeof(Word));
+        clear_padding();
     }
 
     // Reset (to zero) the bit at position pos
     inline void reset(size_t pos)
     {
         assert(pos < m_num_bits);
-        m_bits[block_idx(pos)] &= ~bit_mask(pos);
-//        mBits[block_index(pos)] |= bit_mask(pos);
-//        mBits[block_index(pos)] ^= bit_mask(pos);
+        blocks()[block_idx(pos)] &= ~bit_mask(pos);
     }
 
     // Reset (to zero) all bits in the bitset
     inline void reset()
     {
-        memset(m_bits, int(Block(0)), m_num_blocks * sizeof(Block));
+        memset(m_words, 0, m_num_words * sizeof(Word));
     }
 
     // Flip the bit value at position pos (converting zeros into ones and ones into zeros)
     inline void flip(size_t pos)
     {
         assert(pos < m_num_bits);
-        m_bits[block_idx(pos)] ^= bit_mask(pos);
+        blocks()[block_idx(pos)] ^= bit_mask(pos);
     }
 
     // Flip all bit values in the bitset (converting zeros into ones and ones into zeros)
     inline void flip()
     {
-        for (size_t i = 0; i < m_num_blocks; ++i)
-            m_bits[i] = ~m_bits[i];
+        for (size_t i = 0; i < m_num_words; ++i)
+            m_words[i] = ~m_words[i];
+
+        clear_padding();
     }
 
-    // TODO Return the number of bits in the bitset that are set (i.e., that have a value of one)
+    // Return the number of bits in the bitset that are set (i.e., that have a value of one)
     inline size_t count() const
     {
         size_t counter = 0;
-        for (size_t i = 0; i < m_num_bits; ++i)
-            counter += this->operator [](i);
+        for (size_t i = 0; i < m_num_words; ++i)
+            counter += __builtin_popcountll(m_words[i]);
 
         return counter;
     }
 
+    // Return the number of bits at the positions [pos_begin, pos_end) that are set
+    inline size_t count(size_t pos_begin, size_t pos_end) const
+    {
+        assert(pos_begin <= pos_end && pos_end <= m_num_bits);
+
+        if (pos_begin == pos_end) return 0;
+
+        const size_t word_begin = pos_begin / BITS_PER_WORD;
+        const size_t word_last  = (pos_end - 1) / BITS_PER_WORD;
+
+        // Masks of the bits of the first and the last word within the range
+        const Word first_mask = ~Word(0) << (pos_begin % BITS_PER_WORD);
+        const Word last_mask  = ~Word(0) >> (BITS_PER_WORD - 1 - (pos_end - 1) % BITS_PER_WORD);
+
+        if (word_begin == word_last) return __builtin_popcountll(m_words[word_begin] & first_mask & last_mask);
+
+        size_t counter = __builtin_popcountll(m_words[word_begin] & first_mask)
+                       + __builtin_popcountll(m_words[word_last]  & last_mask);
+
+        for (size_t i = word_begin + 1; i < word_last; ++i)
+            counter += __builtin_popcountll(m_words[i]);
+
+        return counter;
+    }
+
+    // Return the number of bits that are set, counted by the threads in parallel
+    inline size_t parallel_count() const
+    {
+        const size_t grain = Tuning::grain_size("bitset.parallel_count", m_num_words, sizeof(Word));
+
+        return Threads::parallel_reduce(tbb::blocked_range<size_t>(0, m_num_words, grain), size_t(0),
+            [&](const tbb::blocked_range<size_t>& r, size_t counter) {
+                for (size_t i = r.begin(); i != r.end(); ++i)
+                    counter += __builtin_popcountll(m_words[i]);
+                return counter;
+            }, std::plus<size_t>());
+    }
+
+    // Bitwise and, or and exclusive or with a bitset of the same size
+    inline BasicBitset& operator&=(const BasicBitset& other)
+    {
+        assert(other.size() == m_num_bits);
+        for (size_t i = 0; i < m_num_words; ++i)
+            m_words[i] &= other.m_words[i];
+
+        return *this;
+    }
+
+    inline BasicBitset& operator|=(const BasicBitset& other)
+    {
+        assert(other.size() == m_num_bits);
+        for (size_t i = 0; i < m_num_words; ++i)
+            m_words[i] |= other.m_words[i];
+
+        return *this;
+    }
+
+    inline BasicBitset& operator^=(const BasicBitset& other)
+    {
+        assert(other.size() == m_num_bits);
+        for (size_t i = 0; i < m_num_words; ++i)
+            m_words[i] ^= other.m_words[i];
+
+        return *this;
+    }
+
+    // Shift the bits by shift positions towards the higher positions, i.e. bit pos moves to
+    // pos + shift, carrying the bits over from word to word. The bits shifted out are lost, zeros
+    // are shifted in.
+    inline BasicBitset& operator<<=(size_t shift)
+    {
+        const size_t word_shift = shift / BITS_PER_WORD;
+        const size_t bit_shift  = shift % BITS_PER_WORD;
+
+        for (size_t i = m_num_words; i-- > 0; ) {
+
+            Word word = 0;
+
+            if (i >= word_shift) {
+
+                word = m_words[i - word_shift] << bit_shift;
+
+                // Carry the upper bits of the next lower word
+                if (bit_shift != 0 && i > word_shift)
+                    word |= m_words[i - word_shift - 1] >> (BITS_PER_WORD - bit_shift);
+            }
+
+            m_words[i] = word;
+        }
+
+        clear_padding();
+
+        return *this;
+    }
+
+    // Shift the bits by shift positions towards the lower positions, i.e. bit pos moves to
+    // pos - shift, carrying the bits over from word to word. The bits shifted out are lost, zeros
+    // are shifted in.
+    inline BasicBitset& operator>>=(size_t shift)
+    {
+        const size_t word_shift = shift / BITS_PER_WORD;
+        const size_t bit_shift  = shift % BITS_PER_WORD;
+
+        for (size_t i = 0; i < m_num_words; ++i) {
+
+            Word word = 0;
+
+            if (i + word_shift < m_num_words) {
+
+                word = m_words[i + word_shift] >> bit_shift;
+
+                // Carry the lower bits of the next higher word
+                if (bit_shift != 0 && i + word_shift + 1 < m_num_words)
+                    word |= m_words[i + word_shift + 1] << (BITS_PER_WORD - bit_shift);
+            }
+
+            m_words[i] = word;
+        }
+
+        return *this;
+    }
+
+    // Return whether the bits equal the ones of the specified bitset
+    inline bool operator==(const BasicBitset& other) const
+    {
+        return other.size() == m_num_bits && memcmp(m_words, other.m_words, m_num_words * sizeof(Word)) == 0;
+    }
+
+    inline bool operator!=(const BasicBitset& other) const { return !(*this == other); }
+
     // Return the number of bits in the bitset
     inline size_t size() const
     {
         return m_num_bits;
     }
 
+    // Return the number of words of the bitset
+    inline size_t num_words() const
+    {
+        return m_num_words;
+    }
+
     inline void print() const
     {
         for (size_t i = 0; i < m_num_bits; ++i)
@@ -202,25 +380,32 @@ public:
         cout << endl;
     }
 
-    inline void copy(const Bitset& other)
+    inline void copy(const BasicBitset& other)
     {
         assert(other.size() == m_num_bits);
-        memcpy(/*dst=*/(void*)m_bits, /*src=*/(const void*)other.ptr(), /*numBytes=*/m_num_blocks * sizeof(Block));
+        memcpy(/*dst=*/(void*)m_words, /*src=*/(const void*)other.m_words, /*numBytes=*/m_num_words * sizeof(Word));
     }
 
-    inline Block* ptr() { return &m_bits[0]; }
-    inline const Block* ptr() const { return &m_bits[0]; }
+    inline Block* ptr() { return blocks(); }
+    inline const Block* ptr() const { return blocks(); }
 
-    inline void operator=(Block* ptr)
-    {
-        // That's pretty dangerous... Let's hope bitset sizes do match...
-        m_bits = ptr;
-    }
+    inline Word* words() { return m_words; }
+    inline const Word* words() const { return m_words; }
 
-    inline void fill_random()
+    // Set the bits to random values, which are generated word by word by the threads in parallel
+    // from the index of the word and the specified seed
+    inline void fill_random(const uint64_t seed = CounterRng::DEFAULT_SEED)
     {
-        for (size_t i = 0; i < m_num_bits; ++i)
-            this->operator [](i) = (rand() % 2);
+        const CounterRng rng(seed);
+
+        const size_t grain = Tuning::grain_size("bitset.fill_random", m_num_words, sizeof(Word));
+
+        Threads::parallel_for(tbb::blocked_range<size_t>(0, m_num_words, grain), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t i = r.begin(); i != r.end(); ++i)
+                rng.bits(Word(i), 0, m_words[i]);
+        });
+
+        clear_padding();
     }
 
 
@@ -230,19 +415,63 @@ private:
     static inline Block  bit_idx  (size_t pos) { return static_cast<Block>(pos % BITS_PER_BLOCK); }
     static inline Block  bit_mask (size_t pos) { return Block(1) << bit_idx(pos); }
 
-    inline size_t get_num_blocks(size_t size)
+    static inline size_t get_num_blocks(size_t size)
     {
         return size / BITS_PER_BLOCK + static_cast<int>(size % BITS_PER_BLOCK != 0);
     }
 
-    // Bits are represented as a linear array of Blocks, and the size of a Block is 8 bits
-    Block* m_bits;
-//    Mutex* m_mutexes;
+    static inline size_t get_num_words(size_t size)
+    {
+        return size / BITS_PER_WORD + static_cast<int>(size % BITS_PER_WORD != 0);
+    }
+
+    // Allocate an array of the specified number of words, initialized to zero by the threads in
+    // parallel (the words hold the cells in order, i.e. the rows are first touched by the threads
+    // of the same part of the lattice)
+    static inline Word* allocate(size_t num_words)
+    {
+        if (num_words == 0) return nullptr;
+
+        Word* words = static_cast<Word*>(Allocator::allocate(num_words * sizeof(Word)));
+
+        parallel_zero_fill(words, num_words * sizeof(Word));
+
+        return words;
+    }
+
+    // Free the words by the allocator policy which allocated them
+    inline void deallocate()
+    {
+        if (m_words) Allocator::deallocate(m_words, m_num_words * sizeof(Word));
+
+        m_words = nullptr;
+    }
+
+    // Reset the bits beyond the size of the bitset in the last word
+    inline void clear_padding()
+    {
+        if (m_num_bits % BITS_PER_WORD != 0)
+            m_words[m_num_words - 1] &= ~Word(0) >> (BITS_PER_WORD - m_num_bits % BITS_PER_WORD);
+    }
+
+    inline Block*       blocks()       { return reinterpret_cast<Block*>(m_words);       }
+    inline const Block* blocks() const { return reinterpret_cast<const Block*>(m_words); }
+
+    // Bits are represented as a linear array of 64-bit words, which are accessed by blocks of 8
+    // bits as well
+    Word* m_words;
 
     size_t m_num_bits;
-    size_t m_num_blocks;
+    size_t m_num_words;
+
+}; // class BasicBitset
+
+template<class Allocator>
+inline void swap(BasicBitset<Allocator>& a, BasicBitset<Allocator>& b) noexcept { a.swap(b); }
 
-}; // class Bitset
+// Bitset of the lattices, which holds large node state arrays by huge pages (and smaller ones by
+// cache-line-aligned memory)
+using Bitset = BasicBitset<HugePageAllocator>;
 
 } // namespace lgca
 
@@ -0,0 +1,106 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_BOUNDARY_H_
+#define LGCA_BOUNDARY_H_
+
+#include "lgca_common.h"
+
+namespace lgca {
+
+// Boundary policies the step kernels are specialized for. The policy of a lattice follows from
+// the distribution of the cell types, i.e. from the boundary conditions applied by the app.
+enum class Boundary {
+    GENERIC,  // Any distribution of cell types (e.g. box, Karman vortex street, diffusion)
+    CHANNEL,  // Periodic in x direction, walls of no-slip cells in the first and last row (pipe)
+    PERIODIC  // Fluid cells only, periodic in x and y direction
+};
+
+static inline const char* boundary_name(const Boundary boundary) {
+
+    switch (boundary) {
+    case Boundary::GENERIC:  return "generic";
+    case Boundary::CHANNEL:  return "channel";
+    case Boundary::PERIODIC: return "periodic";
+    }
+
+    return "unknown";
+}
+
+// Kinds of rows of the lattice. The collision step of rows of uniform cell type evaluates one
+// collision rule only, while the results of all collision rules are blended according to the cell
+// type masks in mixed rows.
+enum class RowKind {
+    FLUID,
+    NO_SLIP,
+    MIXED
+};
+
+// Policy classes providing the kind of a row (0 <= y < dim_y) at compile time where possible
+struct GenericBoundary {
+
+    static constexpr Boundary ID = Boundary::GENERIC;
+
+    static LGCA_FORCE_INLINE RowKind row_kind(const int y, const int dim_y) { return RowKind::MIXED; }
+};
+
+struct ChannelBoundary {
+
+    static constexpr Boundary ID = Boundary::CHANNEL;
+
+    static LGCA_FORCE_INLINE RowKind row_kind(const int y, const int dim_y) {
+
+        return (y == 0 || y == dim_y - 1) ? RowKind::NO_SLIP : RowKind::FLUID;
+    }
+};
+
+struct PeriodicBoundary {
+
+    static constexpr Boundary ID = Boundary::PERIODIC;
+
+    static LGCA_FORCE_INLINE RowKind row_kind(const int y, const int dim_y) { return RowKind::FLUID; }
+};
+
+// Returns the most specialized boundary policy matching the specified cell types
+static inline Boundary detect_boundary(const CellType* cell_type, const int dim_x, const int dim_y) {
+
+    bool periodic = true;
+    bool channel  = true;
+
+    for (int y = 0; y < dim_y; ++y) {
+
+        const CellType wall_type = (y == 0 || y == dim_y - 1) ? CellType::SOLID_NO_SLIP : CellType::FLUID;
+
+        for (int x = 0; x < dim_x; ++x) {
+
+            const CellType type = cell_type[size_t(y) * dim_x + x];
+
+            periodic = periodic && (type == CellType::FLUID);
+            channel  = channel  && (type == wall_type);
+        }
+
+        if (!periodic && !channel) return Boundary::GENERIC;
+    }
+
+    return periodic ? Boundary::PERIODIC : Boundary::CHANNEL;
+}
+
+} // namespace lgca
+
+#endif /* LGCA_BOUNDARY_H_ */
@@ -34,6 +34,14 @@ namespace lgca {
 
 #define WORD_SIZE 8;
 
+// Forces inlining of small functions into the (possibly instruction set specific) kernels calling
+// them
+#if defined(__GNUC__)
+#define LGCA_FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define LGCA_FORCE_INLINE inline
+#endif
+
 using std::cout;
 using std::endl;
 using std::flush;
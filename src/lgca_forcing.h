@@ -0,0 +1,423 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_FORCING_H_
+#define LGCA_FORCING_H_
+
+#include "lgca_common.h"
+#include "lgca_parallel.h"
+#include "lgca_random.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <functional>
+#include <vector>
+
+namespace lgca {
+
+// Pair of directions of a cell the body force moves a particle between
+struct ForcingPair {
+    int from; // Direction the particle is moved from (occupied)
+    int to;   // Direction the particle is moved to (empty)
+};
+
+// Returns the pairs of directions the body force in the specified direction (x or y) moves the
+// particles between, and stores them in pairs
+template<Model model_>
+inline unsigned int body_force_pairs(const char bf_dir, ForcingPair pairs[2]) {
+
+    if (model_ == Model::HPP) {
+
+        if (bf_dir == 'x') { pairs[0] = { 2, 0 }; return 1; }
+        if (bf_dir == 'y') { pairs[0] = { 1, 3 }; return 1; }
+
+    } else {
+
+        if (bf_dir == 'x') { pairs[0] = { 3, 0 }; return 1; }
+        if (bf_dir == 'y') { pairs[0] = { 1, 5 }; pairs[1] = { 2, 4 }; return 2; }
+    }
+
+    return 0;
+}
+
+// Returns the sites of the specified pair of the eight cells at cells, held by one byte per cell
+// (bit dir holds the state in direction dir), as the bits 0 to 7 of the result
+LGCA_FORCE_INLINE unsigned int byte_cell_sites(const unsigned char* cells, const ForcingPair& pair) {
+
+    uint64_t states;
+    memcpy(&states, cells, sizeof(states));
+
+    const uint64_t sites = (states >> pair.from) & ~(states >> pair.to) & 0x0101010101010101ull;
+
+    // Gather the lowest bit of every byte into the highest byte
+    return unsigned((sites * 0x0102040810204080ull) >> 56);
+}
+
+// Selection of the sites a body force is applied to. A site is a pair of directions of a fluid cell
+// (see body_force_pairs()) with a particle in the first direction and none in the second one. Out
+// of the E sites of the lattice, exactly min(forcing, E) ones are reverted, each with the same
+// probability, i.e. the expected momentum injected is the one of picking random cells until
+// forcing particles have been reverted:
+//
+// 1. The sites of every row are counted by the threads in parallel.
+// 2. The number of sites selected from a row is floor(F * P_end / E + u) - floor(F * P_begin / E + u),
+//    with P_begin and P_end the number of sites before the row and up to its end, and u a random
+//    offset in [0, 1) (systematic sampling). These sum up to F = min(forcing, E), and every site
+//    is selected with probability F / E.
+// 3. The sites of every row are selected by Floyd's algorithm and reverted by the threads in
+//    parallel.
+//
+// The random numbers are drawn by the counter-based generator from the index of the row and the
+// number of the application, so that the sites selected depend on the seed and the number of
+// previous applications only, independent of the number of threads. Lattices split into slabs of
+// rows among several processes select the same sites as if they were not split (see the second
+// apply()).
+class ForcingSampler {
+
+public:
+
+    explicit ForcingSampler(const uint64_t seed = CounterRng::DEFAULT_SEED) : m_num_applications(0) { set_seed(seed); }
+
+    // Sets the seed of the random numbers. The stream is keyed differently from the random bits
+    // for collision drawn with the same seed.
+    void set_seed(const uint64_t seed) { m_rng.set_seed(seed ^ STREAM_KEY); }
+
+    // Reverts min(forcing, E) of the sites of the rows [0, num_rows), each of which streams about
+    // row_bytes bytes of the lattice. count_row(y) returns the number of sites of row y,
+    // revert_row(y, selected, num_selected) reverts the sites of row y with the specified ranks
+    // (sorted, in the order the sites are counted in), given as an array of uint32_t. Returns the
+    // number of sites reverted.
+    template<typename CountRow, typename RevertRow>
+    size_t apply(const int num_rows, const size_t row_bytes, const size_t forcing,
+                 CountRow count_row, RevertRow revert_row) {
+
+        return apply(0, num_rows, row_bytes, forcing, count_row, revert_row,
+                     [](uint64_t& /*sites_before*/, uint64_t& /*num_sites*/) {});
+    }
+
+    // Same for the slab of rows [first_row, first_row + num_rows) of a lattice split among several
+    // processes, which all call this collectively. The rows are passed to count_row() and
+    // revert_row() by their index within the slab. reduce_sites(sites_before, num_sites) is
+    // passed the number of sites of the slab in num_sites and returns the number of sites of the
+    // lattice before the slab in sites_before and of the whole lattice in num_sites (e.g. by
+    // MPI_Exscan() and MPI_Allreduce()). Returns the number of sites reverted by all processes.
+    template<typename CountRow, typename RevertRow, typename ReduceSites>
+    size_t apply(const int first_row, const int num_rows, const size_t row_bytes, const size_t forcing,
+                 CountRow count_row, RevertRow revert_row, ReduceSites reduce_sites) {
+
+        const uint64_t application = m_num_applications++;
+
+        // Number of sites before every row
+        m_row_sites.resize(num_rows + 1);
+        m_row_sites[0] = 0;
+
+        const int count_grain = Tuning::grain_size("forcing.count", num_rows, row_bytes);
+
+        Threads::parallel_for(tbb::blocked_range<int>(0, num_rows, count_grain), [&](const tbb::blocked_range<int>& r) {
+            for (int y = r.begin(); y != r.end(); ++y)
+                m_row_sites[y + 1] = count_row(y);
+        });
+
+        for (int y = 0; y < num_rows; ++y) m_row_sites[y + 1] += m_row_sites[y];
+
+        // Number of sites of the lattice before the rows and of the whole lattice
+        uint64_t sites_before = 0;
+        uint64_t num_sites    = m_row_sites[num_rows];
+
+        reduce_sites(sites_before, num_sites);
+
+        const uint64_t num_flips = std::min<uint64_t>(forcing, num_sites);
+
+        if (num_flips == 0) return 0;
+
+        // Random offset of the systematic sampling
+        uint64_t offset;
+        m_rng.bits(~uint64_t(0), application, offset);
+
+        const double u = (offset >> 11) * (1.0 / 9007199254740992.0);
+
+        // Number of sites selected up to the specified site (exclusive)
+        auto selected_before = [&](const uint64_t site) {
+            return uint64_t(std::floor(double(num_flips) * double(site) / double(num_sites) + u));
+        };
+
+        const int revert_grain = Tuning::grain_size("forcing.revert", num_rows, row_bytes);
+
+        Threads::parallel_for(tbb::blocked_range<int>(0, num_rows, revert_grain), [&](const tbb::blocked_range<int>& r) {
+
+            std::vector<uint32_t>& selected = m_selected.local();
+
+            for (int y = r.begin(); y != r.end(); ++y) {
+
+                const uint32_t num_row_sites = uint32_t(m_row_sites[y + 1] - m_row_sites[y]);
+
+                if (num_row_sites == 0) continue;
+
+                const uint32_t num_row_flips = uint32_t(std::min<uint64_t>(num_row_sites,
+                    selected_before(sites_before + m_row_sites[y + 1]) - selected_before(sites_before + m_row_sites[y])));
+
+                if (num_row_flips == 0) continue;
+
+                select(first_row + y, application, num_row_sites, num_row_flips, selected);
+
+                revert_row(y, selected.data(), selected.size());
+            }
+        });
+
+        return num_flips;
+    }
+
+    // Returns the number of sites of the rows [0, num_rows), each of which streams about row_bytes
+    // bytes of the lattice, counted by the threads in parallel
+    template<typename CountRow>
+    static size_t count(const int num_rows, const size_t row_bytes, CountRow count_row) {
+
+        const int grain = Tuning::grain_size("forcing.count", num_rows, row_bytes);
+
+        return Threads::parallel_reduce(tbb::blocked_range<int>(0, num_rows, grain), size_t(0),
+            [&](const tbb::blocked_range<int>& r, size_t num_sites) {
+                for (int y = r.begin(); y != r.end(); ++y)
+                    num_sites += count_row(y);
+                return num_sites;
+            }, std::plus<size_t>());
+    }
+
+    // Passes the bit positions of the set bits of the specified mask of sites whose ranks are
+    // selected to revert(bit), given the rank of the first site of the mask. Advances the rank and
+    // the selected ranks past the sites of the mask.
+    template<typename Word, typename Revert>
+    static LGCA_FORCE_INLINE void revert_selected(Word sites, size_t& rank,
+                                                  const uint32_t*& selected, const uint32_t* selected_end,
+                                                  Revert revert) {
+
+        const size_t num_sites = __builtin_popcountll(sites);
+
+        // Skip the mask as a whole if none of its sites is selected
+        if (selected == selected_end || *selected >= rank + num_sites) { rank += num_sites; return; }
+
+        for (; sites != 0; sites &= sites - 1, ++rank) {
+
+            if (selected != selected_end && *selected == rank) {
+
+                revert(__builtin_ctzll(sites));
+                ++selected;
+            }
+        }
+    }
+
+private:
+
+    // Key of the stream of the random numbers
+    static constexpr uint64_t STREAM_KEY = 0xB5AD4ECEDA1CE2A9ull;
+
+    CounterRng m_rng;
+
+    // Number of applications so far
+    uint64_t m_num_applications;
+
+    // Number of sites before every row
+    std::vector<uint64_t> m_row_sites;
+
+    // Ranks of the selected sites of a row (per thread)
+    tbb::enumerable_thread_specific<std::vector<uint32_t>> m_selected;
+
+    // Selects num_flips of the num_sites sites of the specified row by Floyd's algorithm, and
+    // stores their ranks in ascending order. More than half of the sites are selected by leaving
+    // the others out.
+    void select(const int y, const uint64_t application,
+                const uint32_t num_sites, const uint32_t num_flips,
+                std::vector<uint32_t>& selected) const {
+
+        const bool     invert = num_flips > num_sites / 2;
+        const uint32_t num    = invert ? num_sites - num_flips : num_flips;
+
+        selected.clear();
+
+        for (uint32_t j = num_sites - num; j < num_sites; ++j) {
+
+            // Random number in [0, j]
+            uint64_t rnd;
+            m_rng.bits((uint64_t(y) << 32) | j, application, rnd);
+
+            const uint32_t t = uint32_t((unsigned __int128)rnd * (j + 1) >> 64);
+
+            // Insert t if it has not been selected yet, or else j (which is larger than all the
+            // ranks selected so far)
+            auto pos = std::lower_bound(selected.begin(), selected.end(), t);
+
+            if (pos == selected.end() || *pos != t) selected.insert(pos, t);
+            else                                    selected.push_back(j);
+        }
+
+        if (!invert) return;
+
+        // Select the sites left out
+        const size_t num_left_out = selected.size();
+
+        for (uint32_t rank = 0, i = 0; rank < num_sites; ++rank) {
+
+            if (i < num_left_out && selected[i] == rank) ++i;
+            else                                         selected.push_back(rank);
+        }
+
+        selected.erase(selected.begin(), selected.begin() + num_left_out);
+    }
+};
+
+// Body force applied by the step kernels (fused forcing). Instead of reverting a number of sites at
+// once between the steps, the collision step reverts every site of a fluid cell with a small
+// probability p in every step, so that the force is applied smoothly over the steps at the cost of
+// a few bit operations per word of 64 cells:
+//
+// - One more random word is drawn for every word of cells and step from the generator of the
+//   random bits for collision (with the highest bit of the index of the word set, so that it
+//   differs from the random bits for collision).
+// - The forcing is tried on n cells of the word, with n = floor(64 p) + 1 if the bits 32 to 63 of
+//   the random word lie below the fractional part of 64 p, and n = floor(64 p) else.
+// - Every try picks a cell of the word by 6 of the bits 0 to 23 (one set of bits per try and pair).
+//
+// Every site is thereby reverted with probability p per step (slightly less if several tries pick
+// the same cell). The random words are a function of the seed, the word of cells and the step
+// only, i.e. the results are independent of the number of threads and the time blocking.
+class FusedForcing {
+
+public:
+
+    FusedForcing() : m_num_pairs(0), m_num_whole_tries(0), m_num_tries(0), m_threshold(0) {}
+
+    // Sets the probability every site is reverted with per step for the pairs of the body force in
+    // the specified direction (x or y), zero disables the forcing. The step kernels can apply a
+    // probability of up to 1 / 16 for one pair and 1 / 32 for two pairs. Returns false (and
+    // disables the forcing) if the probability exceeds this, in which case the body force has to be
+    // applied otherwise.
+    template<Model model_>
+    bool set(const char bf_dir, const double probability) {
+
+        m_num_pairs = (probability > 0.0) ? body_force_pairs<model_>(bf_dir, m_pairs) : 0;
+
+        if (m_num_pairs == 0) return true;
+
+        const unsigned int max_tries = NUM_LANE_BITS / 6 / m_num_pairs;
+
+        const double tries = 64.0 * probability;
+
+        if (tries > double(max_tries)) {
+
+            m_num_pairs = 0;
+            return false;
+        }
+
+        m_num_whole_tries = unsigned(tries);
+        m_threshold       = uint64_t((tries - m_num_whole_tries) * 4294967296.0 + 0.5);
+        m_num_tries       = std::min(m_num_whole_tries + 1, max_tries);
+
+        return true;
+    }
+
+    // Returns whether the forcing is applied by the step kernels
+    bool enabled() const { return m_num_pairs > 0; }
+
+    // Reverts the sites of the node states (one word per direction) of the cells of the specified
+    // word(s) the forcing is applied to in the specified step. Cells which are not fluid cells have
+    // to be masked out by the caller afterwards (e.g. by blending the results of the cell types).
+    template<typename Word>
+    LGCA_FORCE_INLINE void apply(const CounterRng& rng, const Word& index, const uint64_t step,
+                                 Word* node_state) const {
+
+        Word rnd;
+        rng.bits(index | COUNTER_BIT, step, rnd);
+
+        // One if the last try is made (bits 32 to 63 below the threshold), else zero
+        const Word hit = ((rnd >> 32) - m_threshold) >> 63;
+
+        unsigned int shift = 0;
+
+        for (unsigned int t = 0; t < m_num_tries; ++t) {
+
+            const Word tried = (t < m_num_whole_tries) ? (hit | 1) : hit;
+
+            for (unsigned int p = 0; p < m_num_pairs; ++p, shift += 6) {
+
+                const int from = m_pairs[p].from;
+                const int to   = m_pairs[p].to;
+
+                const Word site = (tried << ((rnd >> shift) & 63)) & node_state[from] & ~node_state[to];
+
+                node_state[from] ^= site;
+                node_state[to]   ^= site;
+            }
+        }
+    }
+
+    // Reverts the sites of the cells (one byte per cell) of the specified word the forcing is
+    // applied to in the specified step, restricted to the cells of the specified mask (e.g. the
+    // fluid cells). The same sites are reverted as by apply() on the transposed node states. The
+    // cells may hold a part of the word only, starting with the cell of lane first_lane, in which
+    // case the mask must not hold the lanes before.
+    LGCA_FORCE_INLINE void apply_cells(const CounterRng& rng, const uint64_t index, const uint64_t step,
+                                       unsigned char* cells, const uint64_t mask,
+                                       const unsigned int first_lane = 0) const {
+
+        uint64_t rnd;
+        rng.bits(index | COUNTER_BIT, step, rnd);
+
+        const unsigned int num_tries = m_num_whole_tries + ((rnd >> 32) < m_threshold);
+
+        unsigned int shift = 0;
+
+        for (unsigned int t = 0; t < std::min(num_tries, m_num_tries); ++t) {
+
+            for (unsigned int p = 0; p < m_num_pairs; ++p, shift += 6) {
+
+                const unsigned int  lane = (rnd >> shift) & 63;
+                const unsigned char from = 1u << m_pairs[p].from;
+                const unsigned char to   = 1u << m_pairs[p].to;
+
+                if (!((mask >> lane) & 1)) continue;
+
+                unsigned char& cell = cells[lane - first_lane];
+
+                if ((cell & (from | to)) == from) cell ^= from | to;
+            }
+        }
+    }
+
+private:
+
+    static constexpr uint64_t     COUNTER_BIT   = uint64_t(1) << 63;
+    static constexpr unsigned int NUM_LANE_BITS = 24; // Bits of the random word picking the cells
+
+    ForcingPair  m_pairs[2];
+    unsigned int m_num_pairs;
+
+    // Number of tries per word made always, and at most
+    unsigned int m_num_whole_tries;
+    unsigned int m_num_tries;
+
+    // Probability the last try is made, in units of 2^-32
+    uint64_t m_threshold;
+};
+
+} // namespace lgca
+
+#endif /* LGCA_FORCING_H_ */
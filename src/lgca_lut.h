@@ -0,0 +1,133 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_LUT_H_
+#define LGCA_LUT_H_
+
+#include "lgca_common.h"
+#include "lgca_models.h"
+
+namespace lgca {
+
+// Rows of the collision lookup table. Each row maps the node states of a cell, packed into one
+// index (bit dir holds the node state in direction dir), to the node states after the collision
+// step. The rows fuse the cell type into the lookup. Every row comes in two variants, the random
+// bit for collision is added to the (even) row index and selects the chirality of the collision of
+// fluid cells. The variants of the rows of solid cells are identical.
+enum LutRow : unsigned char {
+    LUT_FLUID            = 0, // Fluid cell
+    LUT_FLUID_CHIRAL     = 1, // Fluid cell, random bit set
+    LUT_BOUNCE_BACK      = 2, // Solid cell of bounce back type
+    LUT_BOUNCE_FORWARD_X = 4, // Solid cell of bounce forward type on the northern or southern boundary
+    LUT_BOUNCE_FORWARD_Y = 6, // Solid cell of bounce forward type on the eastern or western boundary
+    LUT_KEEP             = 8, // Solid cell of bounce forward type in the interior of the domain
+    LUT_NUM_ROWS         = 10
+};
+
+// Collision lookup table of a lattice gas model
+template<Model model_>
+struct CollisionTable {
+
+    static constexpr unsigned int NUM_STATES = 1 << ModelDescriptor<model_>::NUM_DIR;
+
+    unsigned char entry[LUT_NUM_ROWS][NUM_STATES];
+};
+
+// Returns the node states of a cell after the collision step according to the specified row of
+// the lookup table, evaluating the collision rules of the model descriptor.
+template<Model model_>
+constexpr unsigned char collision_table_entry(const unsigned int row, const unsigned int state) {
+
+    using ModelDesc = ModelDescriptor<model_>;
+
+    // Fluid cells look up the collision table expanded from the collision rules
+    if ((row & ~1u) == LUT_FLUID) return CollisionNetwork<ModelDesc>::TABLE.entry[row & 1][state];
+
+    unsigned char node_state_in [ModelDesc::NUM_DIR] = { };
+    unsigned char node_state_out[ModelDesc::NUM_DIR] = { };
+
+    for (unsigned int dir = 0; dir < ModelDesc::NUM_DIR; ++dir)
+        node_state_in[dir] = (state >> dir) & 1;
+
+    switch (row & ~1u) {
+    case LUT_BOUNCE_BACK:      ModelDesc::bounce_back     (node_state_in, node_state_out); break;
+    case LUT_BOUNCE_FORWARD_X: ModelDesc::bounce_forward_x(node_state_in, node_state_out); break;
+    case LUT_BOUNCE_FORWARD_Y: ModelDesc::bounce_forward_y(node_state_in, node_state_out); break;
+    default:
+        for (unsigned int dir = 0; dir < ModelDesc::NUM_DIR; ++dir)
+            node_state_out[dir] = node_state_in[dir];
+    }
+
+    unsigned char result = 0;
+
+    for (unsigned int dir = 0; dir < ModelDesc::NUM_DIR; ++dir)
+        result |= (node_state_out[dir] & 1) << dir;
+
+    return result;
+}
+
+// Generates the collision lookup table of a lattice gas model at compile time
+template<Model model_>
+constexpr CollisionTable<model_> generate_collision_table() {
+
+    CollisionTable<model_> table = { };
+
+    for (unsigned int row = 0; row < LUT_NUM_ROWS; ++row)
+        for (unsigned int state = 0; state < CollisionTable<model_>::NUM_STATES; ++state)
+            table.entry[row][state] = collision_table_entry<model_>(row, state);
+
+    return table;
+}
+
+template<Model model_>
+struct CollisionLUT {
+
+    static constexpr CollisionTable<model_> TABLE = generate_collision_table<model_>();
+
+    // Returns the (even) row of the lookup table for a cell of the specified type. Solid cells of
+    // bounce forward type are mirrored along the y axis on the eastern and western boundary (which
+    // takes precedence in the corners) and along the x axis on the northern and southern boundary.
+    static inline LutRow row(const CellType cell_type, const bool on_x_boundary, const bool on_y_boundary)
+    {
+        switch (cell_type) {
+        case CellType::FLUID:         return LUT_FLUID;
+        case CellType::SOLID_NO_SLIP: return LUT_BOUNCE_BACK;
+        case CellType::SOLID_SLIP:    return on_y_boundary ? LUT_BOUNCE_FORWARD_Y
+                                           : on_x_boundary ? LUT_BOUNCE_FORWARD_X
+                                           :                 LUT_KEEP;
+        }
+
+        return LUT_KEEP;
+    }
+
+    // Returns the node states of a cell after the collision step, given the row of the cell and
+    // the random bit for collision
+    static LGCA_FORCE_INLINE unsigned char lookup(const unsigned int row, const unsigned int p,
+                                                  const unsigned int state)
+    {
+        return TABLE.entry[row | p][state];
+    }
+};
+
+template<Model model_>
+constexpr CollisionTable<model_> CollisionLUT<model_>::TABLE;
+
+} // namespace lgca
+
+#endif /* LGCA_LUT_H_ */
@@ -0,0 +1,351 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_MEMORY_H_
+#define LGCA_MEMORY_H_
+
+#include "lgca_common.h"
+#include "lgca_parallel.h"
+
+#include <cstdint>
+#include <cstring> // memset
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility> // std::swap
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace lgca {
+
+// Zero-fills the specified memory by the threads in parallel, one contiguous part per thread, so
+// that its pages are first touched by the threads (and placed on their NUMA nodes, backed by
+// transparent huge pages) rather than all of them by the thread allocating the memory. Arrays
+// holding the rows of the lattice in order are thereby placed close to the threads updating the
+// rows.
+static inline void parallel_zero_fill(void* ptr, const size_t num_bytes) {
+
+    const int num_parts = Threads::num_threads();
+
+    Threads::static_parallel_for(0, num_parts, [&](const int part_begin, const int part_end) {
+
+        const size_t begin = num_bytes * part_begin / num_parts;
+        const size_t end   = num_bytes * part_end   / num_parts;
+
+        memset(static_cast<char*>(ptr) + begin, 0, end - begin);
+    });
+}
+
+// Allocator policies
+//
+// The arrays owning their memory (Bitset, DoubleBuffer) take the way they obtain it from an
+// allocator policy, i.e. a class with the static member functions
+//
+//     void* allocate(size_t num_bytes);             // Uninitialized memory, never null
+//     void  deallocate(void* ptr, size_t num_bytes); // Memory returned by allocate() (or null)
+//
+// so that the placement of the lattice arrays can be changed without touching the code which owns
+// them. The memory is freed by the policy which allocated it only.
+
+// Allocator policy for memory aligned with the cache lines
+struct AlignedAllocator {
+
+    // Alignment of the memory (the size of a cache line)
+    static constexpr size_t ALIGNMENT = 64;
+
+    static void* allocate(const size_t num_bytes) {
+
+        void* ptr = nullptr;
+
+        if (posix_memalign(&ptr, ALIGNMENT, (num_bytes > 0) ? num_bytes : 1) != 0) {
+
+            printf("ERROR in AlignedAllocator::allocate(): Failed to allocate %zu bytes.\n", num_bytes);
+            abort();
+        }
+
+        return ptr;
+    }
+
+    static void deallocate(void* ptr, const size_t /*num_bytes*/) { free(ptr); }
+};
+
+// Allocator policy for the large arrays of the lattices (several gigabytes on big lattices), which
+// are backed by huge pages of 2 MiB where possible, so that streaming them does not miss the TLB on
+// every 4 KiB page. Arrays of at least one huge page are mapped
+//
+// 1. from the huge pages reserved by the administrator (vm.nr_hugepages), if there are enough of
+//    them, or else
+// 2. as anonymous memory aligned with the huge pages, which the kernel is advised to back by
+//    transparent huge pages (madvise(MADV_HUGEPAGE)), or else
+//
+// allocated by AlignedAllocator, as are the smaller arrays. The memory is aligned with the cache
+// lines in any case. Mapped memory is zero-filled by the kernel on first touch, so that the pages
+// are placed on the NUMA nodes of the threads touching them first as usual.
+struct HugePageAllocator {
+
+    static constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+    static void* allocate(const size_t num_bytes) {
+
+#if defined(__linux__)
+        if (num_bytes >= HUGE_PAGE_SIZE) {
+
+            const size_t length = round_up(num_bytes);
+
+#if defined(MAP_HUGETLB)
+            void* ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if (ptr != MAP_FAILED) {
+
+                add_mapping(ptr, length, /*reserved=*/true);
+                return ptr;
+            }
+#endif
+            // Map one more huge page in order to align the memory with the huge pages, and unmap
+            // the parts before and after the aligned memory
+            char* const begin = static_cast<char*>(mmap(nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+            if (begin != MAP_FAILED) {
+
+                char* const aligned = begin + (HUGE_PAGE_SIZE - uintptr_t(begin) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+                char* const end     = begin + length + HUGE_PAGE_SIZE;
+
+                if (aligned > begin)        munmap(begin,            aligned - begin);
+                if (aligned + length < end) munmap(aligned + length, end - (aligned + length));
+
+#if defined(MADV_HUGEPAGE)
+                madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+                add_mapping(aligned, length, /*reserved=*/false);
+                return aligned;
+            }
+        }
+#endif
+        return AlignedAllocator::allocate(num_bytes);
+    }
+
+    static void deallocate(void* ptr, const size_t num_bytes) {
+
+        if (!ptr) return;
+
+#if defined(__linux__)
+        if (remove_mapping(ptr)) {
+
+            munmap(ptr, round_up(num_bytes));
+            return;
+        }
+#endif
+        AlignedAllocator::deallocate(ptr, num_bytes);
+    }
+
+    // Returns the number of huge pages backing the mapped arrays, and the number of huge pages they
+    // span (in total). Transparent huge pages are counted from /proc/self/smaps, so that they are
+    // known once the arrays have been touched.
+    static void usage(size_t& num_huge_pages, size_t& num_pages_mapped) {
+
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        num_huge_pages   = 0;
+        num_pages_mapped = 0;
+
+        for (const auto& mapping : s.mappings) {
+
+            num_pages_mapped += mapping.second.length / HUGE_PAGE_SIZE;
+
+            if (mapping.second.reserved) num_huge_pages += mapping.second.length / HUGE_PAGE_SIZE;
+        }
+
+#if defined(__linux__)
+        std::ifstream smaps("/proc/self/smaps");
+
+        // Memory areas of the process holding mapped arrays, which are counted once each
+        std::set<uintptr_t> counted_areas;
+
+        uintptr_t area_begin = 0, area_end = 0;
+        string line;
+
+        while (std::getline(smaps, line)) {
+
+            unsigned long begin, end, kb;
+
+            if (sscanf(line.c_str(), "%lx-%lx ", &begin, &end) == 2) {
+
+                area_begin = begin;
+                area_end   = end;
+
+            } else if (sscanf(line.c_str(), "AnonHugePages: %lu kB", &kb) == 1 && kb > 0) {
+
+                for (const auto& mapping : s.mappings) {
+
+                    const uintptr_t ptr = uintptr_t(mapping.first);
+
+                    if (!mapping.second.reserved && ptr < area_end && ptr + mapping.second.length > area_begin &&
+                        counted_areas.insert(area_begin).second)
+                        num_huge_pages += kb * 1024 / HUGE_PAGE_SIZE;
+                }
+            }
+        }
+#endif
+    }
+
+    // Prints the number of huge pages obtained for the mapped arrays
+    static void print_usage() {
+
+        size_t num_huge_pages, num_pages_mapped;
+        usage(num_huge_pages, num_pages_mapped);
+
+        printf("Huge pages: %zu of %zu pages of %zu MiB backing the lattice arrays.\n\n",
+               num_huge_pages, num_pages_mapped, HUGE_PAGE_SIZE >> 20);
+    }
+
+private:
+
+    struct Mapping {
+        size_t length;   // Multiple of the huge page size
+        bool   reserved; // Whether the huge pages are reserved ones (or transparent ones)
+    };
+
+    struct State {
+        std::mutex               mutex;
+        std::map<void*, Mapping> mappings; // Arrays mapped by allocate()
+    };
+
+    static State& state() {
+
+        static State state;
+        return state;
+    }
+
+    static size_t round_up(const size_t num_bytes) {
+
+        return (num_bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+
+    static void add_mapping(void* ptr, const size_t length, const bool reserved) {
+
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        s.mappings[ptr] = { length, reserved };
+    }
+
+    // Removes the specified array from the mapped ones, and returns whether it has been mapped
+    static bool remove_mapping(void* ptr) {
+
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        return s.mappings.erase(ptr) > 0;
+    }
+};
+
+// Pair of arrays of the same size holding the state of a lattice before (front) and after (back)
+// a step. The step kernels read the front array and write the back array, and swap() exchanges
+// them afterwards. Both arrays are owned by the double buffer and freed by its allocator policy, so
+// that it can be moved, but not copied.
+template<typename T, class Allocator = AlignedAllocator>
+class DoubleBuffer {
+
+    T* m_front;
+    T* m_back;
+
+    size_t m_size; // Number of elements of each array
+
+public:
+
+    DoubleBuffer() : m_front(nullptr), m_back(nullptr), m_size(0) {}
+
+    DoubleBuffer(const DoubleBuffer&) = delete;
+    DoubleBuffer& operator=(const DoubleBuffer&) = delete;
+
+    DoubleBuffer(DoubleBuffer&& other) noexcept
+        : m_front(other.m_front), m_back(other.m_back), m_size(other.m_size)
+    {
+        other.m_front = nullptr;
+        other.m_back  = nullptr;
+        other.m_size  = 0;
+    }
+
+    DoubleBuffer& operator=(DoubleBuffer&& other) noexcept
+    {
+        swap(other);
+        other.release();
+
+        return *this;
+    }
+
+    ~DoubleBuffer() { release(); }
+
+    // Allocates both arrays with the specified number of elements each, freeing the previous ones.
+    // The arrays are zero-filled by the threads in parallel (see parallel_zero_fill()) unless the
+    // caller zero-fills them by itself (e.g. row by row by the threads updating the rows).
+    void allocate(const size_t size, const bool zero_fill = true)
+    {
+        release();
+
+        m_front = static_cast<T*>(Allocator::allocate(size * sizeof(T)));
+        m_back  = static_cast<T*>(Allocator::allocate(size * sizeof(T)));
+        m_size  = size;
+
+        if (zero_fill) {
+
+            parallel_zero_fill(m_front, size * sizeof(T));
+            parallel_zero_fill(m_back,  size * sizeof(T));
+        }
+    }
+
+    // Frees both arrays
+    void release()
+    {
+        Allocator::deallocate(m_front, m_size * sizeof(T));
+        Allocator::deallocate(m_back,  m_size * sizeof(T));
+
+        m_front = nullptr;
+        m_back  = nullptr;
+        m_size  = 0;
+    }
+
+    // Exchanges the front and the back array
+    void swap() { std::swap(m_front, m_back); }
+
+    // Exchanges the arrays with the ones of the specified double buffer
+    void swap(DoubleBuffer& other) noexcept
+    {
+        std::swap(m_front, other.m_front);
+        std::swap(m_back,  other.m_back);
+        std::swap(m_size,  other.m_size);
+    }
+
+    inline       T* front()       { return m_front; }
+    inline const T* front() const { return m_front; }
+
+    inline       T* back()       { return m_back; }
+    inline const T* back() const { return m_back; }
+
+    inline size_t size() const { return m_size; }
+};
+
+} // namespace lgca
+
+#endif /* LGCA_MEMORY_H_ */
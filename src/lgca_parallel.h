@@ -0,0 +1,533 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_PARALLEL_H_
+#define LGCA_PARALLEL_H_
+
+#include "lgca_common.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/global_control.h>
+#include <tbb/info.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/partitioner.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace lgca {
+
+// NUMA placement of the lattice
+//
+// On systems with several sockets, the operating system places a page of memory on the socket of
+// the thread writing it first. The step kernels therefore loop over the rows (or chunks of rows)
+// of the lattice with a static partition, which hands the same rows to the same thread slot in
+// every loop over the same range, and the arrays streamed by the kernels are zero-filled by the
+// same loop right after they have been allocated (first touch). Every thread then updates rows
+// held by the memory of its own socket, as long as the thread slots do not migrate between the
+// sockets, which is ensured by pinning the threads to cores (see Threads::init()).
+
+// Observer of a task arena which pins every thread entering the arena to one core. The thread in
+// slot i of the arena is pinned to the i-th core (modulo the number of cores) the process may run
+// on, so that neighboring slots share a socket.
+class ThreadPinning : public tbb::task_scheduler_observer {
+
+public:
+
+    explicit ThreadPinning(tbb::task_arena& arena) : tbb::task_scheduler_observer(arena),
+                                                     m_num_cpus(0) {
+
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+
+        if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+
+            for (int cpu = 0; cpu < CPU_SETSIZE && m_num_cpus < MAX_CPUS; ++cpu)
+                if (CPU_ISSET(cpu, &cpus)) m_cpu[m_num_cpus++] = cpu;
+        }
+#endif
+
+        if (m_num_cpus == 0)
+            printf("WARNING in ThreadPinning(): Thread pinning is not supported on this system.\n");
+
+        observe(true);
+    }
+
+    ~ThreadPinning() { observe(false); }
+
+    void on_scheduler_entry(bool /*is_worker*/) override {
+
+#if defined(__linux__)
+        const int slot = tbb::this_task_arena::current_thread_index();
+
+        if (m_num_cpus == 0 || slot < 0) return;
+
+        cpu_set_t cpu;
+        CPU_ZERO(&cpu);
+        CPU_SET(m_cpu[slot % m_num_cpus], &cpu);
+
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu);
+#endif
+    }
+
+    // Returns the number of cores the threads are pinned to
+    int num_cpus() const { return m_num_cpus; }
+
+private:
+
+    static constexpr int MAX_CPUS = 1024;
+
+    // Cores the process may run on
+    int m_cpu[MAX_CPUS];
+    int m_num_cpus;
+};
+
+// Threading runtime of the lattices. All parallel loops of the lattices run in one task arena
+// with an explicit number of threads, which also caps the number of worker threads of the process
+// (e.g. of the task groups of the viewers), so that several jobs can share a node without
+// oversubscribing its cores. The runtime is set up by init(), or with the default number of
+// threads on the first parallel loop.
+class Threads {
+
+public:
+
+    // Sets up the runtime with the specified number of threads (0 for one thread per core the
+    // process may run on), pinning the threads to cores if requested. Must be called before the
+    // first parallel loop, later calls have no effect.
+    static void init(const int num_threads = 0, const bool pin = false) {
+
+        bool initialized = false;
+
+        std::call_once(state().init_flag, [&] {
+
+            setup(num_threads, pin);
+            initialized = true;
+        });
+
+        if (!initialized)
+            printf("WARNING in Threads::init(): The threading runtime has been set up already.\n");
+    }
+
+    // Returns the number of threads of the lattice loops
+    static int num_threads() { return arena().max_concurrency(); }
+
+    // Returns whether the threads are pinned to cores
+    static bool pinned() { arena(); return bool(state().pinning); }
+
+    // Loops over the range in parallel, calling body(subrange) for the subranges
+    template<typename Range, typename Body>
+    static void parallel_for(const Range& range, const Body& body) {
+
+        arena().execute([&] { tbb::parallel_for(range, body); });
+    }
+
+    // Loops over [begin, end) in parallel with a static partition, calling body(sub_begin,
+    // sub_end) for the subranges of the threads
+    template<typename Body>
+    static void static_parallel_for(const int begin, const int end, const Body& body) {
+
+        arena().execute([&] {
+
+            tbb::parallel_for(tbb::blocked_range<int>(begin, end, 1), [&](const tbb::blocked_range<int>& r) {
+
+                body(r.begin(), r.end());
+
+            }, tbb::static_partitioner());
+        });
+    }
+
+    // Reduces the range in parallel, with body(subrange, value) returning the value updated by
+    // the subrange and reduction(value, value) joining the values of two subranges
+    template<typename Range, typename Value, typename Body, typename Reduction>
+    static Value parallel_reduce(const Range& range, const Value& identity,
+                                 const Body& body, const Reduction& reduction) {
+
+        Value result = identity;
+
+        arena().execute([&] { result = tbb::parallel_reduce(range, identity, body, reduction); });
+
+        return result;
+    }
+
+private:
+
+    struct State {
+        std::once_flag                       init_flag;
+        tbb::task_arena                      arena;
+        std::unique_ptr<tbb::global_control> control;
+        std::unique_ptr<ThreadPinning>       pinning;
+    };
+
+    static State& state() {
+
+        static State state;
+        return state;
+    }
+
+    // Returns the arena of the lattice loops, setting up the runtime with the default number of
+    // threads if needed
+    static tbb::task_arena& arena() {
+
+        std::call_once(state().init_flag, [] { setup(0, false); });
+
+        return state().arena;
+    }
+
+    static void setup(int num_threads, const bool pin) {
+
+        State& s = state();
+
+        if (num_threads <= 0) num_threads = tbb::info::default_concurrency();
+
+        s.control.reset(new tbb::global_control(tbb::global_control::max_allowed_parallelism,
+                                                num_threads));
+        s.arena.initialize(num_threads);
+
+        if (pin) s.pinning.reset(new ThreadPinning(s.arena));
+    }
+};
+
+// Tuning of the parallel loops. The grain sizes of the loops (the minimum number of units of the
+// subranges handed to the threads) are picked from the size of the loop, the size of the caches
+// and the number of threads, while parameters of the kernels such as the tile sizes are measured on
+// the first runs of the kernels (see trial_value()). A tuning file holds one value per line
+// ("<name> <value>", lines starting with '#' are skipped), which overrides the picked or measured
+// value. The values of the file do not depend on the size of the lattice or the number of threads,
+// i.e. the grain size of a loop is given by the number of bytes its subranges stream, and is
+// limited such that every thread gets a subrange at least. save() writes the values set by a file
+// or measured, so that they can be adjusted for a machine and loaded by the following runs.
+class Tuning {
+
+public:
+
+    // Returns the size of the (per core) L2 cache
+    static size_t l2_cache_size() {
+
+        static const size_t size = [] {
+
+            long size = 0;
+#if defined(__linux__) && defined(_SC_LEVEL2_CACHE_SIZE)
+            size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+            return (size > 0) ? size_t(size) : DEFAULT_L2_CACHE_SIZE;
+        }();
+
+        return size;
+    }
+
+    // Returns the value of the specified name, or the specified default value if it has not been
+    // set
+    static size_t value(const string& name, const size_t default_value) {
+
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        const auto value = s.set_values.find(name);
+
+        return (value != s.set_values.end()) ? value->second : default_value;
+    }
+
+    // Sets the value of the specified name (which must not be zero)
+    static void set_value(const string& name, const size_t value) {
+
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        s.set_values[name] = value;
+    }
+
+    // Returns the grain size of the loop of the specified name over num_units units, each of which
+    // streams about bytes_per_unit bytes. The subranges stream at least MIN_RANGE_BYTES bytes (or
+    // the number of bytes set for the loop), so that the overhead of scheduling them is small, and
+    // at most half of the L2 cache, while the threads get RANGES_PER_THREAD subranges each (if the
+    // loop is large enough) for balancing the load. Loops of one thread are not split at all, and
+    // loops of several threads are split into one subrange per thread at least.
+    static size_t grain_size(const string& name, const size_t num_units, const size_t bytes_per_unit) {
+
+        const size_t num_threads = Threads::num_threads();
+        const size_t unit_bytes  = std::max(size_t(1), bytes_per_unit);
+
+        if (num_threads == 1) return std::max(size_t(1), num_units);
+
+        const size_t max_grain = std::max(size_t(1), (num_units + num_threads - 1) / num_threads);
+
+        const size_t range_bytes = value(name, 0);
+
+        if (range_bytes > 0) return std::min(std::max(size_t(1), range_bytes / unit_bytes), max_grain);
+
+        const size_t min_grain = std::max(size_t(1), MIN_RANGE_BYTES / unit_bytes);
+        const size_t l2_grain  = std::max(min_grain, l2_cache_size() / 2 / unit_bytes);
+
+        const size_t grain = num_units / (RANGES_PER_THREAD * num_threads);
+
+        return std::min(std::min(std::max(grain, min_grain), l2_grain), max_grain);
+    }
+
+    // Returns the value of the specified name to run the code it tunes with next. Unless the value
+    // has been set, the specified candidates are tried in turn, and once every candidate has been
+    // timed NUM_TRIALS times (see record()), the fastest one is set as the value. The candidates
+    // must give the same results, since the code runs with all of them.
+    static size_t trial_value(const string& name, const std::vector<size_t>& candidates) {
+
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        const auto value = s.set_values.find(name);
+
+        if (value != s.set_values.end()) return value->second;
+
+        Trials& trials = s.trials[name];
+
+        if (trials.times.empty()) trials.times.assign(candidates.size(), 0.0);
+
+        return candidates[trials.next % candidates.size()];
+    }
+
+    // Records the time per unit of work (e.g. per cell and step) the code tuned by the value of the
+    // specified name took with the specified candidate value (see trial_value())
+    static void record(const string& name, const std::vector<size_t>& candidates,
+                       const size_t candidate, const double time) {
+
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        const auto trials = s.trials.find(name);
+
+        if (trials == s.trials.end() || s.set_values.count(name)) return;
+
+        Trials& t = trials->second;
+
+        const size_t index = t.next % candidates.size();
+
+        if (candidates[index] != candidate) return;
+
+        t.times[index] += time;
+
+        if (++t.next < NUM_TRIALS * candidates.size()) return;
+
+        const size_t best = std::min_element(t.times.begin(), t.times.end()) - t.times.begin();
+
+        s.set_values[name] = candidates[best];
+        s.trials.erase(trials);
+    }
+
+    // Loads the values of a tuning file. Returns false if the file cannot be read.
+    static bool load(const string& file_name) {
+
+        std::ifstream file(file_name);
+
+        if (!file) return false;
+
+        string line;
+
+        while (std::getline(file, line)) {
+
+            if (line.empty() || line[0] == '#') continue;
+
+            char name[256];
+            unsigned long long value;
+
+            if (sscanf(line.c_str(), "%255s %llu", name, &value) == 2 && value > 0) set_value(name, value);
+            else printf("WARNING in Tuning::load(): Skipping invalid line \"%s\".\n", line.c_str());
+        }
+
+        return true;
+    }
+
+    // Writes the values set by a tuning file or set_value() and the values measured so far to a
+    // tuning file. Returns false if the file cannot be written.
+    static bool save(const string& file_name) {
+
+        std::ofstream file(file_name);
+
+        if (!file) return false;
+
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        file << "# Bytes of the subranges of the parallel loops and parameters of the kernels (measured with "
+             << Threads::num_threads() << " threads, " << l2_cache_size() / 1024 << " KiB L2 cache)\n";
+
+        for (const auto& value : s.set_values) file << value.first << " " << value.second << "\n";
+
+        return bool(file);
+    }
+
+private:
+
+    static constexpr size_t DEFAULT_L2_CACHE_SIZE = 256 * 1024;
+    static constexpr size_t MIN_RANGE_BYTES       =  32 * 1024;
+    static constexpr size_t RANGES_PER_THREAD     = 4;
+    static constexpr size_t NUM_TRIALS            = 2;
+
+    // Times the candidates of a value have been run for so far
+    struct Trials {
+        std::vector<double> times; // Sum of the times of every candidate
+        size_t              next = 0;
+    };
+
+    struct State {
+        std::mutex               mutex;
+        std::map<string, size_t> set_values; // Values set by a tuning file, set_value() or measured
+        std::map<string, Trials> trials;     // Values being measured
+    };
+
+    static State& state() {
+
+        static State state;
+        return state;
+    }
+};
+
+// Partition of work units [0, num_units) (e.g. the rows of the lattice) into one contiguous range
+// of units per thread, which is balanced by the measured cost of the units. The time taken by the
+// ranges is measured on every run, and every rebalance_interval runs the ranges are moved such
+// that the cost of the units (estimated from the time of their ranges) is split evenly among the
+// threads. The ranges start with a multiple of the granularity of the units (except for empty
+// lattices), and are handed to the threads by a static partition, i.e. a range is processed by the
+// same thread slot on every run.
+class BalancedPartition {
+
+public:
+
+    BalancedPartition() : m_granularity(1), m_rebalance_interval(0), m_num_runs(0) {}
+
+    // Splits the units evenly into (at most) the specified number of ranges, which are
+    // rebalanced every rebalance_interval runs (never if 0)
+    void init(const int num_units, const int num_parts, const int granularity,
+              const int rebalance_interval) {
+
+        const int num_groups = (num_units + granularity - 1) / granularity;
+
+        m_granularity        = granularity;
+        m_rebalance_interval = rebalance_interval;
+        m_num_runs           = 0;
+
+        m_begin.resize(std::max(1, std::min(num_parts, num_groups)) + 1);
+
+        for (size_t part = 0; part < m_begin.size(); ++part)
+            m_begin[part] = std::min(num_units, int(num_groups * part / (m_begin.size() - 1)) * granularity);
+
+        m_time.assign(this->num_parts(), 0.0);
+        m_unit_cost.assign(num_units, 0.0);
+    }
+
+    // Returns the number of ranges and the units [begin(part), end(part)) of a range
+    int num_parts()             const { return int(m_begin.size()) - 1; }
+    int begin(const int part)   const { return m_begin[part];           }
+    int end  (const int part)   const { return m_begin[part + 1];       }
+
+    // Runs body(part, unit_begin, unit_end) for the ranges in parallel and measures their time
+    template<typename Body>
+    void run(const Body& body) {
+
+        Threads::static_parallel_for(0, num_parts(), [&](const int part_begin, const int part_end) {
+
+            for (int part = part_begin; part != part_end; ++part) {
+
+                const auto start = std::chrono::steady_clock::now();
+
+                body(part, begin(part), end(part));
+
+                m_time[part] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        });
+
+        if (m_rebalance_interval > 0 && ++m_num_runs % m_rebalance_interval == 0) rebalance();
+    }
+
+private:
+
+    // Moves the ranges such that the estimated cost of their units is equal
+    void rebalance() {
+
+        const int num_units  = m_begin.back();
+        const int num_groups = (num_units + m_granularity - 1) / m_granularity;
+
+        // Estimate the cost of the units from the time of their ranges. The estimates are averaged
+        // with the ones of the previous rebalancing, since the time of a range only tells the mean
+        // cost of its units, which keeps the ranges from oscillating.
+        const bool first = (m_num_runs == m_rebalance_interval);
+
+        double total_cost = 0.0;
+
+        for (int part = 0; part < num_parts(); ++part) {
+
+            const double unit_cost = m_time[part] / std::max(1, end(part) - begin(part));
+
+            for (int unit = begin(part); unit != end(part); ++unit) {
+
+                m_unit_cost[unit] = first ? unit_cost : 0.5 * (m_unit_cost[unit] + unit_cost);
+                total_cost += m_unit_cost[unit];
+            }
+
+            m_time[part] = 0.0;
+        }
+
+        if (total_cost <= 0.0) return;
+
+        // Cut the units where the summed up cost reaches the shares of the ranges, keeping at
+        // least one group of units per range
+        double cost = 0.0;
+        int    unit = 0;
+
+        for (int part = 1; part < num_parts(); ++part) {
+
+            const double share = total_cost * part / num_parts();
+
+            while (unit < num_units && cost + 0.5 * m_unit_cost[unit] < share) cost += m_unit_cost[unit++];
+
+            int cut = (unit + m_granularity / 2) / m_granularity * m_granularity;
+
+            cut = std::max(cut, m_begin[part - 1] + m_granularity);
+            cut = std::min(cut, (num_groups - num_parts() + part) * m_granularity);
+
+            m_begin[part] = cut;
+        }
+    }
+
+    // First unit of every range, followed by the number of units
+    std::vector<int> m_begin;
+
+    // Time taken by the ranges since the last rebalancing, and estimated cost of the units
+    std::vector<double> m_time;
+    std::vector<double> m_unit_cost;
+
+    int m_granularity;
+    int m_rebalance_interval;
+    int m_num_runs;
+};
+
+} // namespace lgca
+
+#endif /* LGCA_PARALLEL_H_ */
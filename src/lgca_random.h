@@ -0,0 +1,91 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_RANDOM_H_
+#define LGCA_RANDOM_H_
+
+#include "lgca_common.h"
+
+#include <cstdint>
+
+namespace lgca {
+
+// Counter-based random number generator Threefry-2x64 with 13 rounds (J. K. Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3", SC'11). A random word is a pure function of the
+// key and a counter, so the random bits for collision are generated inline by the step kernels
+// instead of being stored, and they are independent of the order in which the words are processed.
+//
+// The counter consists of the index of the word of 64 cells within the lattice (words are aligned
+// with the rows) and the index of the time step. Only additions, rotations and exclusive ors are
+// used, so that the generator works on vectors of words as well.
+class CounterRng {
+
+    // Key schedule
+    uint64_t m_key[3];
+
+public:
+
+    static constexpr uint64_t DEFAULT_SEED = 0x853C49E6748FEA9Bull;
+
+    explicit CounterRng(const uint64_t seed = DEFAULT_SEED) { set_seed(seed); }
+
+    void set_seed(const uint64_t seed) {
+
+        m_key[0] = seed;
+        m_key[1] = 0x9E3779B97F4A7C15ull;
+        m_key[2] = 0x1BD11BDAA9FC1A22ull ^ m_key[0] ^ m_key[1];
+    }
+
+    // Generates the random word(s) for the specified word index(es) and step. The result is passed
+    // by reference, so that vectors of words do not depend on the calling convention of the
+    // instruction set extensions.
+    template<typename Word>
+    LGCA_FORCE_INLINE void bits(const Word& word, const uint64_t step, Word& rnd) const {
+
+        // Rotation constants of Threefry-2x64
+        constexpr unsigned int ROTATION[8] = { 16, 42, 12, 31, 16, 32, 24, 21 };
+
+        // The step is broadcast to all words
+        Word x0 =           word + m_key[0];
+        Word x1 = (word ^ word) + (step + m_key[1]);
+
+#pragma unroll
+        for (unsigned int round = 0; round < 13; ++round) {
+
+            x0 += x1;
+            x1  = (x1 << ROTATION[round % 8]) | (x1 >> (64 - ROTATION[round % 8]));
+            x1 ^= x0;
+
+            // Inject the key after every fourth round
+            if (round % 4 == 3) {
+
+                const unsigned int s = round / 4 + 1;
+
+                x0 += m_key[s % 3];
+                x1 += m_key[(s + 1) % 3] + s;
+            }
+        }
+
+        rnd = x0;
+    }
+};
+
+} // namespace lgca
+
+#endif /* LGCA_RANDOM_H_ */
@@ -0,0 +1,397 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_RULES_H_
+#define LGCA_RULES_H_
+
+#include "lgca_common.h"
+
+#include <cstddef>
+#include <utility>
+
+namespace lgca {
+
+// Collision rule of a lattice gas model. The node states of a fluid cell matching the input
+// configuration are replaced by the output configuration selected by the random bit for collision
+// (chirality). Bit dir of a configuration holds the node state in direction dir.
+struct CollisionRule {
+    unsigned char in;
+    unsigned char out[2];
+};
+
+// Returns the configuration with particles in the specified directions
+constexpr unsigned char config() { return 0; }
+
+template<typename... Dirs>
+constexpr unsigned char config(const int dir, const Dirs... dirs) {
+
+    return (1 << dir) | config(dirs...);
+}
+
+// Collision table of the fluid cells of a lattice gas model, expanded from the collision rules of
+// the model descriptor Desc. The descriptor lists one representative of every class of collisions,
+// the table holds the representatives rotated through all lattice directions (ROT_DIR). Node
+// states not matched by any rule are kept.
+template<typename Desc>
+struct RuleTable {
+
+    static constexpr unsigned int NUM_STATES = 1 << Desc::NUM_DIR;
+
+    // Node states after the collision step in [random bit][node states before]
+    unsigned char entry[2][NUM_STATES];
+
+    // Whether no two (rotated) rules map the same input configuration to different outputs
+    bool consistent;
+};
+
+// Rotates the specified configuration by one lattice direction
+template<typename Desc>
+constexpr unsigned char rotate_configuration(const unsigned char config) {
+
+    unsigned char result = 0;
+
+    for (unsigned int dir = 0; dir < Desc::NUM_DIR; ++dir)
+        result |= ((config >> dir) & 1) << Desc::ROT_DIR[dir];
+
+    return result;
+}
+
+// Expands the collision rules of the model descriptor to the collision table at compile time
+template<typename Desc>
+constexpr RuleTable<Desc> expand_collision_rules() {
+
+    RuleTable<Desc> table = { };
+
+    bool matched[RuleTable<Desc>::NUM_STATES] = { };
+
+    for (unsigned int state = 0; state < RuleTable<Desc>::NUM_STATES; ++state) {
+
+        table.entry[0][state] = state;
+        table.entry[1][state] = state;
+    }
+
+    table.consistent = true;
+
+    for (unsigned int rule = 0; rule < Desc::NUM_RULES; ++rule) {
+
+        unsigned char in     = Desc::COLLISION_RULES[rule].in;
+        unsigned char out[2] = { Desc::COLLISION_RULES[rule].out[0], Desc::COLLISION_RULES[rule].out[1] };
+
+        // Apply the rotations of the rule until it maps onto itself
+        do {
+            for (unsigned int p = 0; p < 2; ++p) {
+
+                if (matched[in] && table.entry[p][in] != out[p]) table.consistent = false;
+
+                table.entry[p][in] = out[p];
+            }
+
+            matched[in] = true;
+
+            in     = rotate_configuration<Desc>(in);
+            out[0] = rotate_configuration<Desc>(out[0]);
+            out[1] = rotate_configuration<Desc>(out[1]);
+
+        } while (in     != Desc::COLLISION_RULES[rule].in     ||
+                 out[0] != Desc::COLLISION_RULES[rule].out[0] ||
+                 out[1] != Desc::COLLISION_RULES[rule].out[1]);
+    }
+
+    return table;
+}
+
+// Returns whether the specified configurations hold the same number of particles
+template<typename Desc>
+constexpr bool conserves_mass(const unsigned int config_a, const unsigned int config_b) {
+
+    int mass = 0;
+
+    for (unsigned int dir = 0; dir < Desc::NUM_DIR; ++dir)
+        mass += int((config_a >> dir) & 1) - int((config_b >> dir) & 1);
+
+    return mass == 0;
+}
+
+// Returns whether the specified configurations carry the same momentum
+template<typename Desc>
+constexpr bool conserves_momentum(const unsigned int config_a, const unsigned int config_b) {
+
+    Real momentum_x = 0.0;
+    Real momentum_y = 0.0;
+
+    for (unsigned int dir = 0; dir < Desc::NUM_DIR; ++dir) {
+
+        const int diff = int((config_a >> dir) & 1) - int((config_b >> dir) & 1);
+
+        momentum_x += diff * Desc::LATTICE_VEC_X[dir];
+        momentum_y += diff * Desc::LATTICE_VEC_Y[dir];
+    }
+
+    return (momentum_x < 1.0e-4 && momentum_x > -1.0e-4)
+        && (momentum_y < 1.0e-4 && momentum_y > -1.0e-4);
+}
+
+// Returns whether all collisions of the collision table conserve mass and momentum
+template<typename Desc>
+constexpr bool conserves_mass_and_momentum(const RuleTable<Desc>& table) {
+
+    for (unsigned int p = 0; p < 2; ++p) {
+        for (unsigned int state = 0; state < RuleTable<Desc>::NUM_STATES; ++state) {
+
+            if (!conserves_mass    <Desc>(state, table.entry[p][state]) ||
+                !conserves_momentum<Desc>(state, table.entry[p][state])) return false;
+        }
+    }
+
+    return true;
+}
+
+// Product term of a boolean function of the node states, which matches the configurations
+// agreeing with value in the directions set in mask
+struct Cube {
+    unsigned char mask;
+    unsigned char value;
+};
+
+// Boolean network evaluating the collision table of a lattice gas model on bit planes (one cell
+// per bit of a word), compiled from the collision rules at compile time.
+//
+// The change of the node state in direction dir (node state after the collision step xor before)
+// is split into the configurations changing it for both values of the random bit, for the random
+// bit set and for the random bit cleared. Each of these sets is covered by prime implicants, i.e.
+// cubes which cannot be enlarged without matching configurations outside of the set, by
+// expanding its configurations one after the other. The cubes are shared by all directions, so
+// that the network consists of one AND term per cube (the detectors of the collisions) and one OR
+// per direction.
+template<typename Desc>
+class CollisionNetwork {
+
+public:
+
+    static constexpr unsigned int NUM_DIR    = Desc::NUM_DIR;
+    static constexpr unsigned int NUM_STATES = 1 << NUM_DIR;
+
+    // Classes of the cubes with respect to a direction: the cube does not change the node state
+    // in the direction, or it changes the node state always, if the random bit is set (chiral) or
+    // if the random bit is cleared (anti-chiral)
+    enum Term : unsigned char {
+        NONE,
+        ALWAYS,
+        CHIRAL,
+        ANTI_CHIRAL
+    };
+
+    struct Network {
+        Cube          cube[NUM_STATES];
+        unsigned int  num_cubes;
+        unsigned char term[NUM_DIR][NUM_STATES];  // Class of the cubes in [dir][cube]
+    };
+
+    static constexpr RuleTable<Desc> TABLE = expand_collision_rules<Desc>();
+
+    static_assert(TABLE.consistent,
+                  "The collision rules map an input configuration to different outputs.");
+    static_assert(conserves_mass_and_momentum<Desc>(TABLE),
+                  "The collision rules do not conserve mass and momentum.");
+
+private:
+
+    // Returns the class of the specified configuration with respect to direction dir
+    static constexpr Term term(const unsigned int dir, const unsigned int state) {
+
+        const bool change_0 = ((TABLE.entry[0][state] ^ state) >> dir) & 1;
+        const bool change_1 = ((TABLE.entry[1][state] ^ state) >> dir) & 1;
+
+        return (change_0 && change_1) ? ALWAYS
+             : (change_1)             ? CHIRAL
+             : (change_0)             ? ANTI_CHIRAL
+             :                          NONE;
+    }
+
+    // Returns whether all configurations matched by the cube are of the specified class
+    static constexpr bool implies(const Cube cube, const unsigned int dir, const Term term_class) {
+
+        for (unsigned int state = 0; state < NUM_STATES; ++state)
+            if ((state & cube.mask) == cube.value && term(dir, state) != term_class) return false;
+
+        return true;
+    }
+
+    static constexpr Network compile() {
+
+        Network network = { };
+
+        for (unsigned int dir = 0; dir < NUM_DIR; ++dir) {
+            for (const Term term_class : { ALWAYS, CHIRAL, ANTI_CHIRAL }) {
+
+                bool covered[NUM_STATES] = { };
+
+                for (unsigned int state = 0; state < NUM_STATES; ++state) {
+
+                    if (term(dir, state) != term_class || covered[state]) continue;
+
+                    // Reuse a cube of the other directions matching the configuration, or expand the
+                    // configuration to a prime implicant
+                    unsigned int index = 0;
+
+                    while (index < network.num_cubes &&
+                           !((state & network.cube[index].mask) == network.cube[index].value &&
+                             implies(network.cube[index], dir, term_class))) ++index;
+
+                    if (index == network.num_cubes) {
+
+                        Cube cube = { (unsigned char)(NUM_STATES - 1), (unsigned char) state };
+
+                        for (unsigned int var = 0; var < NUM_DIR; ++var) {
+
+                            const Cube expanded = { (unsigned char)(cube.mask  & ~(1u << var)),
+                                                    (unsigned char)(cube.value & ~(1u << var)) };
+
+                            if (implies(expanded, dir, term_class)) cube = expanded;
+                        }
+
+                        network.cube[network.num_cubes++] = cube;
+                    }
+
+                    const Cube cube = network.cube[index];
+
+                    for (unsigned int other = 0; other < NUM_STATES; ++other)
+                        if ((other & cube.mask) == cube.value) covered[other] = true;
+
+                    network.term[dir][index] = term_class;
+                }
+            }
+        }
+
+        return network;
+    }
+
+public:
+
+    static constexpr Network NETWORK = compile();
+
+private:
+
+    // Multiplies the literal of the specified direction into the AND term of the node states of a
+    // cube, which is split into the node states to be set and the ones to be cleared
+    template<unsigned int C, unsigned int DIR, typename Word>
+    static LGCA_FORCE_INLINE void multiply(const Word* node_state, Word& set, Word& cleared) {
+
+        constexpr Cube cube = NETWORK.cube[C];
+
+        constexpr unsigned int first_set     = __builtin_ctz( cube.value              | NUM_STATES);
+        constexpr unsigned int first_cleared = __builtin_ctz((cube.mask & ~cube.value) | NUM_STATES);
+
+        if (!((cube.mask >> DIR) & 1) || DIR == first_set || DIR == first_cleared) return;
+
+        if ((cube.value >> DIR) & 1) set     = set     & node_state[DIR];
+        else                         cleared = cleared | node_state[DIR];
+    }
+
+    // Evaluates the AND term of cube C
+    template<unsigned int C, typename Word, size_t... DIR>
+    static LGCA_FORCE_INLINE void detect(const Word* node_state, Word* detector, std::index_sequence<DIR...>) {
+
+        constexpr Cube cube = NETWORK.cube[C];
+
+        constexpr unsigned int first_set     = __builtin_ctz( cube.value              | NUM_STATES);
+        constexpr unsigned int first_cleared = __builtin_ctz((cube.mask & ~cube.value) | NUM_STATES);
+
+        static_assert(first_set < NUM_DIR && first_cleared < NUM_DIR,
+                      "Cubes of conserving collisions match particles and holes.");
+
+        Word set     = node_state[first_set];
+        Word cleared = node_state[first_cleared];
+
+        const int sequence[] = { 0, (multiply<C, DIR>(node_state, set, cleared), 0)... };
+
+        (void) sequence;
+
+        detector[C] = set & ~cleared;
+    }
+
+    // Adds the AND term of cube C to the OR of its class with respect to direction DIR
+    template<unsigned int DIR, unsigned int C, typename Word>
+    static LGCA_FORCE_INLINE void add(const Word* detector, Word& always, Word& chiral, Word& anti_chiral) {
+
+        constexpr Term term_class = Term(NETWORK.term[DIR][C]);
+
+        if (term_class == ALWAYS)      always      = always      | detector[C];
+        if (term_class == CHIRAL)      chiral      = chiral      | detector[C];
+        if (term_class == ANTI_CHIRAL) anti_chiral = anti_chiral | detector[C];
+    }
+
+    // Evaluates the node state in direction DIR after the collision step
+    template<unsigned int DIR, typename Word, size_t... C>
+    static LGCA_FORCE_INLINE void collide_dir(const Word* node_state_in, Word* node_state_out, const Word& p,
+                                              const Word* detector, std::index_sequence<C...>) {
+
+        const Word zero = node_state_in[DIR] ^ node_state_in[DIR];
+
+        Word always = zero, chiral = zero, anti_chiral = zero;
+
+        const int sequence[] = { 0, (add<DIR, C>(detector, always, chiral, anti_chiral), 0)... };
+
+        (void) sequence;
+
+        node_state_out[DIR] = node_state_in[DIR] ^ (always | (p & chiral) | (~p & anti_chiral));
+    }
+
+    template<typename Word, size_t... C>
+    static LGCA_FORCE_INLINE void detect_all(const Word* node_state, Word* detector, std::index_sequence<C...>) {
+
+        // The elements of a braced initializer list are evaluated in order
+        const int sequence[] = { 0, (detect<C>(node_state, detector, std::make_index_sequence<NUM_DIR>()), 0)... };
+
+        (void) sequence;
+    }
+
+    template<typename Word, size_t... DIR>
+    static LGCA_FORCE_INLINE void collide_all(const Word* node_state_in, Word* node_state_out, const Word& p,
+                                              const Word* detector, std::index_sequence<DIR...>) {
+
+        const int sequence[] = { 0, (collide_dir<DIR>(node_state_in, node_state_out, p, detector,
+                                                       std::make_index_sequence<NETWORK.num_cubes>()), 0)... };
+
+        (void) sequence;
+    }
+
+public:
+
+    // Evaluates the collision table on the node states of the cells of the words, given the
+    // random bits for collision
+    template<typename Word>
+    static LGCA_FORCE_INLINE void collide(const Word* node_state_in, Word* node_state_out, const Word& p)
+    {
+        Word detector[NETWORK.num_cubes];
+
+        detect_all (node_state_in, detector, std::make_index_sequence<NETWORK.num_cubes>());
+        collide_all(node_state_in, node_state_out, p, detector, std::make_index_sequence<NUM_DIR>());
+    }
+};
+
+template<typename Desc>
+constexpr RuleTable<Desc> CollisionNetwork<Desc>::TABLE;
+
+template<typename Desc>
+constexpr typename CollisionNetwork<Desc>::Network CollisionNetwork<Desc>::NETWORK;
+
+} // namespace lgca
+
+#endif /* LGCA_RULES_H_ */
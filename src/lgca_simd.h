@@ -0,0 +1,89 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_SIMD_H_
+#define LGCA_SIMD_H_
+
+#include "lgca_common.h"
+
+#include <cstdint>
+
+namespace lgca {
+
+// Instruction set extensions the bit-sliced kernels are compiled for
+enum class SimdIsa {
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+static inline const char* simd_isa_name(const SimdIsa isa) {
+
+    switch (isa) {
+    case SimdIsa::SCALAR: return "scalar";
+    case SimdIsa::AVX2:   return "AVX2";
+    case SimdIsa::AVX512: return "AVX-512";
+    }
+
+    return "unknown";
+}
+
+// On x86 the wide kernels are compiled for their instruction set by means of function target
+// attributes, while the rest of the code is built for the baseline architecture. The kernel to use
+// is chosen at run time, so that the same binary runs on hosts with and without AVX-512.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define LGCA_SIMD_DISPATCH 1
+
+// If the code is built for a host supporting the extensions already (e.g. with -march=native),
+// no target attributes are needed
+#if defined(__AVX512F__)
+#define LGCA_TARGET_AVX2
+#define LGCA_TARGET_AVX512
+#elif defined(__AVX2__)
+#define LGCA_TARGET_AVX2
+#define LGCA_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define LGCA_TARGET_AVX2   __attribute__((target("avx2")))
+#define LGCA_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+// Vectors of 4 and 8 words holding the node states of 256 and 512 consecutive cells
+typedef uint64_t Word256 __attribute__((vector_size(32)));
+typedef uint64_t Word512 __attribute__((vector_size(64)));
+
+#endif
+
+// Returns the widest instruction set extension supported by the CPU (queried via CPUID) and the
+// operating system.
+static inline SimdIsa detect_simd_isa() {
+
+#ifdef LGCA_SIMD_DISPATCH
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) return SimdIsa::AVX512;
+    if (__builtin_cpu_supports("avx2"))    return SimdIsa::AVX2;
+#endif
+
+    return SimdIsa::SCALAR;
+}
+
+} // namespace lgca
+
+#endif /* LGCA_SIMD_H_ */
@@ -0,0 +1,630 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lgca_common.h"
+
+#include "mpi_lattice.h"
+#include "lgca_parallel.h"
+
+#include <tbb/blocked_range.h>
+
+#include <algorithm>
+#include <cstring> // memcpy, memset
+#include <functional>
+
+namespace lgca {
+
+// Tags of the messages of the halo exchange, i.e. of the rows sent to the slabs below and above
+static constexpr int TAG_ROW_DOWN = 1;
+static constexpr int TAG_ROW_UP   = 2;
+
+// Creates a distributed lattice gas cellular automaton object of the specified properties.
+template<Model model_>
+MPI_Lattice<model_>::MPI_Lattice(const string test_case,
+                                 const Real Re, const Real Ma_s,
+                                 const int coarse_graining_radius,
+                                 MPI_Comm comm)
+               : Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius),
+                 m_comm(comm),
+                 m_halo_dim_x(this->m_dim_x + 2),
+                 m_slab_lut_row(NULL),
+                 m_slab_fluid_mask(NULL),
+                 m_num_fluid_cells(0),
+                 m_reverted_particles(0),
+                 m_pull(this->m_dim_x, this->m_dim_y),
+                 m_step(0),
+                 m_slab_valid(false),
+                 m_slab_cells_valid(false) {
+
+    MPI_Comm_rank(m_comm, &m_rank);
+    MPI_Comm_size(m_comm, &m_num_ranks);
+
+    if (m_num_ranks > int(this->m_dim_y)) {
+
+        printf("ERROR in MPI_Lattice::MPI_Lattice(): More ranks (%d) than rows of the lattice (%d).\n",
+               m_num_ranks, this->m_dim_y);
+        abort();
+    }
+
+    // Split the rows evenly among the ranks. The rows of the slabs keep their global index value,
+    // i.e. the shifts of the rows with even and odd index value do not depend on the split.
+    m_y_begin = int(size_t(this->m_dim_y) *  m_rank      / m_num_ranks);
+    m_y_end   = int(size_t(this->m_dim_y) * (m_rank + 1) / m_num_ranks);
+
+    m_rank_below = (m_rank + m_num_ranks - 1) % m_num_ranks;
+    m_rank_above = (m_rank               + 1) % m_num_ranks;
+
+    // The rank holds the cell types and the staged node states of the rows of its slab and of one
+    // halo row on each side
+    this->m_staged_y_begin = std::max(m_y_begin - 1, 0);
+    this->m_staged_y_end   = std::min(m_y_end   + 1, int(this->m_dim_y));
+
+    m_num_rnd_words_x = (this->m_dim_x - 1) / BITS_PER_RND_WORD + 1;
+
+    // Allocate the memory for the arrays on the host (CPU)
+    allocate_memory();
+}
+
+// Deletes the distributed lattice gas cellular automaton object.
+template<Model model_>
+MPI_Lattice<model_>::~MPI_Lattice() {
+
+    this->free_memory();
+}
+
+// Performs the collision and propagation step on the lattice gas automaton. The first and the
+// last row of the slab are sent to the neighbor slabs while the interior rows are stepped, which
+// do not depend on the ghost rows.
+template<Model model_>
+void MPI_Lattice<model_>::collide_and_propagate(const bool p) {
+
+    if (!m_slab_valid) pack();
+    if (!m_slab_cells_valid) setup_slab_cells();
+
+    const int    rows     = num_rows();
+    const size_t row_size = m_halo_dim_x;
+
+    // Every cell of a row reads its lookup table row and the node states of its neighbors and
+    // writes its node states
+    const int grain = Tuning::grain_size("mpi.collide_and_propagate", rows, 3 * row_size);
+
+    // Apply the periodic boundary conditions of the propagation step in x direction, so that the
+    // rows sent to the neighbor slabs include their ghost cells
+    update_ghost_columns();
+
+    // Exchange the rows next to the slab with the neighbor slabs (including the ghost cells)
+    MPI_Request request[4];
+
+    MPI_Irecv(slab_row(m_slab_state.front(), -1)   - 1, row_size, MPI_UNSIGNED_CHAR, m_rank_below, TAG_ROW_UP,   m_comm, &request[0]);
+    MPI_Irecv(slab_row(m_slab_state.front(), rows) - 1, row_size, MPI_UNSIGNED_CHAR, m_rank_above, TAG_ROW_DOWN, m_comm, &request[1]);
+    MPI_Isend(slab_row(m_slab_state.front(), 0)        - 1, row_size, MPI_UNSIGNED_CHAR, m_rank_below, TAG_ROW_DOWN, m_comm, &request[2]);
+    MPI_Isend(slab_row(m_slab_state.front(), rows - 1) - 1, row_size, MPI_UNSIGNED_CHAR, m_rank_above, TAG_ROW_UP,   m_comm, &request[3]);
+
+    // Step the interior rows of the slab
+    Threads::parallel_for(tbb::blocked_range<int>(1, std::max(1, rows - 1), grain), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
+    {
+        step_row(y);
+    }});
+
+    MPI_Waitall(4, request, MPI_STATUSES_IGNORE);
+
+    // Step the first and the last row of the slab
+                  step_row(0);
+    if (rows > 1) step_row(rows - 1);
+
+    // Update the node states
+    m_slab_state.swap();
+
+    ++m_step;
+}
+
+// Performs the collision and propagation step on the row of the slab with the specified index,
+// pulling the node states from the rows next to it and looking up the new node states of the
+// cells in the collision lookup table.
+template<Model model_>
+LGCA_FORCE_INLINE void MPI_Lattice<model_>::step_row(const int y) {
+
+    const int dim_x    = this->m_dim_x;
+    const int y_global = m_y_begin + y;
+
+    const unsigned char* lut_row = m_slab_lut_row + size_t(y) * dim_x;
+
+    unsigned char* node_state_out = slab_row(m_slab_state.back(), y);
+
+    // The rows pulled from are fixed for all cells of the row
+    const unsigned char* pull_row[this->NUM_DIR];
+
+#pragma unroll
+    for (int dir = 0; dir < this->NUM_DIR; ++dir)
+        pull_row[dir] = slab_row(m_slab_state.front(), y + m_pull.dy[y_global % 2][dir]) + m_pull.dx[y_global % 2][dir];
+
+    for (size_t w = 0; w < m_num_rnd_words_x; ++w) {
+
+        const int x_begin = w * BITS_PER_RND_WORD;
+        const int x_end   = std::min(dim_x, x_begin + int(BITS_PER_RND_WORD));
+
+        // Random bits for collision of the cells of the word, indexed like the ones of the
+        // shared-memory lattices
+        RndWord rnd;
+        m_rng.bits(RndWord(size_t(y_global) * m_num_rnd_words_x + w), m_step, rnd);
+
+        for (int x = x_begin; x < x_end; ++x) {
+
+            unsigned int pulled_state = 0;
+
+#pragma unroll
+            for (int dir = 0; dir < this->NUM_DIR; ++dir)
+                pulled_state |= pull_row[dir][x] & (1u << dir);
+
+            node_state_out[x] = CollisionLUT<model_>::lookup(lut_row[x], (rnd >> (x - x_begin)) & 1, pulled_state);
+        }
+
+        // Apply the body force to the fluid cells (fused forcing)
+        if (m_fused_forcing.enabled())
+            m_fused_forcing.apply_cells(m_rng, RndWord(size_t(y_global) * m_num_rnd_words_x + w), m_step,
+                                        node_state_out + x_begin, m_slab_fluid_mask[size_t(y) * m_num_rnd_words_x + w]);
+    }
+}
+
+// Copies the cells on the western and eastern boundary of the rows of the slab to the ghost cells
+// on the opposite side, so that the propagation step wraps around periodically.
+template<Model model_>
+void MPI_Lattice<model_>::update_ghost_columns() {
+
+    const int dim_x = this->m_dim_x;
+
+    for (int y = 0; y < num_rows(); ++y) {
+
+        unsigned char* row = slab_row(m_slab_state.front(), y) - 1;
+
+        row[0]         = row[dim_x];
+        row[dim_x + 1] = row[1];
+    }
+}
+
+// Packs the staged node states into the slab, i.e. the rows of the slab and the halo rows into the
+// ghost rows next to it. The staged node states are released afterwards.
+template<Model model_>
+void MPI_Lattice<model_>::pack() {
+
+    const int dim_x = this->m_dim_x;
+
+    Threads::parallel_for(tbb::blocked_range<int>(this->m_staged_y_begin, this->m_staged_y_end), [&](const tbb::blocked_range<int>& r) {
+    for (int y_global = r.begin(); y_global != r.end(); ++y_global)
+    {
+        unsigned char* row    = slab_row(m_slab_state.front(), y_global - m_y_begin);
+        const size_t   staged = size_t(y_global - this->m_staged_y_begin) * dim_x;
+
+        // The node states of a cell are held by one block of the bitset
+        for (int x = 0; x < dim_x; ++x) row[x] = this->m_node_state_cpu(staged + x);
+    }});
+
+    this->m_node_state_cpu.resize(0);
+
+    m_slab_valid = true;
+}
+
+// Sets up the lookup table rows and the fluid masks of the cells of the slab from the cell types.
+template<Model model_>
+void MPI_Lattice<model_>::setup_slab_cells() {
+
+    const int dim_x = this->m_dim_x;
+    const int dim_y = this->m_dim_y;
+
+    Threads::parallel_for(tbb::blocked_range<int>(0, num_rows()), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
+    {
+        const int y_global = m_y_begin + y;
+
+        RndWord* fluid_mask = m_slab_fluid_mask + size_t(y) * m_num_rnd_words_x;
+
+        memset(fluid_mask, 0, m_num_rnd_words_x * sizeof(RndWord));
+
+        for (int x = 0; x < dim_x; ++x) {
+
+            const CellType cell_type = this->staged_cell_type(size_t(y_global) * dim_x + x);
+
+            m_slab_lut_row[size_t(y) * dim_x + x] = CollisionLUT<model_>::row(cell_type,
+                                                                               y_global == 0 || y_global == dim_y - 1,
+                                                                               x        == 0 || x        == dim_x - 1);
+
+            // Body forces are applied to fluid cells only
+            if (cell_type == CellType::FLUID)
+                fluid_mask[x / BITS_PER_RND_WORD] |= RndWord(1) << (x % BITS_PER_RND_WORD);
+        }
+    }});
+
+    // Count the fluid cells of the slab and sum them up over all slabs
+    const CellType* slab_cell_type = &this->staged_cell_type(size_t(m_y_begin) * dim_x);
+
+    unsigned long long num_fluid_cells = std::count(slab_cell_type, slab_cell_type + size_t(num_rows()) * dim_x, CellType::FLUID);
+
+    MPI_Allreduce(MPI_IN_PLACE, &num_fluid_cells, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+
+    m_num_fluid_cells = num_fluid_cells;
+
+    m_slab_cells_valid = true;
+}
+
+// Counts the cells for which counted() returns true on the rows of the slab of every rank, and sums
+// up the counts of the slabs before the slab of the rank and of all slabs. The count of the halo
+// row staged before the slab is subtracted from the count before the slab.
+template<Model model_>
+void MPI_Lattice<model_>::count_cells(const std::function<bool(const size_t cell)>& counted,
+                                      size_t& num_before, size_t& num_total) {
+
+    const size_t dim_x = this->m_dim_x;
+
+    unsigned long long slab_count = 0;
+    unsigned long long halo_count = 0;
+
+    for (size_t cell = size_t(m_y_begin) * dim_x; cell < size_t(m_y_end) * dim_x; ++cell)
+        if (counted(cell)) ++slab_count;
+
+    for (size_t cell = this->staged_cell_begin(); cell < size_t(m_y_begin) * dim_x; ++cell)
+        if (counted(cell)) ++halo_count;
+
+    unsigned long long sum[2] = { 0, 0 };
+
+    MPI_Exscan   (&slab_count, &sum[0], 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+    MPI_Allreduce(&slab_count, &sum[1], 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+
+    // The result of MPI_Exscan() is undefined on the first rank
+    num_before = ((m_rank == 0) ? 0 : sum[0]) - halo_count;
+    num_total  = sum[1];
+}
+
+// Applies a body force in the specified direction (x or y) and with the
+// specified intensity to the particles. E.g., if the intensity is equal 100,
+// every 100th particle changes it's direction, if feasible. The sites are counted and selected
+// within the slab of every rank, given the numbers of sites of the slabs before and of the whole
+// lattice, so that the same sites are reverted as by OMP_Lattice (see ForcingSampler).
+template<Model model_>
+void MPI_Lattice<model_>::apply_body_force(const int forcing) {
+
+    if (!m_slab_valid) pack();
+    if (!m_slab_cells_valid) setup_slab_cells();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    const size_t num_words_x = m_num_rnd_words_x;
+
+    m_reverted_particles = m_forcing.apply(m_y_begin, num_rows(), m_halo_dim_x, std::max(forcing, 0),
+
+        // Counts the sites of a row
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); },
+
+        // Reverts the selected sites of a row
+        [&](const int y, const uint32_t* selected, const size_t num_selected) {
+
+            unsigned char* const  row          = slab_row(m_slab_state.front(), y);
+            const uint32_t* const selected_end = selected + num_selected;
+
+            size_t rank = 0;
+
+            for (unsigned int p = 0; p < num_pairs; ++p) {
+
+                const unsigned char flip = (1u << pairs[p].from) | (1u << pairs[p].to);
+
+                for (size_t w = 0; w < num_words_x && selected != selected_end; ++w) {
+
+                    ForcingSampler::revert_selected(forcing_sites(y, w, pairs[p]), rank, selected, selected_end,
+                        [&](const int bit) { row[w * BITS_PER_RND_WORD + bit] ^= flip; });
+                }
+            }
+        },
+
+        // Sums up the sites of the slabs before the slab of the rank and of all slabs
+        [&](uint64_t& sites_before, uint64_t& num_sites) {
+
+            unsigned long long slab_sites = num_sites;
+            unsigned long long sum[2]     = { 0, 0 };
+
+            MPI_Exscan   (&slab_sites, &sum[0], 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+            MPI_Allreduce(&slab_sites, &sum[1], 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+
+            // The result of MPI_Exscan() is undefined on the first rank
+            sites_before = (m_rank == 0) ? 0 : sum[0];
+            num_sites    = sum[1];
+        });
+}
+
+// Applies a body force of the specified intensity spread over the next num_steps steps by the step
+// kernel, which reverts every site with probability forcing / (E num_steps) per step, with E the
+// current number of sites of the whole lattice (see FusedForcing).
+template<Model model_>
+bool MPI_Lattice<model_>::set_fused_forcing(const int forcing, const unsigned int num_steps) {
+
+    if (!m_slab_valid) pack();
+    if (!m_slab_cells_valid) setup_slab_cells();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    unsigned long long num_sites = ForcingSampler::count(num_rows(), m_halo_dim_x,
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); });
+
+    MPI_Allreduce(MPI_IN_PLACE, &num_sites, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+
+    const double probability = (forcing > 0 && num_sites > 0 && num_steps > 0)
+                             ? double(forcing) / (double(num_sites) * num_steps)
+                             : 0.0;
+
+    return m_fused_forcing.set<model_>(this->m_bf_dir, probability);
+}
+
+// Returns the sites of the specified pair of the cells of word w of the row of the slab with the
+// specified index. Body forces are applied to fluid cells only, so that the bytes read beyond the
+// end of the row (the ghost cells) are masked out by the fluid mask.
+template<Model model_>
+typename MPI_Lattice<model_>::RndWord MPI_Lattice<model_>::forcing_sites(const int y, const size_t w,
+                                                                        const ForcingPair& pair) const {
+
+    const unsigned char* cells     = slab_row(m_slab_state.front(), y) + w * BITS_PER_RND_WORD;
+    const size_t         num_cells = std::min<size_t>(BITS_PER_RND_WORD, this->m_dim_x - w * BITS_PER_RND_WORD);
+
+    RndWord mask = 0;
+
+    for (size_t i = 0; i < num_cells; i += 8)
+        mask |= RndWord(byte_cell_sites(cells + i, pair)) << i;
+
+    return mask & m_slab_fluid_mask[size_t(y) * m_num_rnd_words_x + w];
+}
+
+// Returns the number of sites of the specified pairs of the cells of the row of the slab with the
+// specified index
+template<Model model_>
+size_t MPI_Lattice<model_>::count_forcing_sites(const int y, const ForcingPair* pairs,
+                                                const unsigned int num_pairs) const {
+
+    size_t num_sites = 0;
+
+    for (unsigned int p = 0; p < num_pairs; ++p)
+        for (size_t w = 0; w < m_num_rnd_words_x; ++w)
+            num_sites += __builtin_popcountll(forcing_sites(y, w, pairs[p]));
+
+    return num_sites;
+}
+
+// Returns the number of particles in the lattice.
+template<Model model_>
+unsigned long MPI_Lattice<model_>::get_n_particles() {
+
+    if (!m_slab_valid) pack();
+
+    const int dim_x = this->m_dim_x;
+
+    const int grain = Tuning::grain_size("mpi.get_n_particles", num_rows(), dim_x);
+
+    unsigned long n_particles = Threads::parallel_reduce(tbb::blocked_range<int>(0, num_rows(), grain), 0ul,
+        [&](const tbb::blocked_range<int>& r, unsigned long n) {
+            for (int y = r.begin(); y != r.end(); ++y) {
+                const unsigned char* row = slab_row(m_slab_state.front(), y);
+                for (int x = 0; x < dim_x; ++x) n += __builtin_popcount(row[x]);
+            }
+            return n;
+        }, std::plus<unsigned long>());
+
+    MPI_Allreduce(MPI_IN_PLACE, &n_particles, 1, MPI_UNSIGNED_LONG, MPI_SUM, m_comm);
+
+    this->m_num_particles = n_particles;
+
+    return n_particles;
+}
+
+// Computes the mean velocity of the lattice from the current node states, i.e. the mean of the
+// velocities of the fluid cells holding particles over all fluid cells.
+template<Model model_>
+std::vector<Real> MPI_Lattice<model_>::get_mean_velocity() {
+
+    if (!m_slab_valid) pack();
+    if (!m_slab_cells_valid) setup_slab_cells();
+
+    const int dim_x = this->m_dim_x;
+
+    // Summed up x and y velocity components of the slab
+    struct VelocitySum {
+        double x, y;
+    };
+
+    const int grain = Tuning::grain_size("mpi.get_mean_velocity", num_rows(), dim_x * (1 + sizeof(CellType)));
+
+    const VelocitySum slab_sum = Threads::parallel_reduce(tbb::blocked_range<int>(0, num_rows(), grain), VelocitySum{0.0, 0.0},
+        [&](const tbb::blocked_range<int>& r, VelocitySum sum) {
+    for (int y = r.begin(); y != r.end(); ++y) {
+
+        const unsigned char* row       = slab_row(m_slab_state.front(), y);
+        const CellType*      cell_type = &this->staged_cell_type(size_t(m_y_begin + y) * dim_x);
+
+        for (int x = 0; x < dim_x; ++x) {
+
+            if (cell_type[x] != CellType::FLUID || row[x] == 0) continue;
+
+            Real cell_density    = 0.0;
+            Real cell_momentum_x = 0.0;
+            Real cell_momentum_y = 0.0;
+
+#pragma unroll
+            for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+                const Real node_state = (row[x] >> dir) & 1;
+
+                cell_density    += node_state;
+                cell_momentum_x += node_state * ModelDesc::LATTICE_VEC_X[dir];
+                cell_momentum_y += node_state * ModelDesc::LATTICE_VEC_Y[dir];
+            }
+
+            sum.x += cell_momentum_x / cell_density;
+            sum.y += cell_momentum_y / cell_density;
+        }
+    }
+        return sum;
+
+    }, [](const VelocitySum& a, const VelocitySum& b) {
+
+        return VelocitySum{a.x + b.x, a.y + b.y};
+    });
+
+    double sum[2] = { slab_sum.x, slab_sum.y };
+
+    MPI_Allreduce(MPI_IN_PLACE, sum, 2, MPI_DOUBLE, MPI_SUM, m_comm);
+
+    // Divide the summed up x and y components by the total number of fluid cells.
+    std::vector<Real> mean_velocity(this->SPATIAL_DIM, 0.0);
+
+    mean_velocity[0] = Real(sum[0] / m_num_fluid_cells);
+    mean_velocity[1] = Real(sum[1] / m_num_fluid_cells);
+
+    return mean_velocity;
+}
+
+// Gathers the current node states of the slabs to the output buffer of the root rank. The node
+// states of a cell are held by one block of the output buffer, i.e. the rows of the slabs are
+// received into the output buffer directly. The rows are sent from the slabs without their ghost
+// cells and counted in units of rows, so that the counts and displacements fit into an int for any
+// lattice.
+template<Model model_>
+void MPI_Lattice<model_>::copy_data_to_output_buffer() {
+
+    if (!m_slab_valid) pack();
+
+    const int dim_x = this->m_dim_x;
+
+    MPI_Datatype row_type;
+    MPI_Datatype slab_type;
+
+    MPI_Type_contiguous(dim_x, MPI_UNSIGNED_CHAR, &row_type);
+    MPI_Type_vector(num_rows(), dim_x, int(m_halo_dim_x), MPI_UNSIGNED_CHAR, &slab_type);
+    MPI_Type_commit(&row_type);
+    MPI_Type_commit(&slab_type);
+
+    std::vector<int> count;
+    std::vector<int> displ;
+
+    if (is_root()) {
+
+        count.resize(m_num_ranks);
+        displ.resize(m_num_ranks);
+
+        for (int rank = 0; rank < m_num_ranks; ++rank) {
+
+            displ[rank] = int(size_t(this->m_dim_y) *  rank      / m_num_ranks);
+            count[rank] = int(size_t(this->m_dim_y) * (rank + 1) / m_num_ranks) - displ[rank];
+        }
+    }
+
+    MPI_Gatherv(slab_row(m_slab_state.front(), 0), 1, slab_type,
+                is_root() ? this->m_node_state_out_cpu.ptr() : NULL, count.data(), displ.data(), row_type,
+                ROOT, m_comm);
+
+    MPI_Type_free(&slab_type);
+    MPI_Type_free(&row_type);
+}
+
+// Computes quantities of interest from the output buffer on the root rank.
+template<Model model_>
+void MPI_Lattice<model_>::post_process() {
+
+    if (is_root()) Lattice<model_>::post_process();
+}
+
+// Allocates the memory for the arrays on the host (CPU). The output buffer and the post-processing
+// quantities are allocated on the root rank only.
+template<Model model_>
+void MPI_Lattice<model_>::allocate_memory()
+{
+    // Allocate host memory for the staged rows
+    this->m_cell_type_cpu = (CellType*)malloc(this->num_staged_cells() * sizeof(CellType));
+
+    this->m_node_state_cpu.resize(this->num_staged_cells() * 8);
+
+    if (is_root()) {
+
+        this->m_cell_density_cpu  = (Real*)malloc(                    this->m_num_cells        * sizeof(Real));
+        this->m_mean_density_cpu  = (Real*)malloc(                    this->m_num_coarse_cells * sizeof(Real));
+        this->m_cell_momentum_cpu = (Real*)malloc(this->SPATIAL_DIM * this->m_num_cells        * sizeof(Real));
+        this->m_mean_momentum_cpu = (Real*)malloc(this->SPATIAL_DIM * this->m_num_coarse_cells * sizeof(Real));
+
+        this->m_node_state_out_cpu.resize(this->m_num_cells * 8);
+
+    } else {
+
+        this->m_cell_density_cpu  = NULL;
+        this->m_mean_density_cpu  = NULL;
+        this->m_cell_momentum_cpu = NULL;
+        this->m_mean_momentum_cpu = NULL;
+    }
+
+    // The slab is zero-initialized, so that the ghost cells are empty until the first exchange
+    const size_t num_slab_cells = m_halo_dim_x * (num_rows() + 2);
+
+    m_slab_state.allocate(num_slab_cells);
+    m_slab_lut_row    = (unsigned char*)HugePageAllocator::allocate(size_t(num_rows()) * this->m_dim_x    * sizeof(unsigned char));
+    m_slab_fluid_mask = (      RndWord*)HugePageAllocator::allocate(size_t(num_rows()) * m_num_rnd_words_x * sizeof(      RndWord));
+
+    parallel_zero_fill(m_slab_fluid_mask, size_t(num_rows()) * m_num_rnd_words_x * sizeof(RndWord));
+}
+
+// Frees the memory for the arrays on the host (CPU).
+template<Model model_>
+void MPI_Lattice<model_>::free_memory()
+{
+    // Free CPU memory
+    free(this->m_cell_type_cpu);
+    free(this->m_cell_density_cpu);
+    free(this->m_mean_density_cpu);
+    free(this->m_cell_momentum_cpu);
+    free(this->m_mean_momentum_cpu);
+
+    m_slab_state.release();
+    HugePageAllocator::deallocate(m_slab_lut_row,    size_t(num_rows()) * this->m_dim_x    * sizeof(unsigned char));
+    HugePageAllocator::deallocate(m_slab_fluid_mask, size_t(num_rows()) * m_num_rnd_words_x * sizeof(      RndWord));
+
+    this->m_cell_type_cpu       = NULL;
+    this->m_cell_density_cpu    = NULL;
+    this->m_mean_density_cpu    = NULL;
+    this->m_cell_momentum_cpu   = NULL;
+    this->m_mean_momentum_cpu   = NULL;
+
+    m_slab_lut_row              = NULL;
+    m_slab_fluid_mask           = NULL;
+}
+
+// Sets (proper) parallelization parameters.
+template<Model model_>
+void MPI_Lattice<model_>::setup_parallel()
+{
+    if (is_root())
+        printf("MPI configuration parameters: Executing calculation on %d ranks with %d threads "
+               "each, on slabs of %d or %d rows.\n\n",
+               m_num_ranks, Threads::num_threads(),
+               int(this->m_dim_y / m_num_ranks), int((this->m_dim_y - 1) / m_num_ranks + 1));
+
+    if (is_root()) HugePageAllocator::print_usage();
+}
+
+// Explicit instantiations
+template class MPI_Lattice<Model::HPP>;
+template class MPI_Lattice<Model::FHP_I>;
+template class MPI_Lattice<Model::FHP_II>;
+template class MPI_Lattice<Model::FHP_III>;
+
+} // namespace lgca
@@ -0,0 +1,236 @@
+/*
+ * This file is part of LGCA, an implementation of a Lattice Gas Cellular Automaton
+ * (https://github.com/keva92/lgca).
+ *
+ * Copyright (c) 2015-2017 Kerstin Vater, Niklas Kühl, Christian F. Janßen.
+ *
+ * LGCA is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * LGCA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lgca. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LGCA_MPI_LATTICE_H_
+#define LGCA_MPI_LATTICE_H_
+
+#include "lattice.h"
+#include "lgca_forcing.h"
+#include "lgca_lut.h"
+#include "lgca_memory.h"
+#include "lgca_random.h"
+
+#include <mpi.h>
+
+#include <cstdint>
+#include <limits>
+
+namespace lgca {
+
+// Distributed-memory lattice gas cellular automaton. The domain is split into slabs of rows, one
+// per MPI process (rank), and every rank steps its slab with the threads of the threading runtime.
+// The slabs exchange their first and last row with the neighbor slabs (wrapping around
+// periodically) in every step, while the interior rows of the slabs are stepped.
+//
+// Every rank holds the cell types and the staged node states of the rows of its slab and of one
+// halo row on each side (within the lattice) only, which are set up by the init functions of the
+// base class like the ones of a single lattice (the random numbers of the other rows are skipped).
+// On the first step (or the first body force), every rank packs the staged rows into its slab and
+// releases the staged node states. The output buffer and the post-processing quantities are held
+// by the root rank only, which gathers the node states of the slabs in
+// copy_data_to_output_buffer().
+//
+// The functions of the public interface are collective, i.e. they must be called by all ranks,
+// except for post_process(), which computes the post-processing quantities on the root rank.
+// Collision and propagation results and body forces are identical to the ones of OMP_Lattice,
+// independent of the number of ranks.
+template<Model model_>
+class MPI_Lattice: public Lattice<model_> {
+
+private:
+
+    using ModelDesc = ModelDescriptor<model_>;
+
+    // Words of the random bits for collision, holding one bit per cell of a row
+    using RndWord = uint64_t;
+
+    static constexpr unsigned int BITS_PER_RND_WORD = std::numeric_limits<RndWord>::digits;
+
+    // Rank which gathers the output
+    static constexpr int ROOT = 0;
+
+    // Communicator of the ranks, index of the rank and number of ranks
+    MPI_Comm m_comm;
+    int      m_rank;
+    int      m_num_ranks;
+
+    // Ranks holding the slabs below and above the slab of the rank
+    int m_rank_below;
+    int m_rank_above;
+
+    // Rows [m_y_begin, m_y_end) of the slab of the rank
+    int m_y_begin;
+    int m_y_end;
+
+    // Number of cells per row of the halo-padded layout, i.e. including one ghost cell on the
+    // western and the eastern boundary
+    size_t m_halo_dim_x;
+
+    // Node states of the slab in a halo-padded layout with one byte per cell (bit dir holds the
+    // state in direction dir), with one ghost row below and above the slab holding the rows of the
+    // neighbor slabs (front), and auxiliary node states (back) written by the steps
+    DoubleBuffer<unsigned char, HugePageAllocator> m_slab_state;
+
+    // Row of the collision lookup table for every cell of the slab
+    unsigned char* m_slab_lut_row;
+
+    // Mask of the fluid cells of every word of random bits of the rows of the slab
+    RndWord* m_slab_fluid_mask;
+
+    // Total number of fluid cells (of all slabs)
+    size_t m_num_fluid_cells;
+
+    // Number of particles reverted by the last body force (on all ranks)
+    unsigned long m_reverted_particles;
+
+    // Shifts of the neighbor cells the node states are pulled from during the propagation step
+    PullShifts<model_> m_pull;
+
+    // Number of words of random bits per row
+    size_t m_num_rnd_words_x;
+
+    // Generator of the random bits for collision, which are drawn afresh for every step from the
+    // index of the step and the index of the word of 64 cells of a row
+    CounterRng m_rng;
+
+    // Number of steps performed so far
+    uint64_t m_step;
+
+    // Selection of the particles reverted by the body force
+    ForcingSampler m_forcing;
+
+    // Body force applied by the step kernel (fused forcing)
+    FusedForcing m_fused_forcing;
+
+    // Whether the slab holds the current node states
+    bool m_slab_valid;
+
+    // Whether the lookup table rows and the fluid masks have been set up from the cell types
+    bool m_slab_cells_valid;
+
+    // Returns the number of rows of the slab
+    inline int num_rows() const { return m_y_end - m_y_begin; }
+
+    // Returns the interior cells of the row of the slab with the specified index (-1 and
+    // num_rows() refer to the ghost rows) in the halo-padded layout
+    inline unsigned char* slab_row(unsigned char* state, const int y) const {
+
+        return state + (y + 1) * m_halo_dim_x + 1;
+    }
+
+    inline const unsigned char* slab_row(const unsigned char* state, const int y) const {
+
+        return state + (y + 1) * m_halo_dim_x + 1;
+    }
+
+    // Performs the collision and propagation step on the row of the slab with the specified index
+    LGCA_FORCE_INLINE void step_row(const int y);
+
+    // Copies the cells on the western and eastern boundary to the ghost cells on the opposite side
+    void update_ghost_columns();
+
+    // Returns the sites of the specified pair of the cells of word w of the row of the slab with
+    // the specified index
+    RndWord forcing_sites(const int y, const size_t w, const ForcingPair& pair) const;
+
+    // Returns the number of sites of the specified pairs of the cells of the row of the slab with
+    // the specified index
+    size_t count_forcing_sites(const int y, const ForcingPair* pairs, const unsigned int num_pairs) const;
+
+    // Packs the staged node states into the slab
+    void pack();
+
+    // Sets up the lookup table rows and the fluid masks of the cells of the slab from the cell types
+    void setup_slab_cells();
+
+    // Makes the next step pack the staged node states into the slab again
+    void invalidate_node_states() { m_slab_valid = false; }
+
+    // Counts the cells for which counted() returns true on the slabs of all ranks, in the rows before
+    // the staged rows and in total
+    void count_cells(const std::function<bool(const size_t cell)>& counted,
+                     size_t& num_before, size_t& num_total);
+
+    // Makes the next step set up the lookup table rows and the fluid masks again, the node states
+    // of the slab are kept
+    void invalidate_cell_types() { m_slab_cells_valid = false; }
+
+    // Allocates the memory for the arrays on the host (CPU).
+    void allocate_memory();
+
+    // Frees the memory for the arrays on the host (CPU).
+    void free_memory();
+
+public:
+
+    // Creates a distributed lattice gas cellular automaton object of the specified properties on
+    // the ranks of the specified communicator. MPI must have been initialized.
+    MPI_Lattice(const string m_test_case,
+                const Real m_Re, const Real m_Ma_s,
+                const int m_coarse_graining_radius,
+                MPI_Comm comm = MPI_COMM_WORLD);
+
+    virtual ~MPI_Lattice();
+
+    // Sets (proper) parallelization parameters.
+    void setup_parallel();
+
+    // Performs the collision and propagation step on the lattice gas automaton.
+    void collide_and_propagate(const bool p);
+
+    // Applies a body force in the specified direction (x or y) and with the
+    // specified intensity to the particles. E.g., if the intensity is equal 100,
+    // every 100th particle changes it's direction, if feasible. Every rank reverts the selected
+    // sites of its slab.
+    void apply_body_force(const int forcing);
+
+    // Applies a body force of the specified intensity spread over the next num_steps steps by the
+    // step kernel (see FusedForcing)
+    bool set_fused_forcing(const int forcing, const unsigned int num_steps);
+
+    // Returns the number of particles in the lattice
+    unsigned long get_n_particles();
+
+    // Computes the mean velocity of the lattice from the current node states
+    std::vector<Real> get_mean_velocity();
+
+    // Gathers the current node states of the slabs to the output buffer of the root rank
+    void copy_data_to_output_buffer();
+
+    // Computes quantities of interest from the output buffer on the root rank
+    void post_process();
+
+    // Sets the seed of the random bits for collision. Runs with the same seed are reproducible
+    // bit by bit, independent of the number of ranks and threads.
+    void set_seed(const uint64_t seed) { m_rng.set_seed(seed); m_forcing.set_seed(seed); }
+
+    // Returns the number of particles reverted by the last body force
+    unsigned long reverted_particles() const { return m_reverted_particles; }
+
+    // Returns the index of the rank and the number of ranks
+    int rank()      const { return m_rank;      }
+    int num_ranks() const { return m_num_ranks; }
+
+    // Returns whether the rank gathers the output
+    bool is_root() const { return m_rank == ROOT; }
+};
+
+} // namespace lgca
+
+#endif /* LGCA_MPI_LATTICE_H_ */
@@ -20,10 +20,13 @@
 #include "lgca_common.h"
 
 #include "omp_lattice.h"
+#include "lgca_parallel.h"
 
-#include <omp.h>
 #include <tbb/blocked_range.h>
-#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
 
 namespace lgca {
 
@@ -31,42 +34,34 @@ namespace lgca {
 constexpr char          ModelDescriptor<Model::HPP>::INV_DIR[];
 constexpr char          ModelDescriptor<Model::HPP>::MIR_DIR_X[];
 constexpr char          ModelDescriptor<Model::HPP>::MIR_DIR_Y[];
+constexpr char          ModelDescriptor<Model::HPP>::ROT_DIR[];
 constexpr Real          ModelDescriptor<Model::HPP>::LATTICE_VEC_X[];
 constexpr Real          ModelDescriptor<Model::HPP>::LATTICE_VEC_Y[];
-constexpr unsigned char ModelDescriptor<Model::HPP>::COLLISION_LUT[];
-constexpr unsigned char ModelDescriptor<Model::HPP>::BB_LUT[];
-constexpr unsigned char ModelDescriptor<Model::HPP>::BF_X_LUT[];
-constexpr unsigned char ModelDescriptor<Model::HPP>::BF_Y_LUT[];
+constexpr CollisionRule ModelDescriptor<Model::HPP>::COLLISION_RULES[];
 
 constexpr char          ModelDescriptor<Model::FHP_I>::INV_DIR[];
 constexpr char          ModelDescriptor<Model::FHP_I>::MIR_DIR_X[];
 constexpr char          ModelDescriptor<Model::FHP_I>::MIR_DIR_Y[];
+constexpr char          ModelDescriptor<Model::FHP_I>::ROT_DIR[];
 constexpr Real          ModelDescriptor<Model::FHP_I>::LATTICE_VEC_X[];
 constexpr Real          ModelDescriptor<Model::FHP_I>::LATTICE_VEC_Y[];
-constexpr unsigned char ModelDescriptor<Model::FHP_I>::COLLISION_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_I>::BB_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_I>::BF_X_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_I>::BF_Y_LUT[];
+constexpr CollisionRule ModelDescriptor<Model::FHP_I>::COLLISION_RULES[];
 
 constexpr char          ModelDescriptor<Model::FHP_II>::INV_DIR[];
 constexpr char          ModelDescriptor<Model::FHP_II>::MIR_DIR_X[];
 constexpr char          ModelDescriptor<Model::FHP_II>::MIR_DIR_Y[];
+constexpr char          ModelDescriptor<Model::FHP_II>::ROT_DIR[];
 constexpr Real          ModelDescriptor<Model::FHP_II>::LATTICE_VEC_X[];
 constexpr Real          ModelDescriptor<Model::FHP_II>::LATTICE_VEC_Y[];
-constexpr unsigned char ModelDescriptor<Model::FHP_II>::COLLISION_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_II>::BB_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_II>::BF_X_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_II>::BF_Y_LUT[];
+constexpr CollisionRule ModelDescriptor<Model::FHP_II>::COLLISION_RULES[];
 
 constexpr char          ModelDescriptor<Model::FHP_III>::INV_DIR[];
 constexpr char          ModelDescriptor<Model::FHP_III>::MIR_DIR_X[];
 constexpr char          ModelDescriptor<Model::FHP_III>::MIR_DIR_Y[];
+constexpr char          ModelDescriptor<Model::FHP_III>::ROT_DIR[];
 constexpr Real          ModelDescriptor<Model::FHP_III>::LATTICE_VEC_X[];
 constexpr Real          ModelDescriptor<Model::FHP_III>::LATTICE_VEC_Y[];
-constexpr unsigned char ModelDescriptor<Model::FHP_III>::COLLISION_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_III>::BB_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_III>::BF_X_LUT[];
-constexpr unsigned char ModelDescriptor<Model::FHP_III>::BF_Y_LUT[];
+constexpr CollisionRule ModelDescriptor<Model::FHP_III>::COLLISION_RULES[];
 
 
 // Creates a CUDA parallelized lattice gas cellular automaton object
@@ -75,14 +70,26 @@ template<Model model_>
 OMP_Lattice<model_>::OMP_Lattice(const string test_case,
                                  const Real Re, const Real Ma_s,
                                  const int coarse_graining_radius)
-               : Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius) {
+               : Lattice<model_>(test_case, Re, Ma_s, coarse_graining_radius),
+                 m_halo_dim_x(this->m_dim_x + 2),
+                 m_node_state_halo_cpu(NULL),
+                 m_pull(this->m_dim_x, this->m_dim_y),
+                 m_halo_valid(false),
+                 m_kernel(OMP_Kernel::LUT),
+                 m_lut_row_cpu(NULL),
+                 m_step(0),
+                 m_num_mask_words_x((this->m_dim_x - 1) / BITS_PER_MASK_WORD + 1),
+                 m_cell_masks_valid(false),
+                 m_boundary(Boundary::GENERIC),
+                 m_tile_occupied_out_valid(false) {
+
+    // Split the domain into chunks of rows which are swept in place by one thread each. The
+    // chunks start with a row of even index value, so that the rows are processed in pairs.
+    m_chunks.init(this->m_dim_y, Threads::num_threads(), 2, REBALANCE_STEPS);
 
     // Allocate the memory for the arrays on the host (CPU)
     allocate_memory();
 
-    // Generate random bits for collision
-    this->m_rnd_cpu.fill_random();
-
     // Set the model-based values according to the number of lattice directions
     m_model = new ModelDesc(this->m_dim_x, this->m_dim_y);
 }
@@ -110,450 +117,864 @@ void OMP_Lattice<model_>::collide_and_propagate(const bool p) {
             }
 #endif
 
-    // Loop over bunches of cells
-    const size_t num_blocks = ((this->m_num_cells - 1) / Bitset::BITS_PER_BLOCK) + 1;
-    tbb::parallel_for(tbb::blocked_range<size_t>(0, num_blocks), [&](const tbb::blocked_range<size_t>& r) {
-    for (size_t block = r.begin(); block != r.end(); ++block)
+    if (!m_halo_valid) pack();
+    if (!m_cell_masks_valid) setup_cell_masks();
+
+    const int dim_x = this->m_dim_x;
+    const int dim_y = this->m_dim_y;
+
+    const int num_chunks = m_chunks.num_parts();
+
+    // Every chunk applies the periodic boundary conditions of the propagation step to the ghost
+    // columns of its rows, and needs a copy of its first and last row (including the ghost cells),
+    // since these rows are pulled from by the neighboring chunks, and two line buffers
+    const size_t chunk_buffer_size = 2 * m_halo_dim_x + 2 * dim_x;
+
+    if (m_row_buffer.size() < num_chunks * chunk_buffer_size)
+        m_row_buffer.resize(num_chunks * chunk_buffer_size);
+
+    Threads::static_parallel_for(0, num_chunks, [&](const int chunk_begin, const int chunk_end) {
+    for (int chunk = chunk_begin; chunk != chunk_end; ++chunk)
     {
-        for (size_t cell = block * Bitset::BITS_PER_BLOCK; cell < (block+1) * Bitset::BITS_PER_BLOCK; ++cell) {
+        const int y_begin = m_chunks.begin(chunk);
+        const int y_end   = m_chunks.end(chunk);
+
+        update_ghost_columns(y_begin, y_end);
+
+        unsigned char* chunk_buffer = &m_row_buffer[chunk * chunk_buffer_size];
+
+        memcpy(chunk_buffer,                 halo_row(y_begin) - 1, m_halo_dim_x);
+        memcpy(chunk_buffer + m_halo_dim_x, halo_row(y_end - 1) - 1, m_halo_dim_x);
+    }});
+
+    // The ghost rows take the first and the last row including their ghost columns
+    update_ghost_rows();
+
+    m_chunks.run([&](const int chunk, const int y_begin, const int y_end) {
+
+        // The rows next to the chunk are taken from the copies of the neighboring chunks or from
+        // the ghost rows
+        const unsigned char* row_below = (chunk == 0)
+                                       ? halo_row(-1)
+                                       : &m_row_buffer[(chunk - 1) * chunk_buffer_size + m_halo_dim_x] + 1;
+
+        const unsigned char* row_above = (chunk == num_chunks - 1)
+                                       ? halo_row(dim_y)
+                                       : &m_row_buffer[(chunk + 1) * chunk_buffer_size] + 1;
+
+        unsigned char* line_buffer = &m_row_buffer[chunk * chunk_buffer_size + 2 * m_halo_dim_x];
 
-            if (cell >= this->m_num_cells) break;
+        switch (m_boundary) {
+        case Boundary::GENERIC:  step_chunk<GenericBoundary> (y_begin, y_end, row_below, row_above, line_buffer); break;
+        case Boundary::CHANNEL:  step_chunk<ChannelBoundary> (y_begin, y_end, row_below, row_above, line_buffer); break;
+        case Boundary::PERIODIC: step_chunk<PeriodicBoundary>(y_begin, y_end, row_below, row_above, line_buffer); break;
+        }
+    });
+
+    // The particles may have spread to the tiles around the occupied tiles
+    update_active_tiles();
+
+    ++m_step;
+}
 
-            // Calculate the position of the cell in y direction (row index)
-            int pos_y = cell / this->m_dim_x;
+// Performs the collision and propagation step in place on the chunk of rows [y_begin, y_end),
+// specialized for the boundary policy.
+template<Model model_>
+template<typename Policy>
+void OMP_Lattice<model_>::step_chunk(const int y_begin, const int y_end,
+                                     const unsigned char* row_below,
+                                     const unsigned char* row_above,
+                                     unsigned char* line_buffer) {
 
-            // Get the type of the cell, i.e. fluid or solid
-            // This has to be taken into account during the collision step, where cells behave
-            // different according to their type
-            CellType cell_type = this->m_cell_type_cpu[cell];
+    // Loop over pairs of rows with even and odd index value
+    for (int y = y_begin; y < y_end; y += 2) {
 
-            // Check weather the cell is located on boundaries
-            bool on_eastern_boundary  = (cell + 1) % this->m_dim_x == 0;
-            bool on_northern_boundary = cell >= (this->m_num_cells - this->m_dim_x);
-            bool on_western_boundary  = cell % this->m_dim_x == 0;
-            bool on_southern_boundary = cell < this->m_dim_x;
+                           step_row<Policy>(y,     y_begin, y_end, row_below, row_above, line_buffer);
+        if (y + 1 < y_end) step_row<Policy>(y + 1, y_begin, y_end, row_below, row_above, line_buffer);
+    }
 
-            // Define an array for the states of the nodes in the cell
-            unsigned char node_state[this->NUM_DIR];
-//            Bitset node_state(this->NUM_DIR);
+    // Write the new node states of the last row back to global array (rows without active tiles
+    // are empty anyway)
+    if (m_row_active[y_end - 1])
+        memcpy(halo_row(y_end - 1), line_buffer + ((y_end - 1) % 2) * this->m_dim_x, this->m_dim_x);
+}
+
+// Performs the collision and propagation step in place on the row with the specified index. The
+// new node states are kept in a line buffer until the next row of the chunk has been processed,
+// which still pulls from the current node states of the row. The kernel is specialized for the
+// kind of the row given by the boundary policy.
+template<Model model_>
+template<typename Policy>
+LGCA_FORCE_INLINE void OMP_Lattice<model_>::step_row(const int y, const int y_begin, const int y_end,
+                                                     const unsigned char* row_below,
+                                                     const unsigned char* row_above,
+                                                     unsigned char* line_buffer) {
+
+    const int dim_x = this->m_dim_x;
+
+    const unsigned char* row_in[3] = { (y == y_begin)   ? row_below : halo_row(y - 1),
+                                                                      halo_row(y),
+                                       (y == y_end - 1) ? row_above : halo_row(y + 1) };
+
+    unsigned char* node_state_out = line_buffer + (y % 2) * dim_x;
+
+    // Rows without active tiles stay empty, i.e. they are neither computed nor written back
+    if (m_row_active[y]) switch (Policy::row_kind(y, this->m_dim_y)) {
+    case RowKind::FLUID:
+        if (m_kernel == OMP_Kernel::BOOLEAN) step_row_boolean<RowKind::FLUID>  (y, row_in, node_state_out);
+        else                                 step_row_lut    <RowKind::FLUID>  (y, row_in, node_state_out);
+        break;
+    case RowKind::NO_SLIP:
+        if (m_kernel == OMP_Kernel::BOOLEAN) step_row_boolean<RowKind::NO_SLIP>(y, row_in, node_state_out);
+        else                                 step_row_lut    <RowKind::NO_SLIP>(y, row_in, node_state_out);
+        break;
+    case RowKind::MIXED:
+        if (m_kernel == OMP_Kernel::BOOLEAN) step_row_boolean<RowKind::MIXED>  (y, row_in, node_state_out);
+        else                                 step_row_lut    <RowKind::MIXED>  (y, row_in, node_state_out);
+        break;
+    }
+
+    // Write the new node states of the previous row back to global array
+    if (y > y_begin && m_row_active[y - 1]) memcpy(halo_row(y - 1), line_buffer + ((y - 1) % 2) * dim_x, dim_x);
+}
+
+// Returns the rows the node states of the cells of a row are pulled from in the different directions
+// (propagation step), shifted such that the node states of cell x are found at index x.
+template<Model model_>
+LGCA_FORCE_INLINE void OMP_Lattice<model_>::pull_rows(const int y, const unsigned char* const* row_in,
+                                                      const unsigned char** pull_row) const {
 
-            // Execute propagation step
 #pragma unroll
-            for (int dir = 0; dir < this->NUM_DIR; dir++)
-            {
-                int inv_dir = ModelDesc::INV_DIR[dir];
-
-                // Reset the memory offset
-                int offset = 0;
-
-                // The cell is located in a row with even index value
-                if (pos_y % 2 == 0)
-                {
-                    // Construct the correct memory offset
-                    //
-                    // Apply a default offset value
-                    offset += m_model->offset_to_neighbor_even[inv_dir];
-
-                    // Correct the offset in the current direction if the cell is located on boundaries
-                    if (on_eastern_boundary)  offset += m_model->offset_to_western_boundary_even [inv_dir];
-                    if (on_northern_boundary) offset += m_model->offset_to_southern_boundary_even[inv_dir];
-                    if (on_western_boundary)  offset += m_model->offset_to_eastern_boundary_even [inv_dir];
-                    if (on_southern_boundary) offset += m_model->offset_to_northern_boundary_even[inv_dir];
-
-                // The cell is located in a row with odd index value
-                } else if (pos_y % 2 != 0) {
-
-                    // Construct the correct memory offset
-                    //
-                    // Apply a default offset value
-                    offset += m_model->offset_to_neighbor_odd[inv_dir];
-
-                    // Correct the offset in the current direction if the cell is located on boundaries
-                    if (on_eastern_boundary)  offset += m_model->offset_to_western_boundary_odd [inv_dir];
-                    if (on_northern_boundary) offset += m_model->offset_to_southern_boundary_odd[inv_dir];
-                    if (on_western_boundary)  offset += m_model->offset_to_eastern_boundary_odd [inv_dir];
-                    if (on_southern_boundary) offset += m_model->offset_to_northern_boundary_odd[inv_dir];
-                }
+    for (int dir = 0; dir < this->NUM_DIR; ++dir)
+        pull_row[dir] = row_in[m_pull.dy[y % 2][dir] + 1] + m_pull.dx[y % 2][dir];
+}
 
-                // Pull the states of the cell from its "neighbor" cells in the different directions
-                node_state[dir] = bool(this->m_node_state_cpu[dir + (cell + offset) * 8]);
-            }
+// Pulls the states of the nodes of cell x from its neighbor cells (propagation step) and returns
+// them packed into one byte, i.e. bit dir holds the state in direction dir.
+template<Model model_>
+LGCA_FORCE_INLINE unsigned int OMP_Lattice<model_>::pull_node_states(const unsigned char* const* pull_row,
+                                                                    const int x) const {
 
-            // Execute collision step
-            //
-            // Create a temporary array to copy the node states
-            unsigned char node_state_tmp[this->NUM_DIR];
-//            Bitset node_state_tmp(this->NUM_DIR);
+    unsigned int pulled_state = 0;
 
-            // Copy the actual states of the nodes to the temporary array
 #pragma unroll
-            for (int dir = 0; dir < this->NUM_DIR; ++dir) node_state_tmp[dir] = node_state[dir];
-//            node_state_tmp(0) = node_state(0);
+    for (int dir = 0; dir < this->NUM_DIR; ++dir)
+        pulled_state |= pull_row[dir][x] & (1u << dir);
 
-            switch (cell_type) {
+    return pulled_state;
+}
 
-            // The cell working on is a fluid cell ("normal" collision)
-            case CellType::FLUID:
-            {
-                ModelDesc::collide(&node_state[0], &node_state_tmp[0], bool(this->m_rnd_cpu[cell]));
-//                ModelDesc::collide(&node_state(0), &node_state_tmp(0), bool(this->m_rnd_cpu[cell]));
-                break;
-            }
+// Transposes the 8 x 8 bit matrix held by the bytes of the specified word, i.e. bit j of byte i
+// becomes bit i of byte j (H. S. Warren, Hacker's Delight, 7-3). This converts the node states of
+// 8 cells (one byte per cell) into the node states in 8 directions (one byte per direction) and
+// vice versa.
+static inline uint64_t transpose_8x8(uint64_t x) {
 
-            // The cell working on is a solid cell of bounce back type
-            case CellType::SOLID_NO_SLIP:
-            {
-                ModelDesc::bounce_back(&node_state[0], &node_state_tmp[0]);
-//                ModelDesc::bounce_back(&node_state(0), &node_state_tmp(0));
-                break;
-            }
+    uint64_t t;
 
-            // The cell working on is a solid cell of bounce forward type
-            case CellType::SOLID_SLIP:
-            {
-                if (on_northern_boundary || on_southern_boundary) {
+    t = (x ^ (x >>  7)) & 0x00AA00AA00AA00AAull; x ^= t ^ (t <<  7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull; x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull; x ^= t ^ (t << 28);
 
-                    // Exchange the states of the nodes with the the states of the mirrored
-                    // directions along the x axis
-                    ModelDesc::bounce_forward_x(&node_state[0], &node_state_tmp[0]);
-//                    ModelDesc::bounce_forward_x(&node_state(0), &node_state_tmp(0));
-                }
+    return x;
+}
 
-                if (on_eastern_boundary || on_western_boundary) {
+// Performs the collision and propagation step on the row with the specified index, evaluating the
+// collision rules of the model descriptor. The node states of the cells of a mask word are
+// transposed into one word per direction, so that the collision step is executed on all of them at
+// once for all cell types, and the results are blended according to the cell type masks. There is
+// no branching on the cell type. Rows of uniform cell type evaluate a single collision rule.
+template<Model model_>
+template<RowKind KIND>
+LGCA_FORCE_INLINE void OMP_Lattice<model_>::step_row_boolean(const int y, const unsigned char* const* row_in,
+                                                             unsigned char* node_state_out) {
 
-                    // Exchange the states of the nodes with the the states of
-                    // the mirrored directions along the y axis
-                    ModelDesc::bounce_forward_y(&node_state[0], &node_state_tmp[0]);
-//                    ModelDesc::bounce_forward_y(&node_state(0), &node_state_tmp(0));
-                }
-                break;
-            }
-            }
+    const int dim_x = this->m_dim_x;
+
+    const unsigned char* pull_row[this->NUM_DIR];
+    pull_rows(y, row_in, pull_row);
+
+    // Loop over the words of the masks of the row
+    for (size_t w = 0; w < m_num_mask_words_x; ++w) {
+
+        const size_t word = y * m_num_mask_words_x + w;
+
+        const int x_begin = w * BITS_PER_MASK_WORD;
+        const int x_end   = std::min(dim_x, x_begin + int(BITS_PER_MASK_WORD));
+
+        // Inactive tiles stay empty
+        if (!m_tile_active[word]) {
+
+            memset(node_state_out + x_begin, 0, x_end - x_begin);
+            continue;
+        }
+
+        // Execute propagation step
+        unsigned char cell_state[BITS_PER_MASK_WORD] = { };
+
+        for (int x = x_begin; x < x_end; ++x) cell_state[x - x_begin] = pull_node_states(pull_row, x);
+
+        // Transpose the node states of the cells into one word per direction (little endian)
+        MaskWord node_state[this->NUM_DIR] = { };
+
+        for (unsigned int group = 0; group < BITS_PER_MASK_WORD / 8; ++group) {
+
+            uint64_t states;
+            memcpy(&states, &cell_state[8 * group], sizeof(states));
+
+            states = transpose_8x8(states);
 
-            // Write new node states back to global array
 #pragma unroll
-            for (int dir = 0; dir < this->NUM_DIR; dir++)
-            {
-                this->m_node_state_tmp_cpu[dir + cell * 8] = bool(node_state_tmp[dir]);
+            for (int dir = 0; dir < this->NUM_DIR; ++dir)
+                node_state[dir] |= ((states >> (8 * dir)) & 0xFF) << (8 * group);
+        }
+
+        MaskWord node_state_new[this->NUM_DIR];
+
+        if (KIND == RowKind::NO_SLIP) {
+
+            // Execute bounce back step on rows of no-slip cells
+            ModelDesc::bounce_back(node_state, node_state_new);
+
+        } else {
+
+            // Random bits for collision of the cells of the mask word
+            MaskWord rnd;
+            m_rng.bits(MaskWord(word), m_step, rnd);
+
+            ModelDesc::collide(node_state, node_state_new, rnd);
+
+            // Apply the body force to the fluid cells (fused forcing)
+            if (m_fused_forcing.enabled()) m_fused_forcing.apply(m_rng, MaskWord(word), m_step, node_state_new);
+        }
+
+        if (KIND == RowKind::MIXED) {
+
+            // Execute collision step for the solid cell types
+            MaskWord node_state_bb [this->NUM_DIR];
+            MaskWord node_state_bfx[this->NUM_DIR];
+            MaskWord node_state_bfy[this->NUM_DIR];
+
+            ModelDesc::bounce_back     (node_state, node_state_bb);
+            ModelDesc::bounce_forward_x(node_state, node_state_bfx);
+            ModelDesc::bounce_forward_y(node_state, node_state_bfy);
+
+            const MaskWord fluid     = m_fluid_mask    [word];
+            const MaskWord no_slip   = m_no_slip_mask  [word];
+            const MaskWord slip_x    = m_slip_x_mask   [word];
+            const MaskWord slip_y    = m_slip_y_mask   [word];
+            const MaskWord slip_keep = m_slip_keep_mask[word];
+
+            // Blend the results according to the cell type masks
+#pragma unroll
+            for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+
+                node_state_new[dir] = (fluid     & node_state_new[dir])
+                                    | (no_slip   & node_state_bb [dir])
+                                    | (slip_x    & node_state_bfx[dir])
+                                    | (slip_y    & node_state_bfy[dir])
+                                    | (slip_keep & node_state    [dir]);
             }
-//            this->m_node_state_tmp_cpu(cell) = node_state_tmp(0);
+        }
 
-        } /* FOR cell */
+        MaskWord occupied = 0;
 
-    }}); /* FOR block */
+#pragma unroll
+        for (int dir = 0; dir < this->NUM_DIR; ++dir) occupied |= node_state_new[dir];
 
-    // Update the node states
-    auto node_state_cpu_tmp = this->m_node_state_cpu.ptr();
-    this->m_node_state_cpu  = m_node_state_tmp_cpu.ptr();
-    m_node_state_tmp_cpu    = node_state_cpu_tmp;
+        m_tile_occupied[word] = (occupied != 0);
+
+        // Transpose the new node states back into one byte per cell and write them back
+        for (unsigned int group = 0; group < BITS_PER_MASK_WORD / 8; ++group) {
+
+            uint64_t states = 0;
+
+#pragma unroll
+            for (int dir = 0; dir < this->NUM_DIR; ++dir)
+                states |= ((node_state_new[dir] >> (8 * group)) & 0xFF) << (8 * dir);
+
+            states = transpose_8x8(states);
+
+            memcpy(&cell_state[8 * group], &states, sizeof(states));
+        }
+
+        memcpy(node_state_out + x_begin, cell_state, x_end - x_begin);
+    }
 }
 
-// Applies a body force in the specified direction (x or y) and with the
-// specified intensity to the particles. E.g., if the intensity is equal 100,
-// every 100th particle changes it's direction, if feasible.
+// Performs the collision and propagation step on the row with the specified index with a single
+// table lookup per cell. The index of the lookup fuses the cell type (and the random bit for
+// collision) with the pulled node states, so that fluid, bounce back and bounce forward cells are
+// handled without branching. Rows of uniform cell type use a fixed row of the lookup table.
 template<Model model_>
-void OMP_Lattice<model_>::apply_body_force(const int forcing) {
+template<RowKind KIND>
+LGCA_FORCE_INLINE void OMP_Lattice<model_>::step_row_lut(const int y, const unsigned char* const* row_in,
+                                                         unsigned char* node_state_out) {
 
-    // Set a maximum number of iterations to find particles which can be reverted
-    const size_t it_max = 2 * this->m_num_cells;
+    const int dim_x = this->m_dim_x;
 
-    // Set the number of iterations to zero
-    size_t it = 0;
+    const unsigned char* lut_row = m_lut_row_cpu + size_t(y) * dim_x;
 
-    // Number of particles which have been reverted
-    unsigned int reverted_particles = 0;
+    // The rows pulled from are fixed for all cells of the row
+    const unsigned char* pull_row[this->NUM_DIR];
+    pull_rows(y, row_in, pull_row);
 
-    // Loop over all cells
-    do
-    {
-        size_t cell = rand() % this->m_num_cells;
+    for (size_t w = 0; w < m_num_mask_words_x; ++w) {
 
-    	it++;
+        const size_t word = size_t(y) * m_num_mask_words_x + w;
 
-        // Get the type of the cell, i.e. fluid or solid.
-        // Note that body forces are applied to fluid cells only.
-        CellType cell_type = this->m_cell_type_cpu[cell];
+        const int x_begin = w * BITS_PER_MASK_WORD;
+        const int x_end   = std::min(dim_x, x_begin + int(BITS_PER_MASK_WORD));
 
-        // Check weather the cell working on is a fluid cell
-        if (cell_type == CellType::FLUID) {
+        // Inactive tiles stay empty
+        if (!m_tile_active[word]) {
 
-            // Define an array for the states of the nodes in the cell
-            Bitset node_state(this->NUM_DIR);
+            memset(node_state_out + x_begin, 0, x_end - x_begin);
+            continue;
+        }
 
-            // The thread working on the cell has to know about the states of the nodes within the
-            // cell, therefore looping over all directions and look it up
-            node_state(0) = this->m_node_state_cpu(cell);
+        unsigned int occupied = 0;
 
-            // Create a temporary array to copy the node states
-            Bitset node_state_tmp(this->NUM_DIR);
+        // Rows of no-slip cells do not depend on random bits
+        if (KIND == RowKind::NO_SLIP) {
 
-            // Copy the current states of the nodes to the temporary array
-            node_state_tmp(0) = node_state(0);
+            for (int x = x_begin; x < x_end; ++x) {
 
-            if (model_ == Model::HPP) {
+                node_state_out[x] = CollisionLUT<model_>::lookup(LUT_BOUNCE_BACK, 0, pull_node_states(pull_row, x));
+                occupied         |= node_state_out[x];
+            }
 
-                if (this->m_bf_dir == 'x' && (node_state[0] == 0) && (node_state[2] == 1)) {
+        } else {
 
-					node_state_tmp[0] = 1;
-					node_state_tmp[2] = 0;
+            // Random bits for collision of the cells of the mask word
+            MaskWord rnd;
+            m_rng.bits(MaskWord(word), m_step, rnd);
 
-					reverted_particles++;
+            for (int x = x_begin; x < x_end; ++x) {
 
-                } else if (this->m_bf_dir == 'y' && (node_state[1] == 1) && (node_state[3] == 0)) {
+                const unsigned int row = (KIND == RowKind::FLUID) ? unsigned(LUT_FLUID) : lut_row[x];
 
-					node_state_tmp[1] = 0;
-					node_state_tmp[3] = 1;
+                // Execute propagation and collision step and write the new node states of the cell
+                // back at once
+                node_state_out[x] = CollisionLUT<model_>::lookup(row, (rnd >> (x - x_begin)) & 1,
+                                                                 pull_node_states(pull_row, x));
+                occupied         |= node_state_out[x];
+            }
 
-					reverted_particles++;
-				}
-        	}
+            // Apply the body force to the fluid cells (fused forcing)
+            if (m_fused_forcing.enabled())
+                m_fused_forcing.apply_cells(m_rng, MaskWord(word), m_step, node_state_out + x_begin, m_fluid_mask[word]);
+        }
 
-            else if (model_ == Model::FHP_I || model_ == Model::FHP_II || model_ == Model::FHP_III) {
+        m_tile_occupied[word] = (occupied != 0);
+    }
+}
 
-                if (this->m_bf_dir == 'x' && (node_state[0] == 0) && (node_state[3] == 1)) {
+// Copies the cells on the western and eastern boundary of the rows [y_begin, y_end) to the ghost
+// cells on the opposite side, so that the propagation step wraps around periodically.
+template<Model model_>
+void OMP_Lattice<model_>::update_ghost_columns(const int y_begin, const int y_end) {
 
-					node_state_tmp[0] = 1;
-					node_state_tmp[3] = 0;
+    const int dim_x = this->m_dim_x;
 
-					reverted_particles++;
+    for (int y = y_begin; y < y_end; ++y) {
 
-                } else if (this->m_bf_dir == 'y') {
+        unsigned char* row = halo_row(y) - 1;
 
-					if ((node_state[1] == 1) && (node_state[5] == 0)) {
+        row[0]         = row[dim_x];
+        row[dim_x + 1] = row[1];
+    }
+}
 
-						node_state_tmp[1] = 0;
-						node_state_tmp[5] = 1;
+// Copies the first and the last row of the domain (including the ghost columns) to the ghost rows
+// on the opposite side, so that the propagation step wraps around periodically.
+template<Model model_>
+void OMP_Lattice<model_>::update_ghost_rows() {
 
-						reverted_particles++;
-					}
+    const int dim_y = this->m_dim_y;
 
-					if ((node_state[2] == 1) && (node_state[4] == 0)) {
+    // Southern and northern ghost rows (including the corners)
+    memcpy(m_node_state_halo_cpu, m_node_state_halo_cpu + dim_y * m_halo_dim_x, m_halo_dim_x);
+    memcpy(m_node_state_halo_cpu + (dim_y + 1) * m_halo_dim_x, m_node_state_halo_cpu + m_halo_dim_x, m_halo_dim_x);
+}
 
-						node_state_tmp[2] = 0;
-						node_state_tmp[4] = 1;
+// Packs the node states into the halo-padded array.
+template<Model model_>
+void OMP_Lattice<model_>::pack() {
 
-						reverted_particles++;
-					}
-				}
-        	}
+    const size_t grain = Tuning::grain_size("omp.pack", this->m_num_cells, 2);
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, this->m_num_cells, grain), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+    {
+        // The node states of a cell are held by one block of the bitset
+        m_node_state_halo_cpu[halo_index(cell)] = this->m_node_state_cpu(cell);
+    }});
 
-            // Write the new node states back to the data array
-            this->m_node_state_cpu(cell) = node_state_tmp(0);
+    setup_occupied_tiles();
+    update_active_tiles();
 
-        } /* IF cell_type */
+    // The halo-padded array holds the node states from now on
+    this->m_node_state_cpu.resize(0);
 
-    } while ((reverted_particles < forcing) && (it < it_max));
+    m_halo_valid = true;
 }
 
-// Computes quantities of interest as a post-processing procedure
+// Makes the next step pack the staged node states into the halo-padded array again, e.g. after the
+// lattice has been initialized anew.
 template<Model model_>
-void OMP_Lattice<model_>::post_process() {
+void OMP_Lattice<model_>::invalidate_node_states() {
 
-    // Computes cell quantities of interest as a post-processing procedure
-	cell_post_process();
+    m_halo_valid              = false;
+    m_tile_occupied_out_valid = false;
+}
 
-    // Computes coarse grained quantities of interest as a post-processing procedure
-	mean_post_process();
+// Finds the occupied tiles of the halo-padded array.
+template<Model model_>
+void OMP_Lattice<model_>::setup_occupied_tiles() {
+
+    const int dim_x = this->m_dim_x;
+    const int grain = Tuning::grain_size("omp.setup_occupied_tiles", this->m_dim_y, m_halo_dim_x);
+
+    Threads::parallel_for(tbb::blocked_range<int>(0, this->m_dim_y, grain), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
+    {
+        const unsigned char* row = halo_row(y);
+
+        for (size_t w = 0; w < m_num_mask_words_x; ++w) {
+
+            const int x_begin = w * BITS_PER_MASK_WORD;
+            const int x_end   = std::min(dim_x, x_begin + int(BITS_PER_MASK_WORD));
+
+            unsigned int occupied = 0;
+
+            for (int x = x_begin; x < x_end; ++x) occupied |= row[x];
+
+            m_tile_occupied[size_t(y) * m_num_mask_words_x + w] = (occupied != 0);
+        }
+    }});
 }
 
-// Computes cell quantities of interest as a post-processing procedure
+// Derives the active tiles and rows from the occupied tiles. The node states propagate by one
+// cell per step, so a tile is active if the tile or one of its neighbor tiles (wrapping around
+// periodically) is occupied.
 template<Model model_>
-void OMP_Lattice<model_>::cell_post_process()
-{
-    // Loop over lattice cells
-    tbb::parallel_for(tbb::blocked_range<size_t>(0, this->m_num_cells), [&](const tbb::blocked_range<size_t>& r) {
-    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+void OMP_Lattice<model_>::update_active_tiles() {
+
+    const int dim_y       = this->m_dim_y;
+    const int num_words_x = m_num_mask_words_x;
+
+    // Every row reads the tile flags of three rows and writes its own
+    const int grain = Tuning::grain_size("omp.update_active_tiles", dim_y, 4 * num_words_x);
+
+    Threads::parallel_for(tbb::blocked_range<int>(0, dim_y, grain), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
     {
-        // Initialize the cell quantities to be computed
-        char cell_density    = 0;
-        Real cell_momentum_x = 0.0;
-        Real cell_momentum_y = 0.0;
+        const unsigned char* occupied[3] = { m_tile_occupied + size_t((y + dim_y - 1) % dim_y) * num_words_x,
+                                             m_tile_occupied + size_t( y                     ) * num_words_x,
+                                             m_tile_occupied + size_t((y             + 1) % dim_y) * num_words_x };
 
-        // Loop over nodes within the current cell
-#pragma unroll
-        for (int dir = 0; dir < this->NUM_DIR; ++dir) {
+        unsigned char row_active = 0;
+
+        for (int w = 0; w < num_words_x; ++w) {
 
-            char node_state = bool(this->m_node_state_out_cpu[dir + cell * 8]);
+            const int w_west = (w + num_words_x - 1) % num_words_x;
+            const int w_east = (w               + 1) % num_words_x;
 
-            // Sum up the node states
-            cell_density += node_state;
+            unsigned char active = 0;
 
-            // Sum up the node states multiplied by the lattice vector component for the current
-            // direction
-            cell_momentum_x += node_state * ModelDesc::LATTICE_VEC_X[dir];
-            cell_momentum_y += node_state * ModelDesc::LATTICE_VEC_Y[dir];
+            for (int i = 0; i < 3; ++i)
+                active |= occupied[i][w_west] | occupied[i][w] | occupied[i][w_east];
+
+            m_tile_active[size_t(y) * num_words_x + w] = active;
+            row_active |= active;
         }
 
-        // Write the computed cell quantities to the related data arrays
-        this->m_cell_density_cpu [cell                        ] = (Real) cell_density;
-        this->m_cell_momentum_cpu[cell * this->SPATIAL_DIM    ] = cell_momentum_x;
-        this->m_cell_momentum_cpu[cell * this->SPATIAL_DIM + 1] = cell_momentum_y;
+        m_row_active[y] = row_active;
+    }});
+}
 
-    } // for cell
-    });
+// Unpacks the halo-padded array into the specified bitset.
+template<Model model_>
+void OMP_Lattice<model_>::unpack(Bitset& node_state) const {
+
+    assert(node_state.size() == this->m_num_cells * 8);
+
+    const size_t grain = Tuning::grain_size("omp.unpack", this->m_num_cells, 2);
+
+    Threads::parallel_for(tbb::blocked_range<size_t>(0, this->m_num_cells, grain), [&](const tbb::blocked_range<size_t>& r) {
+    for (size_t cell = r.begin(); cell != r.end(); ++cell)
+    {
+        node_state(cell) = m_node_state_halo_cpu[halo_index(cell)];
+    }});
 }
 
-// Computes coarse grained quantities of interest as a post-processing procedure
+// Sets up the cell type masks, the lookup table rows of the cells and the boundary policy from the
+// cell types.
 template<Model model_>
-void OMP_Lattice<model_>::mean_post_process()
-{
-    const int r = this->m_coarse_graining_radius;
+void OMP_Lattice<model_>::setup_cell_masks() {
+
+    const int dim_x = this->m_dim_x;
+    const int dim_y = this->m_dim_y;
 
-    tbb::parallel_for(tbb::blocked_range<size_t>(0, this->m_num_coarse_cells), [&](const tbb::blocked_range<size_t>& range) {
-    for (size_t coarse_cell = range.begin(); coarse_cell != range.end(); ++coarse_cell)
+    Threads::parallel_for(tbb::blocked_range<int>(0, dim_y), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
     {
-        // Get cell in the bottom left corner of the coarse cell
-        const size_t cell = (coarse_cell % this->m_coarse_dim_x) * (2 * r)
-                          + (coarse_cell / this->m_coarse_dim_x) * (2 * r) * this->m_dim_x;
+        for (size_t w = 0; w < m_num_mask_words_x; ++w) {
+
+            MaskWord fluid     = 0;
+            MaskWord no_slip   = 0;
+            MaskWord slip_x    = 0;
+            MaskWord slip_y    = 0;
+            MaskWord slip_keep = 0;
+
+            for (unsigned int bit = 0; bit < BITS_PER_MASK_WORD; ++bit) {
+
+                const int x = w * BITS_PER_MASK_WORD + bit;
+                if (x >= dim_x) break;
+
+                const size_t   cell = size_t(y) * dim_x + x;
+                const MaskWord mask = MaskWord(1) << bit;
+
+                const LutRow lut_row = CollisionLUT<model_>::row(this->m_cell_type_cpu[cell],
+                                                                 y == 0 || y == dim_y - 1,
+                                                                 x == 0 || x == dim_x - 1);
+                m_lut_row_cpu[cell] = lut_row;
+
+                // Bounce forward along the y axis takes precedence in the corners
+                switch (lut_row) {
+                case LUT_FLUID:            fluid     |= mask; break;
+                case LUT_BOUNCE_BACK:      no_slip   |= mask; break;
+                case LUT_BOUNCE_FORWARD_X: slip_x    |= mask; break;
+                case LUT_BOUNCE_FORWARD_Y: slip_y    |= mask; break;
+                default:                   slip_keep |= mask; break;
+                }
+            }
 
-        // Calculate the position of the cell in x direction
-        int pos_x = cell % this->m_dim_x;
+            const size_t word = y * m_num_mask_words_x + w;
 
-        // Initialize the coarse grained quantities to be computed
-        Real mean_density    = 0.0;
-        Real mean_momentum_x = 0.0;
-        Real mean_momentum_y = 0.0;
+            m_fluid_mask    [word] = fluid;
+            m_no_slip_mask  [word] = no_slip;
+            m_slip_x_mask   [word] = slip_x;
+            m_slip_y_mask   [word] = slip_y;
+            m_slip_keep_mask[word] = slip_keep;
+        }
+    }});
 
-        // Initialize the number of actual existing coarse graining neighbor cells
-        int n_exist_neighbors = 0;
+    // Choose the boundary policy the step kernels are specialized for
+    m_boundary = detect_boundary(this->m_cell_type_cpu, dim_x, dim_y);
 
-        // The thread working on the cell has to know the cell quantities of the coarse graining
-        // neighbor cells, therefore looping over all neighbor cells and look it up
-#pragma unroll
-        for (int y = 0; y <= 2 * r; ++y) {
+    m_cell_masks_valid = true;
+}
+
+// Applies a body force in the specified direction (x or y) and with the
+// specified intensity to the particles. E.g., if the intensity is equal 100,
+// every 100th particle changes it's direction, if feasible.
+//
+// Exactly min(forcing, E) of the E sites (particles of fluid cells which can be reverted) are
+// reverted by the threads in parallel, see ForcingSampler.
+template<Model model_>
+void OMP_Lattice<model_>::apply_body_force(const int forcing) {
+
+    if (!m_halo_valid) pack();
 
-            for (int x = 0; x <= 2 * r; ++x) {
+    // Body forces are applied to fluid cells only
+    if (!m_cell_masks_valid) setup_cell_masks();
 
-                // Get the index of the coarse graining neighbor cell
-                size_t neighbor_idx = cell + y * this->m_dim_x + x;
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
 
-                // Get the position of the coarse graining neighbor cell in x direction
-                int pos_x_neighbor = neighbor_idx % this->m_dim_x;
+    const size_t num_words_x = m_num_mask_words_x;
 
-                // Check weather the coarse graining neighbor cell is valid
-                if ((neighbor_idx >= 0) &&
-                    (neighbor_idx < this->m_num_cells) &&
-                    (abs(pos_x_neighbor - pos_x) <= r)) {
+    m_forcing.apply(this->m_dim_y, m_halo_dim_x, std::max(forcing, 0),
 
-                    // Increase the number of existing coarse graining neighbor cells
-                    n_exist_neighbors++;
+        // Counts the sites of a row
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); },
 
-                    mean_density    += this->m_cell_density_cpu [neighbor_idx                        ];
-                    mean_momentum_x += this->m_cell_momentum_cpu[neighbor_idx * this->SPATIAL_DIM    ];
-                    mean_momentum_y += this->m_cell_momentum_cpu[neighbor_idx * this->SPATIAL_DIM + 1];
+        // Reverts the selected sites of a row
+        [&](const int y, const uint32_t* selected, const size_t num_selected) {
+
+            unsigned char* const  row          = halo_row(y);
+            const uint32_t* const selected_end = selected + num_selected;
+
+            size_t rank = 0;
+
+            for (unsigned int p = 0; p < num_pairs; ++p) {
+
+                const unsigned char flip = (1u << pairs[p].from) | (1u << pairs[p].to);
+
+                for (size_t w = 0; w < num_words_x && selected != selected_end; ++w) {
+
+                    ForcingSampler::revert_selected(forcing_sites(y, w, pairs[p]), rank, selected, selected_end,
+                        [&](const int bit) { row[w * BITS_PER_MASK_WORD + bit] ^= flip; });
                 }
             }
-        }
+        });
+}
 
-        // Write the computed coarse grained quantities to the related data arrays
-        this->m_mean_density_cpu [coarse_cell                        ] = mean_density    / ((Real) n_exist_neighbors);
-        this->m_mean_momentum_cpu[coarse_cell * this->SPATIAL_DIM    ] = mean_momentum_x / ((Real) n_exist_neighbors);
-        this->m_mean_momentum_cpu[coarse_cell * this->SPATIAL_DIM + 1] = mean_momentum_y / ((Real) n_exist_neighbors);
+// Applies a body force of the specified intensity spread over the next num_steps steps by the step
+// kernels, which revert every site with probability forcing / (E num_steps) per step, with E the
+// current number of sites (see FusedForcing).
+template<Model model_>
+bool OMP_Lattice<model_>::set_fused_forcing(const int forcing, const unsigned int num_steps) {
+
+    if (!m_halo_valid) pack();
+    if (!m_cell_masks_valid) setup_cell_masks();
+
+    ForcingPair pairs[2];
+    const unsigned int num_pairs = body_force_pairs<model_>(this->m_bf_dir, pairs);
+
+    const size_t num_sites = ForcingSampler::count(this->m_dim_y, m_halo_dim_x,
+        [&](const int y) { return count_forcing_sites(y, pairs, num_pairs); });
 
-    }}); // for coarse_cell
+    const double probability = (forcing > 0 && num_sites > 0 && num_steps > 0)
+                             ? double(forcing) / (double(num_sites) * num_steps)
+                             : 0.0;
+
+    return m_fused_forcing.set<model_>(this->m_bf_dir, probability);
 }
 
-// Allocates the memory for the arrays on the host (CPU)
+// Returns the sites of the specified pair of the cells of mask word w of row y. Body forces are
+// applied to fluid cells only, so that the bytes read beyond the end of the row (the ghost cells)
+// are masked out by the fluid mask.
 template<Model model_>
-void OMP_Lattice<model_>::allocate_memory()
-{
-    // Allocate host memory
-    this->m_cell_type_cpu     = (CellType*)malloc(                    this->m_num_cells        * sizeof(CellType));
-    this->m_cell_density_cpu  = (    Real*)malloc(                    this->m_num_cells        * sizeof(    Real));
-    this->m_mean_density_cpu  = (    Real*)malloc(                    this->m_num_coarse_cells * sizeof(    Real));
-    this->m_cell_momentum_cpu = (    Real*)malloc(this->SPATIAL_DIM * this->m_num_cells        * sizeof(    Real));
-    this->m_mean_momentum_cpu = (    Real*)malloc(this->SPATIAL_DIM * this->m_num_coarse_cells * sizeof(    Real));
+typename OMP_Lattice<model_>::MaskWord OMP_Lattice<model_>::forcing_sites(const int y, const size_t w,
+                                                                         const ForcingPair& pair) const {
 
-    this->m_node_state_cpu.resize    (this->m_num_cells * 8);
-          m_node_state_tmp_cpu.resize(this->m_num_cells * 8);
-    this->m_node_state_out_cpu.resize(this->m_num_cells * 8);
-    this->m_rnd_cpu.resize           (this->m_num_cells);
+    const unsigned char* cells     = halo_row(y) + w * BITS_PER_MASK_WORD;
+    const size_t         num_cells = std::min<size_t>(BITS_PER_MASK_WORD, this->m_dim_x - w * BITS_PER_MASK_WORD);
+
+    MaskWord mask = 0;
+
+    for (size_t i = 0; i < num_cells; i += 8)
+        mask |= MaskWord(byte_cell_sites(cells + i, pair)) << i;
+
+    return mask & m_fluid_mask[y * m_num_mask_words_x + w];
 }
 
-// Frees the memory for the arrays on the host (CPU)
+// Returns the number of sites of the specified pairs of the cells of row y
 template<Model model_>
-void OMP_Lattice<model_>::free_memory()
-{
-    // Free CPU memory
-    free(this->m_cell_type_cpu);
-    free(this->m_cell_density_cpu);
-    free(this->m_mean_density_cpu);
-    free(this->m_cell_momentum_cpu);
-    free(this->m_mean_momentum_cpu);
-
-    this->m_cell_type_cpu       = NULL;
-    this->m_cell_density_cpu    = NULL;
-    this->m_mean_density_cpu    = NULL;
-    this->m_cell_momentum_cpu   = NULL;
-    this->m_mean_momentum_cpu   = NULL;
+size_t OMP_Lattice<model_>::count_forcing_sites(const int y, const ForcingPair* pairs,
+                                                const unsigned int num_pairs) const {
+
+    size_t num_sites = 0;
+
+    for (unsigned int p = 0; p < num_pairs; ++p)
+        for (size_t w = 0; w < m_num_mask_words_x; ++w)
+            num_sites += __builtin_popcountll(forcing_sites(y, w, pairs[p]));
+
+    return num_sites;
 }
 
-// Sets (proper) parallelization parameters
+// Returns the number of particles in the lattice.
 template<Model model_>
-void OMP_Lattice<model_>::setup_parallel()
-{
+unsigned long OMP_Lattice<model_>::get_n_particles() {
+
+    if (!m_halo_valid) return Lattice<model_>::get_n_particles();
+
+    const size_t grain = Tuning::grain_size("omp.get_n_particles", this->m_num_cells, 1);
 
-#pragma omp parallel for
-	for (unsigned int i = 0; i < omp_get_num_threads(); ++i)
-	{
-		if (omp_get_thread_num() == 0)
-		{
-			// Only execute in master thread.
-            printf("OMP configuration parameters: Executing calculation with %d threads.\n\n", omp_get_num_threads());
-		}
-	}
+    size_t n_particles = Threads::parallel_reduce(tbb::blocked_range<size_t>(0, this->m_num_cells, grain), size_t(0),
+        [&](const tbb::blocked_range<size_t>& r, size_t n) {
+            for (size_t cell = r.begin(); cell != r.end(); ++cell)
+                n += __builtin_popcount(m_node_state_halo_cpu[halo_index(cell)]);
+            return n;
+        }, std::plus<size_t>());
+
+    this->m_num_particles = n_particles;
+
+    return n_particles;
 }
 
-// Computes the mean velocity of the lattice.
+// Unpacks the current node states to the output buffer for post-processing and visualization.
 template<Model model_>
-std::vector<Real> OMP_Lattice<model_>::get_mean_velocity() {
+void OMP_Lattice<model_>::copy_data_to_output_buffer() {
 
-    std::vector<Real> mean_velocity(this->SPATIAL_DIM, 0.0);
+    if (!m_halo_valid) {
 
-    Real sum_x_vel = 0.0;
-    Real sum_y_vel = 0.0;
+        Lattice<model_>::copy_data_to_output_buffer();
+        return;
+    }
 
-    size_t counter = 0;
+    unpack(this->m_node_state_out_cpu);
 
-    // Sum up all (fluid) cell x and y velocity components.
-#pragma omp parallel for reduction(+: sum_x_vel, sum_y_vel)
-    for (size_t n = 0; n < this->m_num_cells; ++n) {
+    memcpy(m_tile_occupied_out, m_tile_occupied, m_num_mask_words_x * this->m_dim_y);
 
-        if (this->m_cell_type_cpu[n] == CellType::FLUID) {
+    m_tile_occupied_out_valid = true;
+}
 
-        	counter++;
+// Computes quantities of interest as a post-processing procedure. The cell quantities of the tiles
+// without particles vanish and are not computed from the output buffer.
+template<Model model_>
+void OMP_Lattice<model_>::post_process() {
 
-            Real cell_density = this->m_cell_density_cpu[n];
+    if (!m_tile_occupied_out_valid) {
 
-			if (cell_density > 1.0e-06) {
+        Lattice<model_>::post_process();
+        return;
+    }
 
-                sum_x_vel += this->m_cell_momentum_cpu[n * this->SPATIAL_DIM    ] / cell_density;
-                sum_y_vel += this->m_cell_momentum_cpu[n * this->SPATIAL_DIM + 1] / cell_density;
-			}
+    const int dim_x = this->m_dim_x;
 
-#ifdef DEBUG
+    // Every cell of a row reads its node states and cell type and writes its density and momentum
+    const int grain = Tuning::grain_size("omp.post_process", this->m_dim_y,
+                                         dim_x * (1 + sizeof(CellType) + (1 + this->SPATIAL_DIM) * sizeof(Real)));
 
-			else if (fabs(cell_density) < 1.0e-06) {
+    Threads::parallel_for(tbb::blocked_range<int>(0, this->m_dim_y, grain), [&](const tbb::blocked_range<int>& r) {
+    for (int y = r.begin(); y != r.end(); ++y)
+    {
+        for (size_t w = 0; w < m_num_mask_words_x; ++w) {
 
-				// Do nothing.
+            const size_t cell_begin = size_t(y) * dim_x + w * BITS_PER_MASK_WORD;
+            const size_t cell_end   = size_t(y) * dim_x + std::min(dim_x, int((w + 1) * BITS_PER_MASK_WORD));
 
-			} else if (cell_density < -1.0e-06) {
+            if (m_tile_occupied_out[size_t(y) * m_num_mask_words_x + w]) {
 
-				printf("ERROR in get_mean_velocity(): "
-					   "Negative cell density detected.");
-				abort();
-			}
+                for (size_t cell = cell_begin; cell < cell_end; ++cell) this->cell_post_process(cell);
 
-#endif
+            } else {
 
+                std::fill(this->m_cell_density_cpu  +                     cell_begin,
+                          this->m_cell_density_cpu  +                     cell_end,   Real(0.0));
+                std::fill(this->m_cell_momentum_cpu + this->SPATIAL_DIM * cell_begin,
+                          this->m_cell_momentum_cpu + this->SPATIAL_DIM * cell_end,   Real(0.0));
+            }
         }
-    }
+    }});
+
+    // Computes coarse grained quantities of interest as a post-processing procedure
+    this->mean_post_process();
+}
+
+// Allocates the memory for the arrays on the host (CPU)
+template<Model model_>
+void OMP_Lattice<model_>::allocate_memory()
+{
+    // Allocate host memory. The arrays of one or more values per cell are backed by huge pages,
+    // where possible.
+    this->m_cell_type_cpu     = (CellType*)HugePageAllocator::allocate(                    this->m_num_cells        * sizeof(CellType));
+    this->m_cell_density_cpu  = (    Real*)HugePageAllocator::allocate(                    this->m_num_cells        * sizeof(    Real));
+    this->m_mean_density_cpu  = (    Real*)HugePageAllocator::allocate(                    this->m_num_coarse_cells * sizeof(    Real));
+    this->m_cell_momentum_cpu = (    Real*)HugePageAllocator::allocate(this->SPATIAL_DIM * this->m_num_cells        * sizeof(    Real));
+    this->m_mean_momentum_cpu = (    Real*)HugePageAllocator::allocate(this->SPATIAL_DIM * this->m_num_coarse_cells * sizeof(    Real));
+          m_lut_row_cpu       = (unsigned char*)HugePageAllocator::allocate(            this->m_num_cells        * sizeof(unsigned char));
+
+    const size_t num_mask_words = m_num_mask_words_x * this->m_dim_y;
+
+    // The arrays streamed by the step kernel are zero-filled by first_touch()
+    m_fluid_mask     = (MaskWord*)HugePageAllocator::allocate(num_mask_words * sizeof(MaskWord));
+    m_no_slip_mask   = (MaskWord*)HugePageAllocator::allocate(num_mask_words * sizeof(MaskWord));
+    m_slip_x_mask    = (MaskWord*)HugePageAllocator::allocate(num_mask_words * sizeof(MaskWord));
+    m_slip_y_mask    = (MaskWord*)HugePageAllocator::allocate(num_mask_words * sizeof(MaskWord));
+    m_slip_keep_mask = (MaskWord*)HugePageAllocator::allocate(num_mask_words * sizeof(MaskWord));
+
+    m_tile_occupied     = (unsigned char*)malloc(num_mask_words * sizeof(unsigned char));
+    m_tile_active       = (unsigned char*)malloc(num_mask_words * sizeof(unsigned char));
+    m_tile_occupied_out = (unsigned char*)calloc(num_mask_words, sizeof(unsigned char));
+    m_row_active        = (unsigned char*)calloc(this->m_dim_y,  sizeof(unsigned char));
+
+    // The halo-padded array is zero-initialized, so that the unused nodes of the cells stay empty
+    const size_t num_halo_cells = m_halo_dim_x * (this->m_dim_y + 2);
+
+    m_node_state_halo_cpu = (unsigned char*)HugePageAllocator::allocate(num_halo_cells * sizeof(unsigned char));
+
+    first_touch();
 
-    // Divide the summed up x and y components by the total number of fluid cells.
-    mean_velocity[0] = sum_x_vel / (Real) counter;
-    mean_velocity[1] = sum_y_vel / (Real) counter;
+    this->m_node_state_cpu.resize    (this->m_num_cells * 8);
+    this->m_node_state_out_cpu.resize(this->m_num_cells * 8);
+}
+
+// Zero-fills the arrays streamed by the step kernel chunk by chunk, so that their pages are placed
+// on the NUMA nodes of the threads updating the chunks.
+template<Model model_>
+void OMP_Lattice<model_>::first_touch() {
+
+    const int    dim_y       = this->m_dim_y;
+    const size_t dim_x       = this->m_dim_x;
+    const size_t num_words_x = m_num_mask_words_x;
+
+    const int num_chunks = m_chunks.num_parts();
+
+    Threads::static_parallel_for(0, num_chunks, [&](const int chunk_begin, const int chunk_end) {
+    for (int chunk = chunk_begin; chunk != chunk_end; ++chunk)
+    {
+        const int y_begin = m_chunks.begin(chunk);
+        const int y_end   = m_chunks.end(chunk);
+
+        // The ghost rows are updated along with the first and the last chunk
+        const int halo_begin = (chunk == 0)              ? -1        : y_begin;
+        const int halo_end   = (chunk == num_chunks - 1) ? dim_y + 1 : y_end;
+
+        memset(halo_row(halo_begin) - 1, 0, (halo_end - halo_begin) * m_halo_dim_x);
+
+        const size_t word_begin = y_begin * num_words_x;
+        const size_t num_words  = (y_end - y_begin) * num_words_x;
+
+        memset(m_fluid_mask     + word_begin, 0, num_words * sizeof(MaskWord));
+        memset(m_no_slip_mask   + word_begin, 0, num_words * sizeof(MaskWord));
+        memset(m_slip_x_mask    + word_begin, 0, num_words * sizeof(MaskWord));
+        memset(m_slip_y_mask    + word_begin, 0, num_words * sizeof(MaskWord));
+        memset(m_slip_keep_mask + word_begin, 0, num_words * sizeof(MaskWord));
+
+        memset(m_tile_occupied  + word_begin, 0, num_words);
+        memset(m_tile_active    + word_begin, 0, num_words);
+
+        memset(m_lut_row_cpu + y_begin * dim_x, 0, (y_end - y_begin) * dim_x);
+    }});
+}
+
+// Frees the memory for the arrays on the host (CPU)
+template<Model model_>
+void OMP_Lattice<model_>::free_memory()
+{
+    const size_t num_halo_cells = m_halo_dim_x * (this->m_dim_y + 2);
+    const size_t num_mask_words = m_num_mask_words_x * this->m_dim_y;
+
+    // Free CPU memory
+    HugePageAllocator::deallocate(this->m_cell_type_cpu,                         this->m_num_cells        * sizeof(CellType));
+    HugePageAllocator::deallocate(this->m_cell_density_cpu,                      this->m_num_cells        * sizeof(    Real));
+    HugePageAllocator::deallocate(this->m_mean_density_cpu,                      this->m_num_coarse_cells * sizeof(    Real));
+    HugePageAllocator::deallocate(this->m_cell_momentum_cpu, this->SPATIAL_DIM * this->m_num_cells        * sizeof(    Real));
+    HugePageAllocator::deallocate(this->m_mean_momentum_cpu, this->SPATIAL_DIM * this->m_num_coarse_cells * sizeof(    Real));
+    HugePageAllocator::deallocate(      m_lut_row_cpu,                           this->m_num_cells        * sizeof(unsigned char));
+    HugePageAllocator::deallocate(      m_node_state_halo_cpu,                   num_halo_cells           * sizeof(unsigned char));
+    HugePageAllocator::deallocate(      m_fluid_mask,                            num_mask_words           * sizeof(     MaskWord));
+    HugePageAllocator::deallocate(      m_no_slip_mask,                          num_mask_words           * sizeof(     MaskWord));
+    HugePageAllocator::deallocate(      m_slip_x_mask,                           num_mask_words           * sizeof(     MaskWord));
+    HugePageAllocator::deallocate(      m_slip_y_mask,                           num_mask_words           * sizeof(     MaskWord));
+    HugePageAllocator::deallocate(      m_slip_keep_mask,                        num_mask_words           * sizeof(     MaskWord));
+
+    free(      m_tile_occupied);
+    free(      m_tile_active);
+    free(      m_tile_occupied_out);
+    free(      m_row_active);
+
+    this->m_cell_type_cpu           = NULL;
+    this->m_cell_density_cpu        = NULL;
+    this->m_mean_density_cpu        = NULL;
+    this->m_cell_momentum_cpu       = NULL;
+    this->m_mean_momentum_cpu       = NULL;
+          m_lut_row_cpu             = NULL;
+          m_node_state_halo_cpu     = NULL;
+          m_fluid_mask              = NULL;
+          m_no_slip_mask            = NULL;
+          m_slip_x_mask             = NULL;
+          m_slip_y_mask             = NULL;
+          m_slip_keep_mask          = NULL;
+          m_tile_occupied           = NULL;
+          m_tile_active             = NULL;
+          m_tile_occupied_out       = NULL;
+          m_row_active              = NULL;
+}
+
+// Sets (proper) parallelization parameters
+template<Model model_>
+void OMP_Lattice<model_>::setup_parallel()
+{
+    printf("OMP configuration parameters: Executing calculation with %d threads%s.\n\n",
+           Threads::num_threads(), Threads::pinned() ? " (pinned to cores)" : "");
 
-    return mean_velocity;
+    HugePageAllocator::print_usage();
 }
 
 // Explicit instantiations
@@ -21,9 +21,24 @@
 #define LGCA_OMP_LATTICE_H_
 
 #include "lattice.h"
+#include "lgca_boundary.h"
+#include "lgca_forcing.h"
+#include "lgca_lut.h"
+#include "lgca_memory.h"
+#include "lgca_parallel.h"
+#include "lgca_random.h"
+
+#include <cstdint>
+#include <limits>
 
 namespace lgca {
 
+// Step kernels of the byte-per-cell lattice
+enum class OMP_Kernel {
+    BOOLEAN, // Evaluates the collision rules of the model descriptor node by node
+    LUT      // Looks up the node states after the collision step in the collision lookup table
+};
+
 template<Model model_>
 class OMP_Lattice: public Lattice<model_> {
 
@@ -31,17 +46,183 @@ private:
 
     using ModelDesc = ModelDescriptor<model_>;
 
-    // Auxiliary array on the CPU.
-    Bitset m_node_state_tmp_cpu;
-
     // Model-based values according to the number of lattice directions
     ModelDesc* m_model;
 
-	// Computes cell quantities of interest as a post-processing procedure.
-	void cell_post_process();
+    // Number of cells per row of the halo-padded layout, i.e. including one ghost cell on the
+    // western and the eastern boundary
+    size_t m_halo_dim_x;
+
+    // Node states in a halo-padded layout with one byte per cell (bit dir holds the state in
+    // direction dir). The domain is surrounded by one layer of ghost cells holding copies of the
+    // cells on the opposite boundary, so that every cell pulls its node states from fixed memory
+    // offsets. The collision and propagation step is performed in place, i.e. there is no auxiliary
+    // array of the node states.
+    unsigned char* m_node_state_halo_cpu;
+
+    // Copies of the first and last row of the chunks of rows swept in place by the threads, and
+    // their line buffers
+    std::vector<unsigned char> m_row_buffer;
+
+    // Partition of the rows into one chunk per thread, which is rebalanced by the measured time of
+    // the chunks every REBALANCE_STEPS steps, so that the threads finish at the same time on
+    // domains with many solid cells or empty tiles. The chunks are handed to the threads by a
+    // static partition, the arrays streamed by the step kernel are first touched the same way.
+    BalancedPartition m_chunks;
+
+    static constexpr int REBALANCE_STEPS = 64;
+
+    // Shifts of the neighbor cells the node states are pulled from during the propagation step
+    PullShifts<model_> m_pull;
+
+    // Whether the halo-padded array holds the current node states
+    bool m_halo_valid;
+
+    // Step kernel in use
+    OMP_Kernel m_kernel;
+
+    // Row of the collision lookup table for every cell, fusing the cell type and the position of
+    // slip cells
+    unsigned char* m_lut_row_cpu;
+
+    // Generator of the random bits for collision, which are drawn afresh for every step from the
+    // index of the step and the index of the mask word of the cells
+    CounterRng m_rng;
+
+    // Number of steps performed so far
+    uint64_t m_step;
+
+    // Selection of the particles reverted by the body force
+    ForcingSampler m_forcing;
+
+    // Body force applied by the step kernels (fused forcing)
+    FusedForcing m_fused_forcing;
+
+    // Words of the bit masks below, holding one bit per cell of a row
+    using MaskWord = uint64_t;
+
+    static constexpr unsigned int BITS_PER_MASK_WORD = std::numeric_limits<MaskWord>::digits;
+
+    // Number of mask words per row
+    size_t m_num_mask_words_x;
+
+    // Bit masks of the cell types, aligned with the rows of the node states. Slip cells are split
+    // into cells on the northern or southern boundary (bounce forward along the x axis), cells on
+    // the eastern or western boundary (bounce forward along the y axis), and interior cells (states
+    // are kept).
+    MaskWord* m_fluid_mask;
+    MaskWord* m_no_slip_mask;
+    MaskWord* m_slip_x_mask;
+    MaskWord* m_slip_y_mask;
+    MaskWord* m_slip_keep_mask;
+
+    // Whether the cell type masks and lookup table rows have been set up from the cell types
+    bool m_cell_masks_valid;
+
+    // Boundary policy the step kernels are specialized for, following from the cell types
+    Boundary m_boundary;
+
+    // Activity tracking. The rows are split into tiles of the cells of one mask word. A tile is
+    // occupied if one of its cells holds a particle, and active if the tile or one of the eight
+    // tiles around it is occupied. Inactive tiles stay empty during the next step, which is why the
+    // step kernels skip them as well as rows without active tiles. The flags are indexed like the
+    // mask words.
+    unsigned char* m_tile_occupied;
+    unsigned char* m_tile_active;
+    unsigned char* m_row_active;
+
+    // Occupied tiles of the node states in the output buffer
+    unsigned char* m_tile_occupied_out;
+
+    // Whether the occupied tiles of the output buffer are known
+    bool m_tile_occupied_out_valid;
+
+    // Returns the index of the specified cell in the halo-padded layout
+    inline size_t halo_index(const size_t cell) const {
+
+        return (cell / this->m_dim_x + 1) * m_halo_dim_x + cell % this->m_dim_x + 1;
+    }
 
-	// Computes coarse grained quantities of interest as a post-processing procedure.
-	void mean_post_process();
+    // Returns the interior cells of the row with the specified index in the halo-padded layout
+    inline unsigned char* halo_row(const int y) const {
+
+        return m_node_state_halo_cpu + (y + 1) * m_halo_dim_x + 1;
+    }
+
+    // Returns the rows the node states of the cells of a row are pulled from in the different
+    // directions, given the rows below, at and above the row
+    LGCA_FORCE_INLINE void pull_rows(const int y, const unsigned char* const* row_in,
+                                     const unsigned char** pull_row) const;
+
+    // Pulls the states of the nodes of cell x from its neighbor cells (propagation step) and
+    // returns them packed into one byte
+    LGCA_FORCE_INLINE unsigned int pull_node_states(const unsigned char* const* pull_row,
+                                                    const int x) const;
+
+    // Performs the collision and propagation step in place on the chunk of rows [y_begin, y_end)
+    template<typename Policy>
+    void step_chunk(const int y_begin, const int y_end,
+                    const unsigned char* row_below,
+                    const unsigned char* row_above,
+                    unsigned char* line_buffer);
+
+    // Performs the collision and propagation step in place on the row with the specified index of
+    // the chunk of rows [y_begin, y_end)
+    template<typename Policy>
+    LGCA_FORCE_INLINE void step_row(const int y, const int y_begin, const int y_end,
+                                    const unsigned char* row_below,
+                                    const unsigned char* row_above,
+                                    unsigned char* line_buffer);
+
+    // Performs the collision and propagation step on the row with the specified index, evaluating
+    // the collision rules node by node
+    template<RowKind KIND>
+    LGCA_FORCE_INLINE void step_row_boolean(const int y, const unsigned char* const* row_in,
+                                            unsigned char* node_state_out);
+
+    // Performs the collision and propagation step on the row with the specified index with a
+    // single table lookup per cell
+    template<RowKind KIND>
+    LGCA_FORCE_INLINE void step_row_lut(const int y, const unsigned char* const* row_in,
+                                        unsigned char* node_state_out);
+
+    // Copies the cells on the western and eastern boundary of the specified rows to the ghost cells
+    // on the opposite side
+    void update_ghost_columns(const int y_begin, const int y_end);
+
+    // Copies the first and the last row of the domain to the ghost rows on the opposite side
+    void update_ghost_rows();
+
+    // Finds the occupied tiles of the halo-padded array
+    void setup_occupied_tiles();
+
+    // Derives the active tiles and rows from the occupied tiles
+    void update_active_tiles();
+
+    // Packs the node states into the halo-padded array
+    void pack();
+
+    // Unpacks the halo-padded array into the specified bitset
+    void unpack(Bitset& node_state) const;
+
+    // Makes the next step pack the staged node states into the halo-padded array again
+    void invalidate_node_states();
+
+    // Makes the next step set up the cell type masks and the lookup table rows again
+    void invalidate_cell_types() { m_cell_masks_valid = false; }
+
+    // Sets up the cell type masks and the lookup table rows of the cells
+    void setup_cell_masks();
+
+    // Returns the sites of the specified pair of the cells of mask word w of row y
+    MaskWord forcing_sites(const int y, const size_t w, const ForcingPair& pair) const;
+
+    // Returns the number of sites of the specified pairs of the cells of row y
+    size_t count_forcing_sites(const int y, const ForcingPair* pairs, const unsigned int num_pairs) const;
+
+    // Zero-fills the arrays streamed by the step kernel chunk by chunk, so that their pages are
+    // placed on the NUMA nodes of the threads updating the chunks
+    void first_touch();
 
     // Allocates the memory for the arrays on the host (CPU) and device (GPU).
     void allocate_memory();
@@ -65,16 +246,40 @@ public:
     // Performs the collision and propagation step on the lattice gas automaton.
     void collide_and_propagate(const bool p);
 
-    // Computes the mean velocity of the lattice.
-    std::vector<Real> get_mean_velocity();
-
     // Applies a body force in the specified direction (x or y) and with the
     // specified intensity to the particles. E.g., if the intensity is equal 100,
     // every 100th particle changes it's direction, if feasible.
     void apply_body_force(const int forcing);
 
-    // Computes quantities of interest as a post-processing procedure.
+    // Applies a body force of the specified intensity spread over the next num_steps steps by the
+    // step kernels (fused forcing)
+    bool set_fused_forcing(const int forcing, const unsigned int num_steps);
+
+    // Returns the number of particles in the lattice
+    unsigned long get_n_particles();
+
+    // Unpacks the current node states to the output buffer for post-processing and visualization
+    void copy_data_to_output_buffer();
+
+    // Computes quantities of interest as a post-processing procedure, skipping the cells of tiles
+    // without particles
     void post_process();
+
+    // Selects the step kernel. The cell type masks and lookup table rows are set up from the cell
+    // types on the first step (and again after the cell types have changed).
+    void set_kernel(const OMP_Kernel kernel) { m_kernel = kernel; }
+
+    // Returns the step kernel in use
+    OMP_Kernel kernel() const { return m_kernel; }
+
+    // Returns the boundary policy the step kernels are specialized for (determined from the cell
+    // types on the first step)
+    Boundary boundary() const { return m_boundary; }
+
+    // Sets the seed of the random bits for collision and of the selection of the particles
+    // reverted by the body force. Runs with the same seed are reproducible bit by bit, independent
+    // of the number of threads.
+    void set_seed(const uint64_t seed) { m_rng.set_seed(seed); m_forcing.set_seed(seed); }
 };
 
 } // namespace lgca
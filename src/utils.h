@@ -29,6 +29,7 @@ namespace lgca {
 // Gets values from the command line.
 static inline void
 get_vals_from_cmd(int argc, char **argv,
+                  string* test_case,
                   Real* Re, Real* Ma,
                   int* n_dir,
                   int* s_max,
@@ -46,6 +47,9 @@ get_vals_from_cmd(int argc, char **argv,
     // Define value arguments and add them to the command line.
     using TCLAP::ValueArg;
 
+    ValueArg<string> testCaseArg("", "test-case", "Test case.", false, "pipe", "string (\"pipe\", \"karman\", \"diffusion\", \"box\", \"periodic\" or \"collision\") (default: \"pipe\")");
+    cmd.add(testCaseArg);
+
     ValueArg<Real>  ReArg("r", "Re", "Reynolds number.", false, 80.0, "real gt 0 (default: 80.0)");
     cmd.add(ReArg);
 
@@ -86,6 +90,7 @@ get_vals_from_cmd(int argc, char **argv,
     cmd.parse(argc, argv);
 
     // Get the value parsed by each arg.
+    *test_case              = testCaseArg.getValue();
     *Re                     = ReArg.getValue();
     *Ma                     = MaArg.getValue();
     *n_dir                  = ndirArg.getValue();
@@ -100,6 +105,56 @@ get_vals_from_cmd(int argc, char **argv,
     *output_format          = outputArg.getValue();
 }
 
+// Gets the step kernel from the command line (--kernel=<name>). The names are the ones of the
+// variants of KernelRegistry, "auto" picks the fastest kernel for the lattice at startup. If given,
+// num_threads and pin_threads are set to the number of threads of the lattice loops (--threads,
+// 0 for one thread per core) and whether the threads are pinned to cores (--pin-threads), see
+// Threads::init(). If given, tuning_file is set to the file the tuned parameters of the parallel
+// loops and kernels are loaded from and saved to (--tuning-file, empty if none), see Tuning.
+static inline string get_kernel_from_cmd(int argc, char **argv, const string default_kernel,
+                                         int* num_threads = nullptr, bool* pin_threads = nullptr,
+                                         string* tuning_file = nullptr, bool* fused_forcing = nullptr) {
+
+    // Define the command line object.
+    TCLAP::CmdLine cmd("Command description message", '=', "0.9");
+
+    TCLAP::ValueArg<string> kernelArg("k", "kernel", "Step kernel.", false, default_kernel,
+                                      "string (\"auto\", \"omp\", \"omp-boolean\", \"omp-lut\", \"bitplane\", "
+                                      "\"bitplane-scalar\", \"bitplane-avx2\", \"bitplane-avx512\", \"sparse\", "
+                                      "\"sparse-morton\" or \"ensemble\") "
+                                      "(default: \"" + default_kernel + "\")");
+    cmd.add(kernelArg);
+
+    TCLAP::ValueArg<int> threadsArg("t", "threads", "Number of threads.", false, 0,
+                                    "int gte 0 (default: 0, i.e. one thread per core)");
+    cmd.add(threadsArg);
+
+    TCLAP::SwitchArg pinArg("", "pin-threads", "Pin the threads to cores (keeps the rows of the lattice "
+                            "on the NUMA node of the thread updating them).", false);
+    cmd.add(pinArg);
+
+    TCLAP::ValueArg<string> tuningArg("", "tuning-file", "File of the tuned parameters of the parallel loops "
+                                      "and kernels (loaded at startup if it exists, written at exit with the "
+                                      "measured values).",
+                                      false, "", "string (default: none)");
+    cmd.add(tuningArg);
+
+    TCLAP::SwitchArg fusedForcingArg("", "fused-forcing", "Apply the body force by the step kernels, spread "
+                                     "over the steps (if supported by the step kernel).", false);
+    cmd.add(fusedForcingArg);
+
+    // Parse the args.
+    cmd.parse(argc, argv);
+
+    if (num_threads) *num_threads = threadsArg.getValue();
+    if (pin_threads) *pin_threads = pinArg.getValue();
+    if (tuning_file) *tuning_file = tuningArg.getValue();
+
+    if (fused_forcing) *fused_forcing = fusedForcingArg.getValue();
+
+    return kernelArg.getValue();
+}
+
 // Prints a startup message.
 static inline void print_startup_message() {
 